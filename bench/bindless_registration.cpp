@@ -0,0 +1,71 @@
+#include <latch>
+
+#include "renderer/renderer.hpp"
+#include "renderer/window/render_context.hpp"
+
+// Registrations per second of bindless descriptor set: uniform buffers are registered by several threads,
+// then queued descriptor writes are made by one flush. Each round unregisters buffers, so slots are reused.
+// Usage: bindless-registration-benchmark [resources number] [threads number] [rounds number]
+int main(int argc, const char **argv)
+{
+  uint32_t resources_number = argc > 1 ? std::stoul(argv[1]) : 4096;
+  uint32_t threads_number = argc > 2 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+  uint32_t rounds_number = argc > 3 ? std::stoul(argv[3]) : 5;
+
+  mr::Application app;
+  auto render_context = app.create_render_context({64, 64});
+  const auto &state = render_context->vulkan_state();
+  auto &bindless_set = render_context->bindless_set();
+
+  // Render context registers its own buffers, so they must fit too
+  uint32_t capacity = bindless_set.layout_handle()->capacity(mr::RenderContext::uniform_buffer_binding);
+  if (resources_number > capacity / 2) {
+    MR_WARNING("Resources number {} is limited by half of binding capacity {}", resources_number, capacity);
+    resources_number = capacity / 2;
+  }
+
+  std::vector<std::unique_ptr<mr::UniformBuffer>> buffers;
+  buffers.reserve(resources_number);
+  for (uint32_t i = 0; i < resources_number; i++) {
+    buffers.emplace_back(std::make_unique<mr::UniformBuffer>(state, 256));
+  }
+
+  std::println("{} uniform buffers, {} threads, {} backend", resources_number, threads_number,
+    state.descriptor_buffer_supported() ? "descriptor buffer" : "descriptor pool");
+
+  double best_rate = 0;
+  for (uint32_t round = 0; round < rounds_number; round++) {
+    std::latch start(threads_number + 1);
+    std::vector<std::jthread> threads;
+    for (uint32_t thread = 0; thread < threads_number; thread++) {
+      threads.emplace_back([&, thread] {
+        start.arrive_and_wait();
+        for (uint32_t i = thread; i < resources_number; i += threads_number) {
+          bindless_set.register_resource(mr::Shader::Resource(static_cast<const mr::UniformBuffer *>(buffers[i].get())));
+        }
+      });
+    }
+
+    auto registration_start = std::chrono::steady_clock::now();
+    start.arrive_and_wait();
+    threads.clear();
+    auto flush_start = std::chrono::steady_clock::now();
+    bindless_set.flush();
+    auto flush_end = std::chrono::steady_clock::now();
+
+    double registration_seconds = std::chrono::duration<double>(flush_start - registration_start).count();
+    double rate = resources_number / registration_seconds;
+    best_rate = std::max(best_rate, rate);
+    std::println("round {}: registration {:.3f} ms ({:.0f} registrations/s), flush {:.3f} ms",
+      round, registration_seconds * 1000, rate,
+      std::chrono::duration<double, std::milli>(flush_end - flush_start).count());
+
+    for (const auto &buffer : buffers) {
+      bindless_set.unregister_resource(mr::Shader::Resource(static_cast<const mr::UniformBuffer *>(buffer.get())));
+    }
+  }
+
+  auto stats = bindless_set.stats();
+  std::println("best {:.0f} registrations/s, {} registrations, {} flushes, {} flushed writes",
+    best_rate, stats.registrations, stats.flushes, stats.flushed_writes);
+}
@@ -0,0 +1,106 @@
+#include <random>
+
+#include "scene/bvh.hpp"
+
+// Build, refit and query times of instance BVH on 10k, 100k and 1M random instance boxes.
+// Refit moves 1% of instances, each query kind is repeated and average time is printed.
+// Usage: bvh-benchmark [queries number]
+static float elapsed_ms(std::chrono::steady_clock::time_point start) noexcept
+{
+  return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, const char **argv)
+{
+  uint32_t queries_number = argc > 1 ? std::stoul(argv[1]) : 100;
+
+  for (uint32_t items_number : {10'000u, 100'000u, 1'000'000u}) {
+    // Scene density is kept, so queries of the same size return the same number of items
+    float extent = 1000 * std::cbrt(items_number / 1'000'000.f);
+
+    std::mt19937 generator(items_number);
+    std::uniform_real_distribution<float> position_distribution(-extent, extent);
+    std::uniform_real_distribution<float> size_distribution(0.5f, 3);
+    std::vector<mr::Bvh::Box> boxes(items_number);
+    for (auto &box : boxes) {
+      for (int i = 0; i < 3; i++) {
+        float center = position_distribution(generator);
+        float size = size_distribution(generator);
+        box.min[i] = center - size;
+        box.max[i] = center + size;
+      }
+    }
+
+    mr::Bvh bvh;
+    bvh.build(boxes);
+    float build_ms = bvh.stats().build_ms;
+
+    std::uniform_int_distribution<uint32_t> item_distribution(0, items_number - 1);
+    for (uint32_t i = 0; i < items_number / 100; i++) {
+      uint32_t item = item_distribution(generator);
+      auto box = bvh.item_box(item);
+      for (int axis = 0; axis < 3; axis++) {
+        box.min[axis] += 1;
+        box.max[axis] += 1;
+      }
+      bvh.update(item, box);
+    }
+    bvh.refit();
+
+    std::vector<uint32_t> result;
+    size_t found_number = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < queries_number; i++) {
+      float x = position_distribution(generator);
+      result.clear();
+      bvh.query_box({{x - 50, -50, -50}, {x + 50, 50, 50}}, result);
+      found_number += result.size();
+    }
+    float box_ms = elapsed_ms(start) / queries_number;
+    size_t box_found_number = found_number / queries_number;
+
+    found_number = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < queries_number; i++) {
+      result.clear();
+      bvh.query_sphere({position_distribution(generator), 0, 0}, 50, result);
+      found_number += result.size();
+    }
+    float sphere_ms = elapsed_ms(start) / queries_number;
+    size_t sphere_found_number = found_number / queries_number;
+
+    // Box-shaped frustum, planes point inside
+    found_number = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < queries_number; i++) {
+      float x = position_distribution(generator);
+      std::array<std::array<float, 4>, 6> planes {{
+        {1, 0, 0, 100 - x}, {-1, 0, 0, 100 + x},
+        {0, 1, 0, 100}, {0, -1, 0, 100},
+        {0, 0, 1, 100}, {0, 0, -1, 100},
+      }};
+      result.clear();
+      bvh.query_frustum(planes, result);
+      found_number += result.size();
+    }
+    float frustum_ms = elapsed_ms(start) / queries_number;
+    size_t frustum_found_number = found_number / queries_number;
+
+    uint32_t hits_number = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < queries_number; i++) {
+      std::array<float, 3> origin {-2 * extent, position_distribution(generator), position_distribution(generator)};
+      hits_number += bvh.query_ray(origin, {1, 0, 0}).has_value();
+    }
+    float ray_ms = elapsed_ms(start) / queries_number;
+
+    std::println("{} instances, {} nodes", items_number, bvh.stats().nodes_number);
+    std::println("  build {:.2f} ms, refit of {} moved {:.3f} ms ({} nodes)",
+      build_ms, items_number / 100, bvh.stats().refit_ms, bvh.stats().refitted_nodes_number);
+    std::println("  box query {:.4f} ms ({} items), sphere query {:.4f} ms ({} items)",
+      box_ms, box_found_number, sphere_ms, sphere_found_number);
+    std::println("  frustum query {:.4f} ms ({} items), ray query {:.4f} ms ({}/{} hits)",
+      frustum_ms, frustum_found_number, ray_ms, hits_number, queries_number);
+  }
+}
@@ -0,0 +1,72 @@
+#include <random>
+
+#include "scene/transform_hierarchy.hpp"
+
+// Propagation time of transform hierarchy with 1M nodes bound to instances: 1000 roots,
+// then nodes get 8 children each in order of addition, so 1M nodes form 5 levels.
+// Full propagation, propagation without changes, after moving all roots and after moving random nodes are measured.
+// Usage: transform-hierarchy-benchmark [nodes number] [moved nodes number]
+static mr::Matr4f transform(float x, float y, float z, float scale) noexcept
+{
+  static_assert(sizeof(mr::Matr4f) == 16 * sizeof(float));
+  std::array<float, 16> data {
+    scale, 0, 0, 0,
+    0, scale, 0, 0,
+    0, 0, scale, 0,
+    x, y, z, 1,
+  };
+  mr::Matr4f matrix;
+  std::memcpy(&matrix, data.data(), sizeof(data));
+  return matrix;
+}
+
+static void print_propagation(std::string_view name, const mr::TransformHierarchy &hierarchy) noexcept
+{
+  std::println("{}: {:.2f} ms, {} nodes updated, {} instance updates", name,
+    hierarchy.stats().propagation_ms, hierarchy.stats().updated_nodes_number, hierarchy.instance_updates().size());
+}
+
+int main(int argc, const char **argv)
+{
+  uint32_t nodes_number = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+  uint32_t moved_nodes_number = argc > 2 ? std::stoul(argv[2]) : 50'000;
+  constexpr uint32_t roots_number = 1000;
+  constexpr uint32_t children_number = 8;
+  nodes_number = std::max(nodes_number, roots_number + 1);
+
+  mr::InstanceStore instances;
+  std::vector<mr::Matr4f> transforms(nodes_number, transform(0, 0, 0, 1));
+  instances.append(0, transforms);
+
+  mr::TransformHierarchy hierarchy;
+  std::vector<mr::TransformHierarchy::Node> nodes;
+  nodes.reserve(nodes_number);
+  for (uint32_t i = 0; i < roots_number; i++) {
+    nodes.push_back(hierarchy.add(mr::TransformHierarchy::no_node, transform(i, 0, 0, 1), instances.handle(i)));
+  }
+  for (uint32_t i = roots_number; i < nodes_number; i++) {
+    auto parent = nodes[(i - roots_number) / children_number];
+    nodes.push_back(hierarchy.add(parent, transform(1, 2, 3, 0.5f), instances.handle(i)));
+  }
+
+  hierarchy.propagate();
+  std::println("{} nodes, {} levels", hierarchy.stats().nodes_number, hierarchy.stats().levels_number);
+  print_propagation("full", hierarchy);
+
+  hierarchy.propagate();
+  print_propagation("idle", hierarchy);
+
+  for (uint32_t i = 0; i < roots_number; i++) {
+    hierarchy.set_local(nodes[i], transform(i, 1, 0, 1));
+  }
+  hierarchy.propagate();
+  print_propagation("all roots moved", hierarchy);
+
+  std::mt19937 generator(1);
+  std::uniform_int_distribution<uint32_t> node_distribution(roots_number, nodes_number - 1);
+  for (uint32_t i = 0; i < moved_nodes_number; i++) {
+    hierarchy.set_local(nodes[node_distribution(generator)], transform(2, 2, 2, 0.5f));
+  }
+  hierarchy.propagate();
+  print_propagation(std::format("{} random nodes moved", moved_nodes_number), hierarchy);
+}
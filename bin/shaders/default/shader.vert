@@ -15,6 +15,8 @@ layout(location = 3) out vec4 metallic_roughness;
 layout(location = 4) out vec4 emissive;
 layout(location = 5) out vec4 occlusion;
 
+// Material textures are sampled here, where there are no derivatives
+#define PBR_PARAMS_NO_DERIVATIVES
 #include "pbr_params.h"
 
 struct DrawInfo {
@@ -23,6 +25,7 @@ struct DrawInfo {
   uint material_buffer_id;
   uint camera_buffer_id;
   uint transforms_buffer_id;
+  uint visible_instances_buffer_id;
 };
 
 layout(push_constant) uniform DrawsIndosBufferId {
@@ -50,6 +53,12 @@ layout(set = BINDLESS_SET, binding = STORAGE_BUFFERS_BINDING) readonly buffer Tr
 } SSBOArray[];
 #define transforms SSBOArray[draw.transforms_buffer_id].transforms
 
+// Transform index of each visible instance, first instance of draw points to its mesh range
+layout(set = BINDLESS_SET, binding = STORAGE_BUFFERS_BINDING) readonly buffer VisibleInstances {
+  uint visible_instances[];
+} VisibleInstancesArray[];
+#define visible_instances VisibleInstancesArray[draw.visible_instances_buffer_id].visible_instances
+
 void main()
 {
   // TODO(dk6): move readings from texture to fragment shader, because these readings can be useless if fragment isn't on screen
@@ -61,7 +70,7 @@ void main()
   vec4 occlusion_color = get_occlusion_color(mat_id, tex_coord);
   vec4 normal_color = get_normal_color(mat_id, tex_coord);
 
-  mat4 transform = transpose(transforms[draw.instance_offset + gl_InstanceIndex]);
+  mat4 transform = transpose(transforms[visible_instances[gl_InstanceIndex]]);
   // mat4 transform = transpose(transforms[gl_DrawID + gl_InstanceIndex]);
 
   position = transform * vec4(InPos.xyz, 1.0);
@@ -0,0 +1,70 @@
+/**/
+#version 460
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout(location = 0) out vec4 OutPos;
+layout(location = 1) out vec4 OutNIsShade;
+layout(location = 2) out vec4 OutMR;
+layout(location = 3) out vec4 OutEmissive;
+layout(location = 4) out vec4 OutOcclusion;
+layout(location = 5) out vec4 OutColorTrans;
+
+layout(location = 0) in vec2 atlas_uv;
+layout(location = 1) flat in uint draw_id;
+layout(location = 2) flat in uint transform_index;
+
+struct DrawInfo {
+  uint atlas_ids[6];
+  uint camera_buffer_id;
+  uint transforms_buffer_id;
+  vec4 sphere;
+  uint visible_instances_buffer_id;
+};
+
+layout(push_constant) uniform DrawsIndosBufferId {
+  uint draw_infos_buffer;
+};
+
+layout(set = BINDLESS_SET, binding = STORAGE_BUFFERS_BINDING) readonly buffer DrawIndoBuffers {
+  DrawInfo draws[];
+} DrawInfosArray[];
+#define draw DrawInfosArray[draw_infos_buffer].draws[draw_id]
+
+layout(set = BINDLESS_SET, binding = UNIFORM_BUFFERS_BINDING) readonly uniform CameraUbo {
+  mat4 vp;
+  vec4 pos;
+  float fov;
+  float gamma;
+  float speed;
+  float sens;
+} CameraUboArray[];
+#define cam_ubo CameraUboArray[draw.camera_buffer_id]
+
+layout(set = BINDLESS_SET, binding = STORAGE_BUFFERS_BINDING) readonly buffer Transforms {
+  mat4 transforms[];
+} SSBOArray[];
+#define transforms SSBOArray[draw.transforms_buffer_id].transforms
+
+layout(set = BINDLESS_SET, binding = TEXTURES_BINDING) uniform sampler2D TexturesArray[];
+#define atlas(i) TexturesArray[nonuniformEXT(draw.atlas_ids[i])]
+
+void main()
+{
+  // Atlases are geometry buffers baked in mesh space, position alpha is coverage
+  vec4 position = texture(atlas(0), atlas_uv);
+  if (position.w < 0.5) {
+    discard;
+  }
+
+  mat4 transform = transpose(transforms[transform_index]);
+  OutPos = transform * vec4(position.xyz, 1.0);
+  OutNIsShade = texture(atlas(1), atlas_uv);
+  OutMR = texture(atlas(2), atlas_uv);
+  OutEmissive = texture(atlas(3), atlas_uv);
+  OutOcclusion = texture(atlas(4), atlas_uv);
+  OutColorTrans = texture(atlas(5), atlas_uv);
+
+  // Depth of baked surface instead of quad, so impostors intersect geometry correctly
+  vec4 clip = cam_ubo.vp * OutPos;
+  gl_FragDepth = clip.z / clip.w;
+}
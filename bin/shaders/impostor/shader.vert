@@ -0,0 +1,97 @@
+/**/
+#version 460 // required for gl_DrawID (https://wikis.khronos.org/opengl/Vertex_Shader/Defined_Inputs)
+
+// Impostor is quad facing frame of octahedral atlas nearest to view direction.
+// Frames layout must be the same as in Impostor::frame_viewproj
+
+#define FRAMES_PER_SIDE 8
+
+layout(location = 0) in vec2 InCorner;
+
+layout(location = 0) out vec2 atlas_uv;
+layout(location = 1) flat out uint draw_id;
+layout(location = 2) flat out uint transform_index;
+
+struct DrawInfo {
+  uint atlas_ids[6];
+  uint camera_buffer_id;
+  uint transforms_buffer_id;
+  vec4 sphere; // mesh space center and radius
+  uint visible_instances_buffer_id;
+};
+
+layout(push_constant) uniform DrawsIndosBufferId {
+  uint draw_infos_buffer;
+};
+
+layout(set = BINDLESS_SET, binding = STORAGE_BUFFERS_BINDING) readonly buffer DrawIndoBuffers {
+  DrawInfo draws[];
+} DrawInfosArray[];
+#define draws DrawInfosArray[draw_infos_buffer].draws
+#define draw draws[gl_DrawID]
+
+layout(set = BINDLESS_SET, binding = UNIFORM_BUFFERS_BINDING) readonly uniform CameraUbo {
+  mat4 vp;
+  vec4 pos;
+  float fov;
+  float gamma;
+  float speed;
+  float sens;
+} CameraUboArray[];
+#define cam_ubo CameraUboArray[draw.camera_buffer_id]
+
+layout(set = BINDLESS_SET, binding = STORAGE_BUFFERS_BINDING) readonly buffer Transforms {
+  mat4 transforms[];
+} SSBOArray[];
+#define transforms SSBOArray[draw.transforms_buffer_id].transforms
+
+layout(set = BINDLESS_SET, binding = STORAGE_BUFFERS_BINDING) readonly buffer VisibleInstances {
+  uint visible_instances[];
+} VisibleInstancesArray[];
+#define visible_instances VisibleInstancesArray[draw.visible_instances_buffer_id].visible_instances
+
+// Octahedral mapping of direction to [-1, 1] square, y is up
+vec2 octahedron_encode(vec3 direction)
+{
+  vec3 n = direction / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+  if (n.y < 0) {
+    return vec2((1 - abs(n.z)) * (n.x >= 0 ? 1 : -1), (1 - abs(n.x)) * (n.z >= 0 ? 1 : -1));
+  }
+  return n.xz;
+}
+
+vec3 octahedron_decode(vec2 uv)
+{
+  vec3 direction = vec3(uv.x, 1 - abs(uv.x) - abs(uv.y), uv.y);
+  if (direction.y < 0) {
+    direction.xz = vec2((1 - abs(uv.y)) * (uv.x >= 0 ? 1 : -1), (1 - abs(uv.x)) * (uv.y >= 0 ? 1 : -1));
+  }
+  return normalize(direction);
+}
+
+void main()
+{
+  transform_index = visible_instances[gl_InstanceIndex];
+  draw_id = gl_DrawID;
+  mat4 transform = transpose(transforms[transform_index]);
+  vec3 center = draw.sphere.xyz;
+  float radius = draw.sphere.w;
+
+  // View direction in mesh space selects frame
+  vec3 world_center = (transform * vec4(center, 1)).xyz;
+  vec3 view_direction = normalize(transpose(mat3(transform)) * (cam_ubo.pos.xyz - world_center));
+  vec2 frame = clamp(floor((octahedron_encode(view_direction) * 0.5 + 0.5) * FRAMES_PER_SIDE),
+                     vec2(0), vec2(FRAMES_PER_SIDE - 1));
+
+  vec3 direction = octahedron_decode((frame + 0.5) / FRAMES_PER_SIDE * 2 - 1);
+  vec3 up_reference = abs(direction.y) > 0.99 ? vec3(0, 0, 1) : vec3(0, 1, 0);
+  vec3 right = normalize(cross(up_reference, direction));
+  vec3 up = cross(direction, right);
+
+  // Atlas rows go down, as image rows
+  atlas_uv = (frame + vec2(InCorner.x, -InCorner.y) * 0.5 + 0.5) / FRAMES_PER_SIDE;
+
+  vec3 position = center + (InCorner.x * right + InCorner.y * up) * radius;
+  gl_Position = cam_ubo.vp * transform * vec4(position, 1.0);
+  gl_Position = vec4(gl_Position.x, -gl_Position.y, gl_Position.z, gl_Position.w);
+}
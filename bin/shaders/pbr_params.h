@@ -16,12 +16,35 @@ layout(set = BINDLESS_SET, binding = UNIFORM_BUFFERS_BINDING) readonly uniform P
   uint emissive_tex_id;
   uint occlusion_tex_id;
   uint normal_map_tex_id;
+
+  // Per texture uv transform: xy - scale, zw - bias. Not identity for textures packed into atlas
+  vec4 base_color_uv_transform;
+  vec4 metallic_roughness_uv_transform;
+  vec4 emissive_uv_transform;
+  vec4 occlusion_uv_transform;
+  vec4 normal_map_uv_transform;
 } UniformBuffersArray[];
 
 layout(set = BINDLESS_SET, binding = TEXTURES_BINDING) uniform sampler2D TexturesArray[];
 
 #define ubo(mat_id) UniformBuffersArray[mat_id]
 
+// Atlas regions do not repeat by themselves, so wrapping is done before moving to region.
+// Derivatives are taken from continuous coordinates, otherwise the wrap makes them huge and
+// the smallest mip is sampled on it. Stages without derivatives define PBR_PARAMS_NO_DERIVATIVES
+// before include and sample base level, as implicit level sampling does there
+vec4 sample_material_texture(sampler2D tex, vec4 uv_transform, vec2 tex_coord) {
+  if (uv_transform.xy == vec2(1)) {
+    return texture(tex, tex_coord);
+  }
+  vec2 uv = fract(tex_coord) * uv_transform.xy + uv_transform.zw;
+#ifdef PBR_PARAMS_NO_DERIVATIVES
+  return textureLod(tex, uv, 0);
+#else
+  return textureGrad(tex, uv, dFdx(tex_coord) * uv_transform.xy, dFdy(tex_coord) * uv_transform.xy);
+#endif
+}
+
 #define BaseColorTex(mat_id) TexturesArray[ubo(mat_id).base_color_tex_id]
 #define MetallicRoughnessTex(mat_id) TexturesArray[ubo(mat_id).metallic_roughness_tex_id]
 #define EmissiveTex(mat_id) TexturesArray[ubo(mat_id).emissive_tex_id]
@@ -30,7 +53,7 @@ layout(set = BINDLESS_SET, binding = TEXTURES_BINDING) uniform sampler2D Texture
 
 vec4 get_base_color(uint mat_id, vec2 tex_coord) {
 #ifdef BASE_COLOR_MAP_BINDING
-  return texture(BaseColorTex(mat_id), tex_coord) * ubo(mat_id).base_color_factor;
+  return sample_material_texture(BaseColorTex(mat_id), ubo(mat_id).base_color_uv_transform, tex_coord) * ubo(mat_id).base_color_factor;
 #else
   return ubo(mat_id).base_color_factor;
 #endif
@@ -38,7 +61,7 @@ vec4 get_base_color(uint mat_id, vec2 tex_coord) {
 
 vec4 get_metallic_roughness_color(uint mat_id, vec2 tex_coord) {
 #ifdef METALLIC_ROUGHNESS_MAP_BINDING
-  return texture(MetallicRoughnessTex(mat_id), tex_coord) * vec4(1.f, ubo(mat_id).metallic_factor, ubo(mat_id).roughness_factor, 1);
+  return sample_material_texture(MetallicRoughnessTex(mat_id), ubo(mat_id).metallic_roughness_uv_transform, tex_coord) * vec4(1.f, ubo(mat_id).metallic_factor, ubo(mat_id).roughness_factor, 1);
 #else
   return vec4(1.f, ubo(mat_id).metallic_factor, ubo(mat_id).roughness_factor, 1);
 #endif
@@ -46,7 +69,7 @@ vec4 get_metallic_roughness_color(uint mat_id, vec2 tex_coord) {
 
 vec4 get_emissive_color(uint mat_id, vec2 tex_coord) {
 #ifdef EMISSIVE_MAP_BINDING
-  return texture(EmissiveTex(mat_id), tex_coord) * ubo(mat_id).emissive_strength;
+  return sample_material_texture(EmissiveTex(mat_id), ubo(mat_id).emissive_uv_transform, tex_coord) * ubo(mat_id).emissive_strength;
 #else
   return ubo(mat_id).emissive_color * ubo(mat_id).emissive_strength;
 #endif
@@ -54,7 +77,7 @@ vec4 get_emissive_color(uint mat_id, vec2 tex_coord) {
 
 vec4 get_occlusion_color(uint mat_id, vec2 tex_coord) {
 #ifdef OCCLUSION_MAP_BINDING
-  return texture(OcclusionTex(mat_id), tex_coord);
+  return sample_material_texture(OcclusionTex(mat_id), ubo(mat_id).occlusion_uv_transform, tex_coord);
 #else
   return vec4(0.f);
 #endif
@@ -62,7 +85,7 @@ vec4 get_occlusion_color(uint mat_id, vec2 tex_coord) {
 
 vec4 get_normal_color(uint mat_id, vec2 tex_coord) {
 #ifdef NORMAL_MAP_BINDING
-  return texture(NormalMapTex(mat_id), tex_coord) * ubo(mat_id).normal_map_intensity;
+  return sample_material_texture(NormalMapTex(mat_id), ubo(mat_id).normal_map_uv_transform, tex_coord) * ubo(mat_id).normal_map_intensity;
 #else
   return vec4(InNorm, 1.0);
 #endif
@@ -18,6 +18,7 @@ CPMAddPackage("gh:Cvelth/vkfw#main")
 CPMAddPackage("gh:charles-lunarg/vk-bootstrap@1.4.321")
 CPMAddPackage("gh:bemanproject/inplace_vector#b81a3c7")
 CPMAddPackage("gh:GPUOpen-LibrariesAndSDKs/VulkanMemoryAllocator@3.3.0")
+CPMAddPackage("gh:zeux/meshoptimizer@0.22")
 
 if (${vkfw_ADDED})
   add_library(libvkfw INTERFACE "")
@@ -44,6 +45,7 @@ set(DEPS_LIBRARIES
   beman.inplace_vector
   boost::boost
   TBB::tbb
+  meshoptimizer
 
   mr-math::mr-math
   mr-utils::mr-utils
@@ -1,2 +1,4 @@
 option(SANITIZE "Option referring to sanitizers (cppcheck, iwyu, additional warnings)" OFF)
 option(GENERATE_DEPENDENCY_GRAPH "Option referring to dependency graph generation in png format" OFF)
+option(ENABLE_AVX2 "Option referring to AVX2 code paths of CPU culling, selected at runtime if CPU supports AVX2" ON)
+option(BUILD_BENCHMARKS "Option referring to benchmark executables in bench directory" OFF)
@@ -19,7 +19,6 @@ void mr::graphics::DirectionalLight::shade(CommandUnit &unit) const noexcept
   if (not _enabled) {
     return;
   }
-  _update_ubo();
 
   uint32_t push_data[] {
     _scene->camera_buffer_id(),
@@ -34,20 +33,14 @@ void mr::graphics::DirectionalLight::shade(CommandUnit &unit) const noexcept
 
   // TODO(dk6): use pipeline.apply()
   unit->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline().pipeline());
-  // TODO(dk6): use set.bind()
-  unit->bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                           pipeline().layout(),
-                           0, {lights_descriptor_set()}, {});
-
-  unit->bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                           pipeline().layout(),
-                           1, {_scene->render_context().bindless_set()}, {});
+  lights_descriptor_set().bind(unit.command_buffer(), pipeline().layout(), 0);
+  _scene->render_context().bindless_set().bind(unit.command_buffer(), pipeline().layout(), 1);
 
   // TODO(dk6): use instansing here
   unit->drawIndexed(index_buffer().element_count(), 1, 0, 0, 0);
 }
 
-void mr::graphics::DirectionalLight::_update_ubo() const noexcept
+void mr::graphics::DirectionalLight::update_ubo() const noexcept
 {
   if (!_updated) {
     return;
@@ -27,13 +27,12 @@ inline namespace graphics {
     DirectionalLight & operator=(DirectionalLight &&) noexcept = default;
     DirectionalLight(DirectionalLight &&) noexcept = default;
 
+    // Uniform buffer is written before shading each frame, recorded shading commands can be reused
+    void update_ubo() const noexcept;
     void shade(CommandUnit &unit) const noexcept;
 
     const Norm3f & direction() const noexcept { return _direction; }
     void direction(const Norm3f &dir) noexcept { _direction = dir; _updated = true; }
-
-  private:
-    void _update_ubo() const noexcept;
   };
 
   MR_DECLARE_HANDLE(DirectionalLight);
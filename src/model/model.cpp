@@ -3,6 +3,7 @@
 #include "scene/scene.hpp"
 #include "renderer/window/render_context.hpp"
 #include "model/model.hpp"
+#include "renderer/mesh/mesh_optimizer.hpp"
 
 constexpr mr::MaterialParameter importer2graphics(mr::importer::TextureType type)
 {
@@ -25,15 +26,119 @@ constexpr mr::MaterialParameter importer2graphics(mr::importer::TextureType type
   }
 }
 
-mr::graphics::Model::Model(
-    Scene &scene,
-    std::fs::path filename) noexcept
-  : _scene(&scene)
+// Cache files of model data are named by model file name and hash of its path
+static std::fs::path model_cache_path(const std::fs::path &model_path, std::string_view suffix) noexcept
 {
-  MR_INFO("Loading model {}", filename.string());
+  return mr::path::cache_dir / std::format("{}_{:x}{}",
+    model_path.stem().string(), std::hash<std::string>{}(model_path.string()), suffix);
+}
 
-  const auto &state = scene.render_context().vulkan_state();
+// Reorders vertices and indices of meshes for GPU caches, results are taken from cache file if it is valid
+template <typename MeshesT>
+static void optimize_meshes(const std::fs::path &model_path, MeshesT &meshes) noexcept
+{
+  using mr::MeshOptimizer;
+
+  auto cache_path = model_cache_path(model_path, ".meshopt");
+
+  auto results = MeshOptimizer::load(cache_path, model_path);
+  bool cache_valid = results && results->size() == meshes.size();
+  for (size_t i = 0; cache_valid && i < meshes.size(); i++) {
+    const auto &result = (*results)[i];
+    cache_valid = result.remap.size() == meshes[i].positions.size() && result.lods.size() == meshes[i].lods.size();
+    for (size_t j = 0; cache_valid && j < result.lods.size(); j++) {
+      cache_valid = result.lods[j].size() == meshes[i].lods[j].indices.size();
+    }
+  }
+
+  std::vector<size_t> mesh_indices(meshes.size());
+  std::iota(mesh_indices.begin(), mesh_indices.end(), 0);
+
+  if (not cache_valid) {
+    results.emplace(meshes.size());
+    std::for_each(std::execution::par, mesh_indices.begin(), mesh_indices.end(),
+      [&](size_t i) {
+        const auto &mesh = meshes[i];
+        std::vector<std::span<const uint32_t>> lods;
+        for (const auto &lod : mesh.lods) {
+          lods.emplace_back(lod.indices);
+        }
+        (*results)[i] = MeshOptimizer::optimize(std::as_bytes(std::span(mesh.positions)), mr::position_bytes_size,
+                                                mr::position_bytes_size + mr::attributes_bytes_size, lods);
+      }
+    );
+    MeshOptimizer::store(cache_path, model_path, *results);
+  }
+
+  std::for_each(std::execution::par, mesh_indices.begin(), mesh_indices.end(),
+    [&](size_t i) {
+      auto &mesh = meshes[i];
+      const auto &result = (*results)[i];
+
+      auto positions = mesh.positions;
+      positions.resize(result.vertices_number);
+      MeshOptimizer::remap_vertices(std::as_writable_bytes(std::span(positions)),
+                                    std::as_bytes(std::span(mesh.positions)), mr::position_bytes_size, result);
+      mesh.positions = std::move(positions);
 
+      if (mesh.attributes.size() == result.remap.size()) {
+        auto attributes = mesh.attributes;
+        attributes.resize(result.vertices_number);
+        MeshOptimizer::remap_vertices(std::as_writable_bytes(std::span(attributes)),
+                                      std::as_bytes(std::span(mesh.attributes)), mr::attributes_bytes_size, result);
+        mesh.attributes = std::move(attributes);
+      }
+
+      for (auto [lod, indices] : std::views::zip(mesh.lods, result.lods)) {
+        lod.indices.assign(indices.begin(), indices.end());
+      }
+    }
+  );
+
+  MeshOptimizer::report(model_path.filename().string(), *results);
+}
+
+// Culling data of mesh computed from its optimized geometry, render thread only uploads it
+struct PreparedMesh {
+  mr::FrustumCuller::BoundBox bounds;
+  std::vector<float> lod_errors;
+  std::optional<mr::OcclusionCuller::Occluder> occluder;
+  mr::ClusterDag cluster_dag; // empty if it isn't built
+  mr::Meshlets meshlets;
+};
+
+// Imported and optimized data of model file
+struct mr::graphics::Model::Imported {
+  std::fs::path model_path;
+  decltype(mr::import(std::declval<std::fs::path>(), mr::importer::Options::All))::value_type model;
+  std::vector<PreparedMesh> meshes; // for each mesh of model
+};
+
+template <typename MeshT>
+static PreparedMesh prepare_mesh(const MeshT &mesh, bool cluster_dag) noexcept
+{
+  using namespace mr;
+
+  auto positions = std::as_bytes(std::span(mesh.positions));
+  PreparedMesh prepared {.bounds = FrustumCuller::BoundBox::from_positions(positions, position_bytes_size)};
+  for (const auto &lod : mesh.lods) {
+    prepared.lod_errors.push_back(LodSelector::estimate_error(positions, position_bytes_size,
+                                                              mesh.lods.front().indices, lod.indices));
+  }
+  // The coarsest LOD is used as occluder
+  prepared.occluder = OcclusionCuller::extract(positions, position_bytes_size, mesh.lods.back().indices);
+  if (cluster_dag) {
+    prepared.cluster_dag = ClusterDag::build(positions, position_bytes_size, mesh.lods.front().indices);
+  }
+  // Meshlets are built from the finest LOD
+  prepared.meshlets = Meshlets::build(positions, position_bytes_size, mesh.lods.front().indices);
+  return prepared;
+}
+
+std::shared_ptr<mr::graphics::Model::Imported> mr::graphics::Model::import(const VulkanState &state,
+                                                                           std::fs::path filename,
+                                                                           bool cluster_dag) noexcept
+{
   std::filesystem::path model_path = path::models_dir / filename;
 
   bool is_1component_supported = mr::TextureImage::is_texture_format_supported(state, vk::Format::eR8Uint);
@@ -55,21 +160,78 @@ mr::graphics::Model::Model(
   auto model = mr::import(model_path, options);
   if (!model) {
     MR_ERROR("Loading model {} failed", model_path.string());
+    return nullptr;
+  }
+
+  optimize_meshes(model_path, model->meshes);
+
+  std::vector<PreparedMesh> meshes(model->meshes.size());
+  std::vector<size_t> mesh_indices(meshes.size());
+  std::iota(mesh_indices.begin(), mesh_indices.end(), 0);
+  std::for_each(std::execution::par, mesh_indices.begin(), mesh_indices.end(),
+    [&](size_t i) { meshes[i] = prepare_mesh(model->meshes[i], cluster_dag); });
+
+  return std::make_shared<Imported>(std::move(model_path), std::move(model.value()), std::move(meshes));
+}
+
+mr::graphics::Model::Model(
+    Scene &scene,
+    std::fs::path filename) noexcept
+  : Model(scene, filename, import(scene.render_context().vulkan_state(), filename, not scene._gpu_culling))
+{
+}
+
+mr::graphics::Model::Model(
+    Scene &scene,
+    std::fs::path filename,
+    std::shared_ptr<Imported> imported) noexcept
+  : _scene(&scene)
+{
+  MR_INFO("Loading model {}", filename.string());
+
+  const auto &state = scene.render_context().vulkan_state();
+
+  if (imported == nullptr) {
     return;
   }
-  auto& model_value = model.value();
+  const auto &model_path = imported->model_path;
+  auto &model_value = imported->model;
 
   using enum mr::MaterialParameter;
   static auto &manager = ResourceManager<Texture>::get();
+
+  // Small textures share atlas pages, so they take less bindless slots and memory
+  TextureAtlasBuilder atlas(state);
+  for (const auto &material : model_value.materials) {
+    for (const auto &texture : material.textures) {
+      atlas.add(texture.image);
+    }
+  }
+  atlas.build();
+
+  // Textures shared by materials are counted once, atlas pages take about as much memory as their sources
+  std::set<const void *> counted_images;
+  for (const auto &material : model_value.materials) {
+    for (const auto &texture : material.textures) {
+      if (counted_images.insert(texture.image.pixels.get()).second) {
+        for (const auto &mip : texture.image.mips) {
+          _gpu_bytes += mip.size();
+        }
+      }
+    }
+  }
+
+  ASSERT(imported->meshes.size() == model_value.meshes.size());
   std::for_each(std::execution::seq, model_value.meshes.begin(), model_value.meshes.end(),
     [&, this] (auto &mesh) {
+      auto &prepared = imported->meshes[_meshes.size()];
       ASSERT(mesh.material < model_value.materials.size(), "Failed to load material from GLTF file");
 
       const auto &material = model_value.materials[mesh.material];
       const auto &transform = mesh.transforms[0];
 
       const size_t instance_count = mesh.transforms.size();
-      const size_t instance_offset = scene._transforms_data.size();
+      const size_t instance_offset = scene._instances.size();
       const size_t mesh_offset = scene._bounds_data.size();
 
       std::array vbufs_data {
@@ -77,6 +239,7 @@ mr::graphics::Model::Model(
         std::as_bytes(std::span(mesh.attributes))
       };
       auto vbufs = scene.render_context().add_vertex_buffers(vbufs_data);
+      _gpu_bytes += vbufs_data[0].size() + vbufs_data[1].size();
 
       std::vector<IndexBufferDescription> ibufs;
       ibufs.reserve(mesh.lods.size());
@@ -85,17 +248,27 @@ mr::graphics::Model::Model(
           .offset = scene.render_context().index_buffer().allocate_and_write(std::span(mesh.lods[j].indices)),
           .elements_count = static_cast<uint32_t>(mesh.lods[j].indices.size())
         });
+        _gpu_bytes += mesh.lods[j].indices.size() * sizeof(uint32_t);
       }
 
-      scene._bounds_data.emplace_back();
+      const auto &bounds = prepared.bounds;
+      uint32_t culler_mesh = scene._culler.add_mesh(bounds, instance_offset, mesh.transforms);
+      ASSERT(culler_mesh == mesh_offset);
+      scene._bounds_data.emplace_back(bounds);
+      // Impostors are drawn only by CPU culling, GPU culling scenes don't bake them
+      bool has_impostor = scene._impostors && not scene._gpu_culling && instance_count >= Impostor::min_instances;
+      uint32_t lod_selector_mesh =
+        scene._lod_selector.add_mesh(bounds, prepared.lod_errors, instance_count, has_impostor);
+      ASSERT(lod_selector_mesh == mesh_offset);
+      if (prepared.occluder) {
+        scene._occlusion_culler.add_occluder(static_cast<uint32_t>(mesh_offset),
+                                             static_cast<uint32_t>(instance_offset),
+                                             std::move(*prepared.occluder), mesh.transforms);
+      }
+      scene._instances.append(static_cast<uint32_t>(mesh_offset), mesh.transforms);
       scene._visibility_data.emplace_back(1);
-      scene._transforms_data.insert(
-        scene._transforms_data.end(),
-        mesh.transforms.begin(),
-        mesh.transforms.end()
-      );
 
-      _meshes.emplace_back(
+      auto &new_mesh = _meshes.emplace_back(
         std::move(vbufs),
         std::move(ibufs),
         instance_count,
@@ -103,19 +276,74 @@ mr::graphics::Model::Model(
         instance_offset
       );
 
+      // Cluster DAG cuts are selected only by CPU culling, so GPU culling scenes don't keep the second
+      // full resolution index copy of large meshes
+      if (not scene._gpu_culling) {
+        new_mesh._cluster_dag = std::move(prepared.cluster_dag);
+      }
+      if (not new_mesh._cluster_dag.empty()) {
+        auto dag_indices = new_mesh._cluster_dag.indices();
+        new_mesh._cluster_ibuf = IndexBufferDescription {
+          .offset = scene.render_context().index_buffer().allocate_and_write(dag_indices),
+          .elements_count = static_cast<uint32_t>(dag_indices.size()),
+        };
+        _gpu_bytes += dag_indices.size_bytes();
+      }
+
+      // Meshlets are culled by GPU culling only
+      auto &meshlets = prepared.meshlets;
+      if (not meshlets.meshlets.empty()) {
+        new_mesh._meshlets_ibuf = IndexBufferDescription {
+          .offset = scene.render_context().index_buffer().allocate_and_write(std::span(meshlets.indices)),
+          .elements_count = static_cast<uint32_t>(meshlets.indices.size()),
+        };
+        _gpu_bytes += meshlets.indices.size() * sizeof(meshlets.indices[0]);
+        uint32_t first_index = static_cast<uint32_t>(new_mesh._meshlets_ibuf.offset / sizeof(uint32_t));
+        for (auto &meshlet : meshlets.meshlets) {
+          meshlet.first_index += first_index;
+        }
+        new_mesh._first_meshlet = static_cast<uint32_t>(scene._meshlets_data.size());
+        new_mesh._meshlets_number = static_cast<uint32_t>(meshlets.meshlets.size());
+        scene._meshlets_data.insert(scene._meshlets_data.end(), meshlets.meshlets.begin(), meshlets.meshlets.end());
+      }
+
       mr::MaterialBuilder builder(scene, "default");
 
       builder.add_camera(scene.camera_uniform_buffer());
       builder.add_value(&material.constants);
       for (const auto &texture : material.textures) {
-        builder.add_texture(importer2graphics(texture.type), texture);
+        if (auto entry = atlas.find(texture.image)) {
+          builder.add_texture(importer2graphics(texture.type), entry->texture, entry->uv_transform);
+        } else {
+          builder.add_texture(importer2graphics(texture.type), texture);
+        }
       }
-      builder.add_storage_buffer(&scene._transforms);
-      builder.add_storage_buffer(&scene._bounds);
-      builder.add_conditional_buffer(&scene._visibility);
+      builder.add_storage_buffer(&scene._transforms.device_buffer());
+      builder.add_storage_buffer(&scene._bounds.device_buffer());
+      builder.add_conditional_buffer(&scene._visibility.device_buffer());
 
       _builders.push_back(std::move(builder));
       _materials.push_back(_builders.back().build());
+
+      // Impostor is baked by the same pipeline as mesh is drawn with
+      if (has_impostor) {
+        Impostor::Sphere sphere {
+          (bounds.min[0] + bounds.max[0]) * 0.5f,
+          (bounds.min[1] + bounds.max[1]) * 0.5f,
+          (bounds.min[2] + bounds.max[2]) * 0.5f,
+          0.5f * std::hypot(bounds.max[0] - bounds.min[0], bounds.max[1] - bounds.min[1],
+                            bounds.max[2] - bounds.min[2]),
+        };
+        auto cache_path = model_cache_path(model_path, std::format("_{}.impostor", _meshes.size() - 1));
+        auto atlases = Impostor::load(cache_path, model_path);
+        if (not atlases) {
+          const auto &material = _materials.back();
+          atlases = scene.render_context().bake_impostor(new_mesh, *material->pipeline(),
+                                                         material->material_ubo_id(), sphere);
+          Impostor::store(cache_path, model_path, *atlases);
+        }
+        new_mesh._impostor.emplace(state, scene.render_context().bindless_set(), *atlases, sphere);
+      }
     }
   );
 
@@ -12,6 +12,10 @@ inline namespace graphics {
   class Model : public ResourceBase<Model> {
     friend class Scene;
 
+    public:
+      // Imported and optimized data of model file, it is prepared without GPU work
+      struct Imported;
+
     private:
       const Scene *_scene = nullptr;
 
@@ -22,10 +26,20 @@ inline namespace graphics {
 
       std::string _name;
 
+      // Vertices, indices and textures uploaded by model
+      size_t _gpu_bytes = 0;
+
     public:
       Model() = default;
 
       Model(Scene &scene, std::fs::path filename) noexcept;
+      // Uploads data imported by 'import', model is empty if it is null
+      Model(Scene &scene, std::fs::path filename, std::shared_ptr<Imported> imported) noexcept;
+
+      // Reads and optimizes model file and computes culling data of its meshes, can be called by any thread.
+      // Cluster DAG is built only if 'cluster_dag' is true, it is used by CPU culling. Returns null if import failed
+      static std::shared_ptr<Imported> import(const VulkanState &state, std::fs::path filename,
+                                              bool cluster_dag) noexcept;
 
       Model(const Model &other) noexcept = default;
       Model &operator=(const Model &other) noexcept = default;
@@ -37,6 +51,7 @@ inline namespace graphics {
       std::span<const mr::graphics::MaterialHandle> materials() const noexcept { return _materials; }
       // First material handle, second mesh reference
       auto draws() const noexcept { return std::views::zip(_materials, _meshes); }
+      size_t gpu_bytes() const noexcept { return _gpu_bytes; }
   };
 
   MR_DECLARE_HANDLE(Model);
@@ -4,6 +4,7 @@
 // libraries includes
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <bitset>
 #include <chrono>
 #include <concepts>
@@ -21,6 +22,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <numeric>
 #include <print>
 #include <queue>
 #include <ranges>
@@ -36,6 +38,7 @@
 #include <boost/container/small_vector.hpp>
 
 #include <tbb/concurrent_hash_map.h>
+#include <tbb/concurrent_queue.h>
 #include <tbb/concurrent_vector.h>
 
 #define VULKAN_HPP_ASSERT_ON_RESULT
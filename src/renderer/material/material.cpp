@@ -13,14 +13,17 @@ mr::graphics::Material::Material(Scene &scene,
                                  mr::graphics::ShaderHandle shader,
                                  std::span<std::byte> ubo_data,
                                  std::span<std::optional<mr::TextureHandle>> textures,
+                                 std::span<const Vec4f> uv_transforms,
                                  std::span<mr::StorageBuffer *> storage_buffers,
                                  std::span<mr::ConditionalBuffer *> conditional_buffers) noexcept
     : _ubo(scene.render_context().vulkan_state(),
-           ubo_data.size() + sizeof(uint32_t) * get_aligned_16_byte(textures.size()))
+           ubo_data.size() + sizeof(uint32_t) * get_aligned_16_byte(textures.size()) + sizeof(Vec4f) * uv_transforms.size())
     , _shader(shader)
     , _scene(&scene)
 {
   ASSERT(_shader.get() != nullptr, "Invalid shader passed to the material", _shader->name());
+  ASSERT(uv_transforms.size() == textures.size(), "Each texture slot must have uv transform");
+  static_assert(sizeof(Vec4f) == 4 * sizeof(float), "uv transforms are read as vec4 array in shader");
 
   std::ranges::copy(textures, _textures.begin());
 
@@ -63,6 +66,10 @@ mr::graphics::Material::Material(Scene &scene,
   std::memcpy(&ubo_data_with_texs[ubo_data.size()],
               _textures_ids.data(),
               textures.size() * sizeof(uint32_t));
+  // uv transforms are placed right after ids padded to vec4 - std140 array alignment
+  std::memcpy(&ubo_data_with_texs[ubo_data.size() + sizeof(uint32_t) * get_aligned_16_byte(textures.size())],
+              uv_transforms.data(),
+              uv_transforms.size() * sizeof(Vec4f));
   _ubo.write(ubo_data_with_texs);
 }
 
@@ -84,6 +91,7 @@ mr::MaterialBuilder::MaterialBuilder(Scene &scene, std::string_view filename)
   : _scene(&scene)
   , _shader_filename(filename)
 {
+  std::ranges::fill(_uv_transforms, Material::default_uv_transform);
 }
 
 mr::MaterialBuilder & mr::MaterialBuilder::add_texture(MaterialParameter param,
@@ -98,10 +106,22 @@ mr::MaterialBuilder & mr::MaterialBuilder::add_texture(MaterialParameter param,
 
   ASSERT(enum_cast(param) < enum_cast(MaterialParameter::EnumSize));
   _textures[enum_cast(param)] = std::move(tex);
+  _uv_transforms[enum_cast(param)] = Material::default_uv_transform;
   // add_value(factor);
   return *this;
 }
 
+mr::MaterialBuilder & mr::MaterialBuilder::add_texture(MaterialParameter param,
+                                                       mr::TextureHandle texture,
+                                                       const Vec4f &uv_transform)
+{
+  ASSERT(texture.get() != nullptr, "Texture should be valid");
+  ASSERT(enum_cast(param) < enum_cast(MaterialParameter::EnumSize));
+  _textures[enum_cast(param)] = std::move(texture);
+  _uv_transforms[enum_cast(param)] = uv_transform;
+  return *this;
+}
+
 mr::MaterialHandle mr::MaterialBuilder::build() noexcept
 {
   ASSERT(_scene != nullptr);
@@ -121,6 +141,7 @@ mr::MaterialHandle mr::MaterialBuilder::build() noexcept
     shdhandle,
     std::span {_ubo_data},
     std::span {_textures},
+    std::span<const Vec4f> {_uv_transforms},
     std::span {_storage_buffers.data(), _storage_buffers.size()},
     std::span {_conditional_buffers.data(), _conditional_buffers.size()}
   );
@@ -53,10 +53,14 @@ inline namespace graphics {
     uint32_t _uniform_buffer_id = -1;
 
   public:
+    // Identity uv transform (xy - scale, zw - bias) of texture which is not packed into atlas
+    static inline const Vec4f default_uv_transform {1, 1, 0, 0};
+
     Material(Scene &scene,
              mr::ShaderHandle shader,
              std::span<std::byte> ubo_data,
              std::span<std::optional<mr::TextureHandle>> textures,
+             std::span<const Vec4f> uv_transforms,
              std::span<mr::StorageBuffer *> storage_buffers,
              std::span<mr::ConditionalBuffer *> conditional_buffers) noexcept;
 
@@ -79,6 +83,7 @@ inline namespace graphics {
     boost::unordered_map<std::string, std::string> _defines;
     std::vector<std::byte> _ubo_data;
     std::array<std::optional<mr::TextureHandle>, enum_cast(MaterialParameter::EnumSize)> _textures;
+    std::array<Vec4f, enum_cast(MaterialParameter::EnumSize)> _uv_transforms;
     InplaceVector<mr::StorageBuffer *, max_attached_buffers / 2> _storage_buffers;
     InplaceVector<mr::ConditionalBuffer *, max_attached_buffers / 2> _conditional_buffers;
     mr::UniformBuffer *_cam_ubo;
@@ -95,6 +100,11 @@ inline namespace graphics {
                                  const mr::importer::TextureData &tex_data,
                                  math::Color factor = {1.0, 1.0, 1.0, 1.0});
 
+    // Add already created texture, e.g. region of atlas page addressed by uv_transform
+    MaterialBuilder & add_texture(MaterialParameter param,
+                                  mr::TextureHandle texture,
+                                  const Vec4f &uv_transform = Material::default_uv_transform);
+
     MaterialBuilder & add_storage_buffer(mr::StorageBuffer *buffer)
     {
       _storage_buffers.push_back(buffer);
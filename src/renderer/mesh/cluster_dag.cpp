@@ -0,0 +1,263 @@
+#include "mesh/cluster_dag.hpp"
+
+#include <meshoptimizer.h>
+
+static constexpr float infinite_error = std::numeric_limits<float>::infinity();
+
+// Group is not simplified further if it loses less triangles
+static constexpr float min_simplification_ratio = 0.85f;
+
+static std::array<float, 3> read_position(std::span<const std::byte> positions, size_t stride, uint32_t index) noexcept
+{
+  std::array<float, 3> position;
+  std::memcpy(position.data(), positions.data() + index * stride, sizeof(position));
+  return position;
+}
+
+static mr::ClusterDag::Sphere bounding_sphere(std::span<const std::byte> positions, size_t stride,
+                                              std::span<const uint32_t> indices) noexcept
+{
+  std::array<float, 3> min {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+  std::array<float, 3> max {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+  for (auto index : indices) {
+    auto position = read_position(positions, stride, index);
+    for (int i = 0; i < 3; i++) {
+      min[i] = std::min(min[i], position[i]);
+      max[i] = std::max(max[i], position[i]);
+    }
+  }
+
+  mr::ClusterDag::Sphere sphere {(min[0] + max[0]) * 0.5f, (min[1] + max[1]) * 0.5f, (min[2] + max[2]) * 0.5f, 0};
+  for (auto index : indices) {
+    auto position = read_position(positions, stride, index);
+    sphere[3] = std::max(sphere[3], std::hypot(position[0] - sphere[0], position[1] - sphere[1], position[2] - sphere[2]));
+  }
+  return sphere;
+}
+
+// Parent sphere encloses children spheres, so projected error never decreases from children to parents
+static mr::ClusterDag::Sphere enclosing_sphere(std::span<const mr::ClusterDag::Sphere> spheres) noexcept
+{
+  std::array<float, 3> min {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+  std::array<float, 3> max {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+  for (const auto &sphere : spheres) {
+    for (int i = 0; i < 3; i++) {
+      min[i] = std::min(min[i], sphere[i] - sphere[3]);
+      max[i] = std::max(max[i], sphere[i] + sphere[3]);
+    }
+  }
+
+  mr::ClusterDag::Sphere result {(min[0] + max[0]) * 0.5f, (min[1] + max[1]) * 0.5f, (min[2] + max[2]) * 0.5f, 0};
+  for (const auto &sphere : spheres) {
+    float distance = std::hypot(sphere[0] - result[0], sphere[1] - result[1], sphere[2] - result[2]);
+    result[3] = std::max(result[3], distance + sphere[3]);
+  }
+  return result;
+}
+
+static std::vector<std::vector<uint32_t>> split_to_clusters(std::span<const std::byte> positions, size_t stride,
+                                                            std::span<const uint32_t> indices) noexcept
+{
+  using mr::ClusterDag;
+
+  size_t vertex_count = positions.size() / stride;
+  size_t max_meshlets = meshopt_buildMeshletsBound(indices.size(),
+    ClusterDag::max_cluster_vertices, ClusterDag::max_cluster_triangles);
+  std::vector<meshopt_Meshlet> meshlets(max_meshlets);
+  std::vector<unsigned int> meshlet_vertices(max_meshlets * ClusterDag::max_cluster_vertices);
+  std::vector<unsigned char> meshlet_triangles(max_meshlets * ClusterDag::max_cluster_triangles * 3);
+
+  size_t meshlets_number = meshopt_buildMeshlets(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(),
+    indices.data(), indices.size(), reinterpret_cast<const float *>(positions.data()), vertex_count, stride,
+    ClusterDag::max_cluster_vertices, ClusterDag::max_cluster_triangles, 0.f);
+
+  std::vector<std::vector<uint32_t>> clusters(meshlets_number);
+  for (size_t i = 0; i < meshlets_number; i++) {
+    const auto &meshlet = meshlets[i];
+    clusters[i].reserve(meshlet.triangle_count * 3);
+    for (uint32_t j = 0; j < meshlet.triangle_count * 3; j++) {
+      uint32_t local_index = meshlet_triangles[meshlet.triangle_offset + j];
+      clusters[i].push_back(meshlet_vertices[meshlet.vertex_offset + local_index]);
+    }
+  }
+  return clusters;
+}
+
+// Greedy grouping of clusters which share the most vertices
+static std::vector<std::vector<uint32_t>> group_clusters(std::span<const std::vector<uint32_t>> clusters_indices) noexcept
+{
+  // Sorted (vertex, cluster) pairs give clusters of each vertex
+  std::vector<std::pair<uint32_t, uint32_t>> vertex_clusters;
+  for (uint32_t cluster = 0; cluster < clusters_indices.size(); cluster++) {
+    for (auto index : clusters_indices[cluster]) {
+      vertex_clusters.emplace_back(index, cluster);
+    }
+  }
+  std::ranges::sort(vertex_clusters);
+  auto [first, last] = std::ranges::unique(vertex_clusters);
+  vertex_clusters.erase(first, last);
+
+  std::vector<boost::unordered_map<uint32_t, uint32_t>> adjacency(clusters_indices.size());
+  for (size_t begin = 0; begin < vertex_clusters.size();) {
+    size_t end = begin;
+    while (end < vertex_clusters.size() && vertex_clusters[end].first == vertex_clusters[begin].first) {
+      end++;
+    }
+    for (size_t i = begin; i < end; i++) {
+      for (size_t j = begin; j < end; j++) {
+        if (i != j) {
+          adjacency[vertex_clusters[i].second][vertex_clusters[j].second]++;
+        }
+      }
+    }
+    begin = end;
+  }
+
+  std::vector<std::vector<uint32_t>> groups;
+  std::vector<bool> grouped(clusters_indices.size(), false);
+  for (uint32_t cluster = 0; cluster < clusters_indices.size(); cluster++) {
+    if (grouped[cluster]) {
+      continue;
+    }
+    auto &group = groups.emplace_back(std::vector {cluster});
+    grouped[cluster] = true;
+
+    while (group.size() < mr::ClusterDag::group_size) {
+      uint32_t best = std::numeric_limits<uint32_t>::max();
+      uint32_t best_shared = 0;
+      for (auto member : group) {
+        for (auto [neighbour, shared] : adjacency[member]) {
+          if (not grouped[neighbour] && shared > best_shared) {
+            best = neighbour;
+            best_shared = shared;
+          }
+        }
+      }
+      if (best_shared == 0) {
+        break;
+      }
+      group.push_back(best);
+      grouped[best] = true;
+    }
+  }
+  return groups;
+}
+
+mr::ClusterDag mr::ClusterDag::build(std::span<const std::byte> positions, size_t stride,
+                                     std::span<const uint32_t> indices) noexcept
+{
+  ASSERT(stride >= 3 * sizeof(float));
+  ASSERT(indices.size() % 3 == 0);
+
+  ClusterDag dag;
+  if (indices.size() / 3 < min_triangles) {
+    return dag;
+  }
+
+  size_t vertex_count = positions.size() / stride;
+  const auto *vertex_positions = reinterpret_cast<const float *>(positions.data());
+  float scale = meshopt_simplifyScale(vertex_positions, vertex_count, stride);
+
+  auto add_cluster = [&dag](std::span<const uint32_t> cluster_indices, const Sphere &sphere, float error) {
+    dag._clusters.emplace_back(Cluster {
+      .first_index = static_cast<uint32_t>(dag._indices.size()),
+      .index_count = static_cast<uint32_t>(cluster_indices.size()),
+      .sphere = sphere,
+      .error = error,
+      .parent_sphere = sphere,
+      .parent_error = infinite_error,
+    });
+    dag._indices.insert(dag._indices.end(), cluster_indices.begin(), cluster_indices.end());
+    return static_cast<uint32_t>(dag._clusters.size() - 1);
+  };
+
+  std::vector<uint32_t> level;
+  for (const auto &cluster_indices : split_to_clusters(positions, stride, indices)) {
+    level.push_back(add_cluster(cluster_indices, bounding_sphere(positions, stride, cluster_indices), 0));
+  }
+  dag._levels_number = 1;
+
+  while (level.size() > 1 && dag._levels_number < max_levels) {
+    std::vector<std::vector<uint32_t>> level_indices;
+    for (auto cluster : level) {
+      auto cluster_indices = std::span(dag._indices).subspan(dag._clusters[cluster].first_index,
+                                                             dag._clusters[cluster].index_count);
+      level_indices.emplace_back(cluster_indices.begin(), cluster_indices.end());
+    }
+
+    std::vector<uint32_t> next_level;
+    for (const auto &group : group_clusters(level_indices)) {
+      std::vector<uint32_t> group_indices;
+      std::vector<Sphere> spheres;
+      float error = 0;
+      for (auto member : group) {
+        group_indices.insert(group_indices.end(), level_indices[member].begin(), level_indices[member].end());
+        spheres.push_back(dag._clusters[level[member]].sphere);
+        error = std::max(error, dag._clusters[level[member]].error);
+      }
+
+      // Borders are locked, so neighbour groups simplified independently stay connected
+      std::vector<uint32_t> simplified(group_indices.size());
+      float simplification_error = 0;
+      size_t target_index_count = group_indices.size() / 6 * 3;
+      size_t simplified_count = meshopt_simplify(simplified.data(), group_indices.data(), group_indices.size(),
+        vertex_positions, vertex_count, stride, target_index_count, std::numeric_limits<float>::max(),
+        meshopt_SimplifyLockBorder, &simplification_error);
+      if (simplified_count == 0 || simplified_count > group_indices.size() * min_simplification_ratio) {
+        continue;
+      }
+      simplified.resize(simplified_count);
+
+      auto group_sphere = enclosing_sphere(spheres);
+      error = std::max(error, simplification_error * scale);
+      for (auto member : group) {
+        dag._clusters[level[member]].parent_sphere = group_sphere;
+        dag._clusters[level[member]].parent_error = error;
+      }
+      for (const auto &cluster_indices : split_to_clusters(positions, stride, simplified)) {
+        next_level.push_back(add_cluster(cluster_indices, group_sphere, error));
+      }
+    }
+
+    if (next_level.empty()) {
+      break;
+    }
+    level = std::move(next_level);
+    dag._levels_number++;
+  }
+
+  MR_INFO("Cluster DAG: {} triangles, {} clusters, {} levels",
+    indices.size() / 3, dag._clusters.size(), dag._levels_number);
+  return dag;
+}
+
+void mr::ClusterDag::select(const std::array<float, 16> &transform, const std::array<float, 4> &w_row,
+                            float pixels_per_unit, float threshold, std::vector<uint32_t> &clusters) const noexcept
+{
+  float scale = 0;
+  for (int j = 0; j < 3; j++) {
+    scale = std::max(scale, std::hypot(transform[j], transform[4 + j], transform[8 + j]));
+  }
+
+  auto projected_error = [&](const Sphere &sphere, float error) {
+    if (error == infinite_error) {
+      return infinite_error;
+    }
+    float world_center[3];
+    for (int i = 0; i < 3; i++) {
+      world_center[i] = transform[4 * i + 0] * sphere[0] + transform[4 * i + 1] * sphere[1] +
+                        transform[4 * i + 2] * sphere[2] + transform[4 * i + 3];
+    }
+    float distance = w_row[0] * world_center[0] + w_row[1] * world_center[1] + w_row[2] * world_center[2] +
+                     w_row[3] - sphere[3] * scale;
+    return error * scale * pixels_per_unit / std::max(distance, 1e-3f);
+  };
+
+  for (uint32_t i = 0; i < _clusters.size(); i++) {
+    const auto &cluster = _clusters[i];
+    if (projected_error(cluster.sphere, cluster.error) <= threshold &&
+        projected_error(cluster.parent_sphere, cluster.parent_error) > threshold) {
+      clusters.push_back(i);
+    }
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef __MR_CLUSTER_DAG_HPP_
+#define __MR_CLUSTER_DAG_HPP_
+
+#include "pch.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Continuous LOD hierarchy of mesh clusters.
+  // Triangles are split to clusters, neighbour clusters are grouped, each group is simplified with locked
+  // borders and split to new clusters again, until mesh can't be simplified further.
+  // Cluster is drawn if its error is small enough on screen and error of group it was simplified to is not,
+  // so different parts of one mesh can be drawn with different detail without cracks.
+  class ClusterDag {
+  public:
+    // Smaller meshes use discrete LODs
+    static inline constexpr uint32_t min_triangles = 4096;
+
+    static inline constexpr uint32_t max_cluster_vertices = 64;
+    static inline constexpr uint32_t max_cluster_triangles = 124;
+    static inline constexpr uint32_t group_size = 4;
+    static inline constexpr uint32_t max_levels = 16;
+
+    // Bounding sphere in mesh space: center and radius
+    using Sphere = std::array<float, 4>;
+
+    struct Cluster {
+      uint32_t first_index; // in DAG indices
+      uint32_t index_count;
+
+      // Sphere and error of group this cluster was built from, zero error for original triangles
+      Sphere sphere;
+      float error;
+      // Sphere and error of group this cluster was simplified in, infinite error for roots
+      Sphere parent_sphere;
+      float parent_error;
+    };
+
+  private:
+    std::vector<Cluster> _clusters;
+    std::vector<uint32_t> _indices;
+    uint32_t _levels_number = 0;
+
+  public:
+    ClusterDag() = default;
+
+    ClusterDag(ClusterDag &&) noexcept = default;
+    ClusterDag & operator=(ClusterDag &&) noexcept = default;
+
+    // Positions are read as 3 floats at the beginning of each 'stride' bytes
+    static ClusterDag build(std::span<const std::byte> positions, size_t stride,
+                            std::span<const uint32_t> indices) noexcept;
+
+    // Appends clusters of DAG cut for instance to 'clusters'.
+    // 'transform' and 'w_row' are raw floats as shaders read them: world coordinate i is row i of transform,
+    // 'w_row' is clip w row of viewproj. 'pixels_per_unit' is projection scale at distance 1
+    void select(const std::array<float, 16> &transform, const std::array<float, 4> &w_row,
+                float pixels_per_unit, float threshold, std::vector<uint32_t> &clusters) const noexcept;
+
+    bool empty() const noexcept { return _clusters.empty(); }
+    std::span<const Cluster> clusters() const noexcept { return _clusters; }
+    std::span<const uint32_t> indices() const noexcept { return _indices; }
+    uint32_t levels_number() const noexcept { return _levels_number; }
+  };
+}
+} // namespace mr
+
+#endif // __MR_CLUSTER_DAG_HPP_
@@ -0,0 +1,225 @@
+#include "mesh/impostor.hpp"
+#include "manager/manager.hpp"
+
+static constexpr uint32_t cache_magic = 0x504D4F49; // "IOMP"
+static constexpr uint32_t cache_version = 2;
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  int64_t model_write_time;
+  uint32_t frames_per_side;
+  uint32_t frame_size;
+};
+
+static int64_t model_write_time(const std::fs::path &model_path) noexcept
+{
+  std::error_code error;
+  auto time = std::fs::last_write_time(model_path, error);
+  return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+// Rounds to nearest, values out of half range become infinities
+static uint16_t to_half(float value) noexcept
+{
+  uint32_t bits = std::bit_cast<uint32_t>(value);
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t float_exponent = (bits >> 23) & 0xFF;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if (float_exponent == 0xFF) {
+    return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+  }
+
+  int32_t exponent = static_cast<int32_t>(float_exponent) - 127 + 15;
+  if (exponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7C00);
+  }
+  if (exponent <= 0) {
+    // Subnormal half, implicit mantissa bit is shifted in
+    if (exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa |= 0x800000;
+    uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    return static_cast<uint16_t>(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+  }
+  // Carry of rounding goes to exponent, it gives the next power of 2 or infinity
+  uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  return static_cast<uint16_t>(half + ((mantissa >> 12) & 1));
+}
+
+// Direction of frame center on octahedron unwrapped to square, y is up
+static std::array<float, 3> frame_direction(uint32_t frame_x, uint32_t frame_y) noexcept
+{
+  float u = (frame_x + 0.5f) / mr::Impostor::frames_per_side * 2 - 1;
+  float v = (frame_y + 0.5f) / mr::Impostor::frames_per_side * 2 - 1;
+  std::array<float, 3> direction {u, 1 - std::abs(u) - std::abs(v), v};
+  if (direction[1] < 0) {
+    direction[0] = (1 - std::abs(v)) * std::copysign(1.f, u);
+    direction[2] = (1 - std::abs(u)) * std::copysign(1.f, v);
+  }
+  float length = std::hypot(direction[0], direction[1], direction[2]);
+  for (auto &coordinate : direction) {
+    coordinate /= length;
+  }
+  return direction;
+}
+
+mr::Impostor::Impostor(const VulkanState &state, BindlessDescriptorSet &bindless_set,
+                       std::span<const std::vector<std::byte>> atlases, const Sphere &sphere) noexcept
+  : _bindless_set(&bindless_set)
+  , _sphere(sphere)
+{
+  ASSERT(atlases.size() == atlases_number);
+
+  auto &manager = ResourceManager<Texture>::get();
+  for (uint32_t i = 0; i < atlases_number; i++) {
+    ASSERT(atlases[i].size() == atlas_bytes_size(i));
+    _atlases[i] = manager.create(mr::unnamed, state, atlases[i].data(), Extent {atlas_size, atlas_size},
+                                 atlas_formats[i]);
+    _atlas_ids[i] = _bindless_set->register_resource(_atlases[i].get());
+  }
+}
+
+mr::Impostor::~Impostor()
+{
+  if (_bindless_set == nullptr) {
+    return;
+  }
+  for (const auto &atlas : _atlases) {
+    _bindless_set->unregister_resource(atlas.get());
+  }
+}
+
+mr::Impostor::DrawInfo mr::Impostor::draw_info(uint32_t camera_buffer_id, uint32_t transforms_buffer_id,
+                                               uint32_t visible_instances_buffer_id) const noexcept
+{
+  return DrawInfo {
+    .atlas_ids = _atlas_ids,
+    .camera_buffer_id = camera_buffer_id,
+    .transforms_buffer_id = transforms_buffer_id,
+    .sphere = _sphere,
+    .visible_instances_buffer_id = visible_instances_buffer_id,
+  };
+}
+
+std::vector<std::byte> mr::Impostor::pack_atlas(uint32_t atlas, std::span<const std::byte> baked) noexcept
+{
+  constexpr size_t texels_number = atlas_size * atlas_size;
+  ASSERT(baked.size() == texels_number * 4 * sizeof(float));
+
+  std::vector<float> values(texels_number * 4);
+  std::memcpy(values.data(), baked.data(), baked.size());
+
+  std::vector<std::byte> packed(atlas_bytes_size(atlas));
+  if (atlas_formats[atlas] == vk::Format::eR8G8B8A8Unorm) {
+    for (size_t i = 0; i < values.size(); i++) {
+      packed[i] = static_cast<std::byte>(std::clamp(values[i], 0.f, 1.f) * 255 + 0.5f);
+    }
+  } else {
+    std::vector<uint16_t> halfs(values.size());
+    std::ranges::transform(values, halfs.begin(), to_half);
+    std::memcpy(packed.data(), halfs.data(), packed.size());
+  }
+  return packed;
+}
+
+std::array<float, 16> mr::Impostor::frame_viewproj(const Sphere &sphere, uint32_t frame_x, uint32_t frame_y) noexcept
+{
+  // Frame basis, must be the same as in impostor shader
+  auto direction = frame_direction(frame_x, frame_y);
+  std::array<float, 3> up_reference = std::abs(direction[1]) > 0.99f
+    ? std::array {0.f, 0.f, 1.f}
+    : std::array {0.f, 1.f, 0.f};
+  std::array<float, 3> right {
+    up_reference[1] * direction[2] - up_reference[2] * direction[1],
+    up_reference[2] * direction[0] - up_reference[0] * direction[2],
+    up_reference[0] * direction[1] - up_reference[1] * direction[0],
+  };
+  float right_length = std::hypot(right[0], right[1], right[2]);
+  for (auto &coordinate : right) {
+    coordinate /= right_length;
+  }
+  std::array<float, 3> up {
+    direction[1] * right[2] - direction[2] * right[1],
+    direction[2] * right[0] - direction[0] * right[2],
+    direction[0] * right[1] - direction[1] * right[0],
+  };
+
+  // Orthographic projection of sphere to frame rect, camera is on the side of direction.
+  // Vertex shader negates clip y, so y row is negated here
+  float radius = std::max(sphere[3], 1e-6f);
+  float scale = 1.f / (radius * frames_per_side);
+  float frame_center_x = -1 + (2.f * frame_x + 1) / frames_per_side;
+  float frame_center_y = -1 + (2.f * frame_y + 1) / frames_per_side;
+  auto dot_center = [&sphere](const std::array<float, 3> &axis) {
+    return axis[0] * sphere[0] + axis[1] * sphere[1] + axis[2] * sphere[2];
+  };
+
+  // Clip coordinate k is sum of vp[4 * j + k] * position[j] and vp[12 + k]
+  std::array<float, 16> vp {};
+  for (int j = 0; j < 3; j++) {
+    vp[4 * j + 0] = right[j] * scale;
+    vp[4 * j + 1] = up[j] * scale;
+    vp[4 * j + 2] = -direction[j] / (2 * radius);
+  }
+  vp[12] = frame_center_x - dot_center(right) * scale;
+  vp[13] = -frame_center_y - dot_center(up) * scale;
+  vp[14] = 0.5f + dot_center(direction) / (2 * radius);
+  vp[15] = 1;
+  return vp;
+}
+
+std::optional<std::vector<std::vector<std::byte>>> mr::Impostor::load(const std::fs::path &cache_path,
+                                                                     const std::fs::path &model_path) noexcept
+{
+  std::ifstream file(cache_path, std::ios::binary);
+  if (not file) {
+    return std::nullopt;
+  }
+
+  CacheHeader header;
+  file.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (not file || header.magic != cache_magic || header.version != cache_version ||
+      header.model_write_time != model_write_time(model_path) ||
+      header.frames_per_side != frames_per_side || header.frame_size != frame_size) {
+    return std::nullopt;
+  }
+
+  std::vector<std::vector<std::byte>> atlases(atlases_number);
+  for (uint32_t i = 0; i < atlases_number; i++) {
+    auto &atlas = atlases[i];
+    atlas.resize(atlas_bytes_size(i));
+    file.read(reinterpret_cast<char *>(atlas.data()), static_cast<std::streamsize>(atlas.size()));
+    if (not file) {
+      return std::nullopt;
+    }
+  }
+  return atlases;
+}
+
+void mr::Impostor::store(const std::fs::path &cache_path, const std::fs::path &model_path,
+                         std::span<const std::vector<std::byte>> atlases) noexcept
+{
+  ASSERT(atlases.size() == atlases_number);
+
+  std::error_code error;
+  std::fs::create_directories(cache_path.parent_path(), error);
+  std::ofstream file(cache_path, std::ios::binary | std::ios::trunc);
+  if (not file) {
+    MR_WARNING("Cannot write impostor cache {}", cache_path.string());
+    return;
+  }
+
+  CacheHeader header {
+    .magic = cache_magic,
+    .version = cache_version,
+    .model_write_time = model_write_time(model_path),
+    .frames_per_side = frames_per_side,
+    .frame_size = frame_size,
+  };
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (const auto &atlas : atlases) {
+    file.write(reinterpret_cast<const char *>(atlas.data()), static_cast<std::streamsize>(atlas.size()));
+  }
+}
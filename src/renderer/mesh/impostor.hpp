@@ -0,0 +1,98 @@
+#ifndef __MR_IMPOSTOR_HPP_
+#define __MR_IMPOSTOR_HPP_
+
+#include "pch.hpp"
+#include "resources/resources.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Octahedral impostor of mesh for far instances.
+  // Mesh is rendered by its material pipeline from directions of octahedron unwrapped to square grid of frames,
+  // each geometry buffer is baked to its own atlas. Far instance is drawn as one quad in plane of the frame
+  // nearest to view direction, fragments take geometry buffers data from atlases, so lighting doesn't change.
+  class Impostor {
+  public:
+    static inline constexpr uint32_t frames_per_side = 8;
+    static inline constexpr uint32_t frames_number = frames_per_side * frames_per_side;
+    static inline constexpr uint32_t frame_size = 32; // in pixels
+    static inline constexpr uint32_t atlas_size = frames_per_side * frame_size;
+    // One atlas for each geometry buffer
+    static inline constexpr uint32_t atlases_number = 6;
+    // Frames are rendered to geometry buffers format, then texels are packed to smaller atlas formats:
+    // 16 bit floats for positions, normals and emission, 8 bit normalized values for the rest
+    static inline constexpr vk::Format baked_format = vk::Format::eR32G32B32A32Sfloat;
+    static inline constexpr std::array<vk::Format, atlases_number> atlas_formats {
+      vk::Format::eR16G16B16A16Sfloat, // position in mesh space, alpha is coverage
+      vk::Format::eR16G16B16A16Sfloat, // normal and shade flag
+      vk::Format::eR8G8B8A8Unorm,      // occlusion, metallic, roughness
+      vk::Format::eR16G16B16A16Sfloat, // emissive color
+      vk::Format::eR8G8B8A8Unorm,      // occlusion
+      vk::Format::eR8G8B8A8Unorm,      // color and transparency
+    };
+    // Impostors are baked only for meshes with many instances, they cost 6 atlases each
+    static inline constexpr uint32_t min_instances = 16;
+
+    // Bounding sphere in mesh space: center and radius
+    using Sphere = std::array<float, 4>;
+
+    // Render data of impostor instances of mesh, layout is the same as in impostor shader
+    struct DrawInfo {
+      std::array<uint32_t, atlases_number> atlas_ids;
+      uint32_t camera_buffer_id;
+      uint32_t transforms_buffer_id;
+      Sphere sphere;
+      uint32_t visible_instances_buffer_id;
+      uint32_t _padding[3];
+    };
+    static_assert(sizeof(DrawInfo) == 64);
+
+  private:
+    BindlessDescriptorSet *_bindless_set = nullptr;
+    std::array<TextureHandle, atlases_number> _atlases;
+    std::array<uint32_t, atlases_number> _atlas_ids {};
+    Sphere _sphere {};
+
+  public:
+    Impostor() = default;
+    // 'atlases' are tightly packed texels of baked geometry buffers
+    Impostor(const VulkanState &state, BindlessDescriptorSet &bindless_set,
+             std::span<const std::vector<std::byte>> atlases, const Sphere &sphere) noexcept;
+
+    Impostor(Impostor &&other) noexcept { *this = std::move(other); }
+    Impostor & operator=(Impostor &&other) noexcept
+    {
+      std::swap(_bindless_set, other._bindless_set);
+      std::swap(_atlases, other._atlases);
+      std::swap(_atlas_ids, other._atlas_ids);
+      std::swap(_sphere, other._sphere);
+      return *this;
+    }
+
+    ~Impostor();
+
+    DrawInfo draw_info(uint32_t camera_buffer_id, uint32_t transforms_buffer_id,
+                       uint32_t visible_instances_buffer_id) const noexcept;
+
+    const Sphere & sphere() const noexcept { return _sphere; }
+
+    // Raw floats of view projection which maps bounding sphere seen from direction of frame
+    // to frame rect of atlas, in the same layout as shaders read matrices
+    static std::array<float, 16> frame_viewproj(const Sphere &sphere, uint32_t frame_x, uint32_t frame_y) noexcept;
+
+    static size_t atlas_bytes_size(uint32_t atlas) noexcept
+    {
+      return atlas_size * atlas_size * (atlas_formats[atlas] == vk::Format::eR8G8B8A8Unorm ? 4 : 8);
+    }
+    // Converts texels of atlas rendered in 'baked_format' to its atlas format
+    static std::vector<std::byte> pack_atlas(uint32_t atlas, std::span<const std::byte> baked) noexcept;
+
+    // Baked atlases cache, it is valid while model file is not modified
+    static std::optional<std::vector<std::vector<std::byte>>> load(const std::fs::path &cache_path,
+                                                                   const std::fs::path &model_path) noexcept;
+    static void store(const std::fs::path &cache_path, const std::fs::path &model_path,
+                      std::span<const std::vector<std::byte>> atlases) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_IMPOSTOR_HPP_
@@ -3,6 +3,9 @@
 
 #include "pch.hpp"
 #include "resources/resources.hpp"
+#include "mesh/cluster_dag.hpp"
+#include "mesh/meshlets.hpp"
+#include "mesh/impostor.hpp"
 #include <vulkan/vulkan_core.h>
 
 namespace mr {
@@ -23,13 +26,27 @@ inline namespace graphics {
       uint32_t material_ubo_id;
       uint32_t camera_buffer_id;
       uint32_t transforms_buffer_id;
+      uint32_t visible_instances_buffer_id;
     };
 
   private:
     VertexBuffersArray _vbufs;
     std::vector<IndexBufferDescription> _ibufs;
 
-    std::atomic<uint32_t> _instance_count = 0;
+    // Continuous LOD of large meshes, used by CPU culling instead of discrete LODs in '_ibufs' if not empty.
+    // It is built only if mesh is created while CPU culling is enabled
+    ClusterDag _cluster_dag;
+    IndexBufferDescription _cluster_ibuf {};
+
+    // Meshlets culled by GPU, their data is in the scene meshlets buffer
+    uint32_t _first_meshlet = 0;
+    uint32_t _meshlets_number = 0;
+    IndexBufferDescription _meshlets_ibuf {};
+
+    // Drawn instead of far instances, baked only for meshes with many instances
+    std::optional<Impostor> _impostor;
+
+    uint32_t _instance_count = 0;
 
     uint32_t _mesh_offset = 0;     // offset to the *per mesh*     data buffer in the scene
     uint32_t _instance_offset = 0; // offset to the *per instance* data buffer in the scene
@@ -50,17 +67,28 @@ inline namespace graphics {
     {
       _vbufs = std::move(other._vbufs);
       _ibufs = std::move(other._ibufs);
-      _instance_count = std::move(other._instance_count.load());
+      _cluster_dag = std::move(other._cluster_dag);
+      _cluster_ibuf = other._cluster_ibuf;
+      _first_meshlet = other._first_meshlet;
+      _meshlets_number = other._meshlets_number;
+      _meshlets_ibuf = other._meshlets_ibuf;
+      _impostor = std::move(other._impostor);
+      _instance_count = other._instance_count;
       _mesh_offset = std::move(other._mesh_offset);
       _instance_offset = std::move(other._instance_offset);
 
       return *this;
     }
 
-    std::atomic<uint32_t> & num_of_instances() noexcept { return _instance_count; }
-    uint32_t num_of_instances() const noexcept { return _instance_count.load(); }
+    uint32_t num_of_instances() const noexcept { return _instance_count; }
+    // Index of the first instance in scene instance columns, instances of mesh are contiguous
+    uint32_t instance_offset() const noexcept { return _instance_offset; }
     // uint32_t element_count() const noexcept { return _ibufs[0].element_count(); }
     uint32_t element_count() const noexcept { return _ibufs[0].elements_count; }
+
+    const ClusterDag & cluster_dag() const noexcept { return _cluster_dag; }
+    uint32_t meshlets_number() const noexcept { return _meshlets_number; }
+    bool has_impostor() const noexcept { return _impostor.has_value(); }
   };
 }
 }     // namespace mr
@@ -0,0 +1,182 @@
+#include "mesh/mesh_optimizer.hpp"
+
+#include <meshoptimizer.h>
+
+// Cache file format: header, then for each mesh its sizes, stats, remap and LODs indices
+static constexpr uint32_t cache_magic = 0x4F48534D; // "MSHO"
+static constexpr uint32_t cache_version = 1;
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  int64_t model_write_time;
+  uint32_t meshes_number;
+};
+
+static int64_t model_write_time(const std::fs::path &model_path) noexcept
+{
+  std::error_code error;
+  auto time = std::fs::last_write_time(model_path, error);
+  return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+mr::MeshOptimizer::Result mr::MeshOptimizer::optimize(std::span<const std::byte> positions, size_t stride,
+                                                      size_t vertex_bytes_size,
+                                                      std::span<const std::span<const uint32_t>> lods) noexcept
+{
+  ASSERT(stride >= 3 * sizeof(float));
+  ASSERT(not lods.empty());
+
+  size_t vertex_count = positions.size() / stride;
+  const auto *vertex_positions = reinterpret_cast<const float *>(positions.data());
+
+  Result result;
+  const auto &finest = lods.front();
+  result.stats.triangles_number = static_cast<uint32_t>(finest.size() / 3);
+  result.stats.acmr_before =
+    meshopt_analyzeVertexCache(finest.data(), finest.size(), vertex_count, cache_size, 0, 0).acmr;
+  result.stats.overfetch_before =
+    meshopt_analyzeVertexFetch(finest.data(), finest.size(), vertex_count, vertex_bytes_size).overfetch;
+
+  for (const auto &lod : lods) {
+    ASSERT(lod.size() % 3 == 0);
+    auto &indices = result.lods.emplace_back(lod.size());
+    meshopt_optimizeVertexCache(indices.data(), lod.data(), lod.size(), vertex_count);
+    meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(),
+                             vertex_positions, vertex_count, stride, overdraw_threshold);
+  }
+
+  // Vertices are ordered by first use in the finest LOD, vertices used only by coarser LODs go after them
+  std::vector<uint32_t> all_indices;
+  for (const auto &indices : result.lods) {
+    all_indices.insert(all_indices.end(), indices.begin(), indices.end());
+  }
+  result.remap.resize(vertex_count);
+  result.vertices_number = static_cast<uint32_t>(meshopt_optimizeVertexFetchRemap(result.remap.data(),
+    all_indices.data(), all_indices.size(), vertex_count));
+  for (auto &indices : result.lods) {
+    meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), result.remap.data());
+  }
+
+  const auto &optimized = result.lods.front();
+  result.stats.acmr_after =
+    meshopt_analyzeVertexCache(optimized.data(), optimized.size(), result.vertices_number, cache_size, 0, 0).acmr;
+  result.stats.overfetch_after = meshopt_analyzeVertexFetch(optimized.data(), optimized.size(),
+                                                            result.vertices_number, vertex_bytes_size).overfetch;
+  return result;
+}
+
+void mr::MeshOptimizer::remap_vertices(std::span<std::byte> dst, std::span<const std::byte> src, size_t vertex_size,
+                                       const Result &result) noexcept
+{
+  ASSERT(src.size() == result.remap.size() * vertex_size);
+  ASSERT(dst.size() == result.vertices_number * vertex_size);
+  meshopt_remapVertexBuffer(dst.data(), src.data(), result.remap.size(), vertex_size, result.remap.data());
+}
+
+std::optional<std::vector<mr::MeshOptimizer::Result>> mr::MeshOptimizer::load(const std::fs::path &cache_path,
+                                                                              const std::fs::path &model_path) noexcept
+{
+  std::ifstream file(cache_path, std::ios::binary);
+  if (not file) {
+    return std::nullopt;
+  }
+
+  auto read = [&file](void *data, size_t size) {
+    file.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(size));
+    return static_cast<bool>(file);
+  };
+  auto read_vector = [&](std::vector<uint32_t> &vector) {
+    uint32_t size = 0;
+    if (not read(&size, sizeof(size))) {
+      return false;
+    }
+    vector.resize(size);
+    return read(vector.data(), size * sizeof(uint32_t));
+  };
+
+  CacheHeader header;
+  if (not read(&header, sizeof(header)) || header.magic != cache_magic || header.version != cache_version ||
+      header.model_write_time != model_write_time(model_path)) {
+    return std::nullopt;
+  }
+
+  std::vector<Result> results(header.meshes_number);
+  for (auto &result : results) {
+    uint32_t lods_number = 0;
+    if (not read(&result.stats, sizeof(result.stats)) ||
+        not read(&result.vertices_number, sizeof(result.vertices_number)) ||
+        not read_vector(result.remap) ||
+        not read(&lods_number, sizeof(lods_number))) {
+      return std::nullopt;
+    }
+    result.lods.resize(lods_number);
+    for (auto &lod : result.lods) {
+      if (not read_vector(lod)) {
+        return std::nullopt;
+      }
+    }
+  }
+  return results;
+}
+
+void mr::MeshOptimizer::store(const std::fs::path &cache_path, const std::fs::path &model_path,
+                              std::span<const Result> results) noexcept
+{
+  std::error_code error;
+  std::fs::create_directories(cache_path.parent_path(), error);
+  std::ofstream file(cache_path, std::ios::binary | std::ios::trunc);
+  if (not file) {
+    MR_WARNING("Cannot write mesh optimization cache {}", cache_path.string());
+    return;
+  }
+
+  auto write = [&file](const void *data, size_t size) {
+    file.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+  };
+  auto write_vector = [&](std::span<const uint32_t> vector) {
+    uint32_t size = static_cast<uint32_t>(vector.size());
+    write(&size, sizeof(size));
+    write(vector.data(), vector.size_bytes());
+  };
+
+  CacheHeader header {
+    .magic = cache_magic,
+    .version = cache_version,
+    .model_write_time = model_write_time(model_path),
+    .meshes_number = static_cast<uint32_t>(results.size()),
+  };
+  write(&header, sizeof(header));
+  for (const auto &result : results) {
+    write(&result.stats, sizeof(result.stats));
+    write(&result.vertices_number, sizeof(result.vertices_number));
+    write_vector(result.remap);
+    uint32_t lods_number = static_cast<uint32_t>(result.lods.size());
+    write(&lods_number, sizeof(lods_number));
+    for (const auto &lod : result.lods) {
+      write_vector(lod);
+    }
+  }
+}
+
+void mr::MeshOptimizer::report(std::string_view model_name, std::span<const Result> results) noexcept
+{
+  Stats total;
+  for (const auto &result : results) {
+    float weight = static_cast<float>(result.stats.triangles_number);
+    total.triangles_number += result.stats.triangles_number;
+    total.acmr_before += result.stats.acmr_before * weight;
+    total.acmr_after += result.stats.acmr_after * weight;
+    total.overfetch_before += result.stats.overfetch_before * weight;
+    total.overfetch_after += result.stats.overfetch_after * weight;
+  }
+  if (total.triangles_number == 0) {
+    return;
+  }
+
+  float triangles_number = static_cast<float>(total.triangles_number);
+  MR_INFO("Mesh optimization of {}: {} triangles, ACMR {:.3f} -> {:.3f}, overfetch {:.3f} -> {:.3f}",
+    model_name, total.triangles_number,
+    total.acmr_before / triangles_number, total.acmr_after / triangles_number,
+    total.overfetch_before / triangles_number, total.overfetch_after / triangles_number);
+}
@@ -0,0 +1,56 @@
+#ifndef __MR_MESH_OPTIMIZER_HPP_
+#define __MR_MESH_OPTIMIZER_HPP_
+
+#include "pch.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Import time reordering of mesh data for GPU.
+  // Triangles of each LOD are reordered for post-transform vertex cache hits, then clusters of them are reordered
+  // to draw outer ones first (view independent overdraw heuristic), then vertices are sorted by first use
+  // in indices for vertex fetch locality. Results of model are cached in file, so it is done once per asset.
+  class MeshOptimizer {
+  public:
+    // Post-transform cache size for ACMR estimation, typical for desktop GPUs
+    static inline constexpr uint32_t cache_size = 16;
+    // Overdraw reordering can make ACMR worse at most by this factor
+    static inline constexpr float overdraw_threshold = 1.05f;
+
+    // Statistics of the finest LOD
+    struct Stats {
+      uint32_t triangles_number = 0;
+      float acmr_before = 0;      // average cache miss ratio: transformed vertices per triangle
+      float acmr_after = 0;
+      float overfetch_before = 0; // fetched vertex bytes per vertex data bytes
+      float overfetch_after = 0;
+    };
+
+    struct Result {
+      std::vector<uint32_t> remap;             // new index of each vertex, ~0 for unused vertices
+      uint32_t vertices_number = 0;            // vertices number after remap
+      std::vector<std::vector<uint32_t>> lods; // indices of each LOD, they refer to new vertices
+      Stats stats;
+    };
+
+    // Positions are read as 3 floats at the beginning of each 'stride' bytes,
+    // 'vertex_bytes_size' is size of all vertex attributes for overfetch estimation
+    static Result optimize(std::span<const std::byte> positions, size_t stride, size_t vertex_bytes_size,
+                           std::span<const std::span<const uint32_t>> lods) noexcept;
+
+    // Writes vertices of 'src' to their new places in 'dst', 'dst' must have space for 'vertices_number' vertices
+    static void remap_vertices(std::span<std::byte> dst, std::span<const std::byte> src, size_t vertex_size,
+                               const Result &result) noexcept;
+
+    // Cache is valid while model file is not modified
+    static std::optional<std::vector<Result>> load(const std::fs::path &cache_path,
+                                                   const std::fs::path &model_path) noexcept;
+    static void store(const std::fs::path &cache_path, const std::fs::path &model_path,
+                      std::span<const Result> results) noexcept;
+
+    // Logs ACMR and overfetch of model weighted by triangles numbers of meshes
+    static void report(std::string_view model_name, std::span<const Result> results) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_MESH_OPTIMIZER_HPP_
@@ -0,0 +1,54 @@
+#include "mesh/meshlets.hpp"
+
+#include <meshoptimizer.h>
+
+mr::Meshlets mr::Meshlets::build(std::span<const std::byte> positions, size_t stride,
+                                 std::span<const uint32_t> indices) noexcept
+{
+  ASSERT(stride >= 3 * sizeof(float));
+  ASSERT(indices.size() % 3 == 0);
+
+  Meshlets result;
+  if (indices.size() / 3 < min_triangles) {
+    return result;
+  }
+
+  size_t vertex_count = positions.size() / stride;
+  const auto *vertex_positions = reinterpret_cast<const float *>(positions.data());
+
+  size_t max_meshlets = meshopt_buildMeshletsBound(indices.size(), max_vertices, max_triangles);
+  std::vector<meshopt_Meshlet> meshlets(max_meshlets);
+  std::vector<unsigned int> meshlet_vertices(max_meshlets * max_vertices);
+  std::vector<unsigned char> meshlet_triangles(max_meshlets * max_triangles * 3);
+
+  // Cone weight makes meshlets flatter, so more of them can be culled as backfacing
+  constexpr float cone_weight = 0.25f;
+  size_t meshlets_number = meshopt_buildMeshlets(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(),
+    indices.data(), indices.size(), vertex_positions, vertex_count, stride,
+    max_vertices, max_triangles, cone_weight);
+
+  result.meshlets.reserve(meshlets_number);
+  for (size_t i = 0; i < meshlets_number; i++) {
+    const auto &meshlet = meshlets[i];
+    auto bounds = meshopt_computeMeshletBounds(&meshlet_vertices[meshlet.vertex_offset],
+      &meshlet_triangles[meshlet.triangle_offset], meshlet.triangle_count,
+      vertex_positions, vertex_count, stride);
+
+    result.meshlets.emplace_back(Meshlet {
+      .center = {bounds.center[0], bounds.center[1], bounds.center[2]},
+      .radius = bounds.radius,
+      .cone_apex = {bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2]},
+      .cone_cutoff = bounds.cone_cutoff,
+      .cone_axis = {bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2]},
+      .first_index = static_cast<uint32_t>(result.indices.size()),
+      .index_count = meshlet.triangle_count * 3,
+    });
+
+    // Meshlets are drawn by ordinary index buffer, so local triangles are converted to mesh indices
+    for (uint32_t j = 0; j < meshlet.triangle_count * 3; j++) {
+      uint32_t local_index = meshlet_triangles[meshlet.triangle_offset + j];
+      result.indices.push_back(meshlet_vertices[meshlet.vertex_offset + local_index]);
+    }
+  }
+  return result;
+}
@@ -0,0 +1,40 @@
+#ifndef __MR_MESHLETS_HPP_
+#define __MR_MESHLETS_HPP_
+
+#include "pch.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Small clusters of mesh triangles which are culled separately by GPU.
+  // Each meshlet has bounding sphere and normal cone, so it can be rejected by frustum
+  // and if all its triangles are backfacing.
+  struct Meshlets {
+    static inline constexpr uint32_t max_vertices = 64;
+    static inline constexpr uint32_t max_triangles = 124;
+    // Smaller meshes are culled only as whole
+    static inline constexpr uint32_t min_triangles = 2048;
+
+    // Layout is the same as in culling shader
+    struct Meshlet {
+      std::array<float, 3> center;
+      float radius;
+      std::array<float, 3> cone_apex;
+      float cone_cutoff;
+      std::array<float, 3> cone_axis;
+      uint32_t first_index; // in index buffer
+      uint32_t index_count;
+      uint32_t _padding[3];
+    };
+    static_assert(sizeof(Meshlet) == 64);
+
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> indices; // triangles of all meshlets, 'first_index' of meshlets is offset in it
+
+    // Positions are read as 3 floats at the beginning of each 'stride' bytes
+    static Meshlets build(std::span<const std::byte> positions, size_t stride,
+                          std::span<const uint32_t> indices) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_MESHLETS_HPP_
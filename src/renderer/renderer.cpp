@@ -16,11 +16,27 @@ mr::Application::~Application() {}
 }
 
 void mr::Application::start_render_loop(RenderContext &render_context, SceneHandle scene,
-                                                                       WindowHandle window) const noexcept
+                                                                       WindowHandle window,
+                                       const RenderLoopOptions &options) const noexcept
 {
   std::jthread render_thread {
     [&](std::stop_token stop_token) {
+      uint64_t handled_requests = 0;
+      auto last_frame = std::chrono::steady_clock::now() - options.min_frame_interval;
       while (not stop_token.stop_requested()) {
+        if (options.on_demand) {
+          // Requests made during update and render are handled by the next frame
+          scene->wait_frame_request(handled_requests);
+          handled_requests = scene->frame_requests();
+          if (stop_token.stop_requested()) {
+            break;
+          }
+        }
+        if (options.min_frame_interval.count() > 0) {
+          std::this_thread::sleep_until(last_frame + options.min_frame_interval);
+          last_frame = std::chrono::steady_clock::now();
+        }
+
         window->update_state();
         scene->update(std::optional(std::reference_wrapper(window->input_state())));
         render_context.render(scene, *window);
@@ -28,10 +44,15 @@ void mr::Application::start_render_loop(RenderContext &render_context, SceneHand
     }
   };
 
-  // TMP theme
+  // Main thread sleeps until window events, each of them can change what is rendered
   while (not window->window().shouldClose().value) {
-    vkfw::pollEvents();
+    vkfw::waitEvents();
+    scene->request_frame();
   }
+
+  // Render thread can wait for frame request
+  render_thread.request_stop();
+  scene->request_frame();
 }
 
 
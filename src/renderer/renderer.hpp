@@ -17,6 +17,15 @@
 namespace mr {
 inline namespace graphics {
   class Application {
+    public:
+      struct RenderLoopOptions {
+        // Render thread sleeps until input, window resize or scene change requests frame,
+        // otherwise frames are rendered continuously
+        bool on_demand = false;
+        // Frames are not rendered more often than this
+        std::chrono::microseconds min_frame_interval {0};
+      };
+
     private:
       VulkanGlobalState _state;
 
@@ -27,7 +36,14 @@ inline namespace graphics {
       [[nodiscard]] std::unique_ptr<RenderContext> create_render_context(Extent extent);
 
       void start_render_loop(RenderContext &render_context, SceneHandle scene,
-                                                            WindowHandle window) const noexcept;
+                                                            WindowHandle window,
+                             const RenderLoopOptions &options) const noexcept;
+      // Default options of nested struct can't be default argument inside of class definition
+      void start_render_loop(RenderContext &render_context, SceneHandle scene,
+                                                            WindowHandle window) const noexcept
+      {
+        start_render_loop(render_context, std::move(scene), std::move(window), RenderLoopOptions {});
+      }
 
       void render_frames(RenderContext &render_context,
                          SceneHandle scene,
@@ -6,6 +6,17 @@
 
 #include "window/render_context.hpp"
 
+// Descriptor buffers address uniform and storage buffers by device address
+static vk::BufferUsageFlags get_buffer_usage(const mr::VulkanState &state, vk::BufferUsageFlags usage_flags) noexcept
+{
+  constexpr vk::BufferUsageFlags descriptor_usage =
+    vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+  if (state.descriptor_buffer_supported() && (usage_flags & descriptor_usage)) {
+    usage_flags |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+  }
+  return usage_flags;
+}
+
 // constructor
 mr::Buffer::Buffer(const VulkanState &state, size_t byte_size,
                    vk::BufferUsageFlags usage_flags,
@@ -31,7 +42,7 @@ std::pair<vk::Buffer, VmaAllocation> mr::Buffer::create_buffer(const VulkanState
 {
   vk::BufferCreateInfo buffer_create_info {
     .size = byte_size,
-    .usage = usage_flags,
+    .usage = get_buffer_usage(state, usage_flags),
     .sharingMode = vk::SharingMode::eExclusive,
   };
 
@@ -105,6 +116,14 @@ std::span<const std::byte> mr::HostBuffer::read() noexcept
   return std::span(reinterpret_cast<const std::byte *>(_mapped_data.get()), _size);
 }
 
+std::span<std::byte> mr::HostBuffer::mapped_data() noexcept
+{
+  if (not _mapped_data.mapped()) {
+    _mapped_data.map();
+  }
+  return std::span(reinterpret_cast<std::byte *>(_mapped_data.get()), _size);
+}
+
 std::vector<std::byte> mr::HostBuffer::copy() noexcept
 {
   std::vector<std::byte> data(_size);
@@ -203,6 +222,38 @@ mr::DeviceBuffer & mr::DeviceBuffer::write(std::span<const std::byte> src, VkDev
   return *this;
 }
 
+void mr::DeviceBuffer::recreate(size_t byte_size, vk::BufferUsageFlags usage_flags) noexcept
+{
+  ASSERT(_state != nullptr);
+
+  auto [buffer, allocation] = create_buffer(*_state, usage_flags, vk::MemoryPropertyFlagBits::eDeviceLocal, byte_size);
+
+  _state->queue().waitIdle();
+  if (size_t copy_size = std::min(_size, byte_size); copy_size > 0) {
+    vk::BufferCopy buffer_copy {
+      .srcOffset = 0,
+      .dstOffset = 0,
+      .size = copy_size,
+    };
+    CommandUnit command_unit(*_state);
+    command_unit.begin();
+    command_unit->copyBuffer(_buffer, buffer, {buffer_copy});
+    command_unit.end();
+
+    vk::SubmitInfo submit_info = command_unit.submit_info();
+
+    auto fence = _state->device().createFenceUnique({}).value;
+    _state->queue().submit(submit_info, fence.get());
+    _state->device().waitForFences({fence.get()}, VK_TRUE, UINT64_MAX);
+  }
+
+  vmaDestroyBuffer(_state->allocator(), _buffer, _allocation);
+
+  _size = byte_size;
+  _buffer = buffer;
+  _allocation = allocation;
+}
+
 // ----------------------------------------------------------------------------
 // Uniform buffer
 // ----------------------------------------------------------------------------
@@ -216,10 +267,82 @@ mr::UniformBuffer::UniformBuffer(const VulkanState &state, size_t size)
 // Storage buffer
 // ----------------------------------------------------------------------------
 
+// Transfer source is required to move buffer to another allocation on defragmentation
+static constexpr vk::BufferUsageFlags relocatable_usage_flags =
+  vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+
+mr::StorageBuffer::StorageBuffer(const VulkanState &state, size_t byte_size,
+                                 vk::BufferUsageFlags usage_flags,
+                                 vk::MemoryPropertyFlags memory_properties)
+  : DeviceBuffer(state, byte_size, usage_flags | relocatable_usage_flags, memory_properties)
+  , _usage_flags(usage_flags | relocatable_usage_flags)
+{
+  register_relocatable(*_state, _allocation);
+}
+
 mr::StorageBuffer::StorageBuffer(const VulkanState &state, size_t byte_size)
-  : DeviceBuffer(state, byte_size,
-                 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst)
+  : StorageBuffer(state, byte_size, vk::BufferUsageFlagBits::eStorageBuffer)
+{
+}
+
+mr::StorageBuffer::StorageBuffer(StorageBuffer &&other) noexcept
+  : DeviceBuffer(std::move(other))
+{
+  std::swap(_usage_flags, other._usage_flags);
+  if (_state != nullptr) {
+    register_relocatable(*_state, _allocation);
+  }
+}
+
+mr::StorageBuffer & mr::StorageBuffer::operator=(StorageBuffer &&other) noexcept
+{
+  DeviceBuffer::operator=(std::move(other));
+  std::swap(_usage_flags, other._usage_flags);
+  if (_state != nullptr) {
+    register_relocatable(*_state, _allocation);
+  }
+  if (other._state != nullptr) {
+    other.register_relocatable(*other._state, other._allocation);
+  }
+  return *this;
+}
+
+void mr::StorageBuffer::resize(size_t byte_size) noexcept
 {
+  if (byte_size == _size) {
+    return;
+  }
+  recreate(byte_size, _usage_flags);
+  register_relocatable(*_state, _allocation);
+}
+
+void mr::StorageBuffer::begin_relocation(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) noexcept
+{
+  ASSERT(not _relocated_buffer, "Buffer is already relocating");
+
+  vk::BufferCreateInfo buffer_create_info {
+    .size = _size,
+    .usage = get_buffer_usage(*_state, _usage_flags),
+    .sharingMode = vk::SharingMode::eExclusive,
+  };
+  _relocated_buffer = _state->device().createBuffer(buffer_create_info).value;
+  vmaBindBufferMemory(_state->allocator(), dst_allocation, _relocated_buffer);
+
+  vk::BufferCopy buffer_copy {
+    .srcOffset = 0,
+    .dstOffset = 0,
+    .size = _size,
+  };
+  command_buffer.copyBuffer(_buffer, _relocated_buffer, {buffer_copy});
+}
+
+void mr::StorageBuffer::end_relocation() noexcept
+{
+  ASSERT(_relocated_buffer, "Buffer relocation was not started");
+
+  // Memory is owned by allocation, which now points to new place
+  _state->device().destroyBuffer(_buffer);
+  _buffer = std::exchange(_relocated_buffer, vk::Buffer {});
 }
 
 // ----------------------------------------------------------------------------
@@ -256,29 +379,7 @@ void mr::VectorBuffer::resize(VkDeviceSize new_size) noexcept
 
 void mr::VectorBuffer::recreate_buffer(VkDeviceSize new_size) noexcept
 {
-  auto &&[buffer, allocation] = create_buffer(*_state, _usage_flags | vk::BufferUsageFlagBits::eTransferSrc, {}, new_size);
-  vk::BufferCopy buffer_copy {
-    .srcOffset = 0,
-    .dstOffset = 0,
-    .size = _size,
-  };
-  // TODO(dk6): pass RenderContext to buffer and get from it
-  CommandUnit command_unit(*_state);
-  command_unit.begin();
-  command_unit->copyBuffer(_buffer, buffer, {buffer_copy});
-  command_unit.end();
-
-  vk::SubmitInfo submit_info  = command_unit.submit_info();
-
-  auto fence = _state->device().createFenceUnique({}).value;
-  _state->queue().submit(submit_info, fence.get());
-  _state->device().waitForFences({fence.get()}, VK_TRUE, UINT64_MAX);
-
-  vmaDestroyBuffer(_state->allocator(), _buffer, _allocation);
-
-  _size = new_size;
-  _buffer = std::move(buffer);
-  _allocation = std::move(allocation);
+  recreate(new_size, _usage_flags | vk::BufferUsageFlagBits::eTransferSrc);
 }
 
 // ----------------------------------------------------------------------------
@@ -457,6 +558,7 @@ VkDeviceSize mr::HeapBuffer::allocate(VkDeviceSize size) noexcept
   auto alloc = _heap.allocate(size);
   if (alloc.resized) {
     _buffer.resize(_heap.size());
+    _version++;
   }
   return alloc.offset;
 }
@@ -7,6 +7,7 @@
 #include <vk_mem_alloc.h>
 
 #include "vulkan_state.hpp"
+#include "resources/defragmenter/relocatable.hpp"
 #include <vulkan/vulkan_core.h>
 
 namespace mr {
@@ -102,6 +103,9 @@ inline namespace graphics {
     // This method just map device memory and collect it to span
     std::span<const std::byte> read() noexcept;
 
+    // Memory stays mapped until buffer destruction, so it can be written directly
+    std::span<std::byte> mapped_data() noexcept;
+
     HostBuffer &write(std::span<const std::byte> src);
 
     // This method copy to CPU memory and unmap device memory
@@ -136,6 +140,11 @@ inline namespace graphics {
 
     template <typename T, size_t Extent>
     DeviceBuffer & write(std::span<T, Extent> src, VkDeviceSize offset = 0) { return write(std::as_bytes(src), offset); }
+
+  protected:
+    // Replace buffer by new one of 'byte_size' bytes, common part of contents is copied by GPU.
+    // Waits for queue, so old buffer isn't used by submitted work when it is destroyed
+    void recreate(size_t byte_size, vk::BufferUsageFlags usage_flags) noexcept;
   };
 
   class ConditionalBuffer : public DeviceBuffer {
@@ -144,12 +153,19 @@ inline namespace graphics {
     ConditionalBuffer(ConditionalBuffer &&) noexcept = default;
     ConditionalBuffer & operator=(ConditionalBuffer &&) noexcept = default;
 
-    ConditionalBuffer(const VulkanState &state, size_t byte_size)
-      : DeviceBuffer(state, byte_size,
-                     vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer |
-                       vk::BufferUsageFlagBits::eConditionalRenderingEXT)
+    ConditionalBuffer(const VulkanState &state, size_t byte_size,
+                      vk::BufferUsageFlags usage_flags = vk::BufferUsageFlags(0))
+      : DeviceBuffer(state, byte_size, usage_flags | conditional_usage_flags)
     {
     }
+
+    // Contents are kept
+    void resize(size_t byte_size) noexcept { recreate(byte_size, conditional_usage_flags); }
+
+  private:
+    static inline constexpr vk::BufferUsageFlags conditional_usage_flags =
+      vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst |
+      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eConditionalRenderingEXT;
   };
 
   class UniformBuffer : public HostBuffer {
@@ -165,12 +181,23 @@ inline namespace graphics {
     }
   };
 
-  class StorageBuffer : public DeviceBuffer {
+  class StorageBuffer : public DeviceBuffer, public Relocatable {
+  private:
+    vk::BufferUsageFlags _usage_flags {};
+    // Buffer bound to new allocation while defragmentation moves it
+    vk::Buffer _relocated_buffer {};
+
   public:
-    using DeviceBuffer::DeviceBuffer;
+    StorageBuffer() = default;
 
+    StorageBuffer(const VulkanState &state, size_t byte_size,
+                  vk::BufferUsageFlags usage_flags,
+                  vk::MemoryPropertyFlags memory_properties = vk::MemoryPropertyFlags(0));
     StorageBuffer(const VulkanState &state, size_t byte_size);
 
+    StorageBuffer(StorageBuffer &&other) noexcept;
+    StorageBuffer & operator=(StorageBuffer &&other) noexcept;
+
     template <typename T, size_t Extent>
     StorageBuffer(const VulkanState &state, std::span<T, Extent> src)
         : StorageBuffer(state, src.size() * sizeof(T))
@@ -178,6 +205,13 @@ inline namespace graphics {
       assert(src.data());
       write(src);
     }
+
+    // Contents are kept. Buffer handle changes, so its bindless descriptor must be updated
+    void resize(size_t byte_size) noexcept;
+
+    void begin_relocation(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) noexcept override;
+    void end_relocation() noexcept override;
+    std::optional<Shader::Resource> bindless_resource() const noexcept override { return Shader::Resource(this); }
   };
 
   class VertexBuffer : public DeviceBuffer {
@@ -360,6 +394,7 @@ inline namespace graphics {
   private:
     VectorBuffer _buffer;
     DeviceHeapAllocator _heap;
+    uint64_t _version = 0; // incremented each time buffer is recreated by growth
 
   public:
     HeapBuffer() = default;
@@ -389,6 +424,7 @@ inline namespace graphics {
 
     VkDeviceSize byte_size() const noexcept { return _buffer.byte_size(); }
     vk::Buffer buffer() const noexcept { return _buffer.buffer(); }
+    uint64_t version() const noexcept { return _version; }
   };
 
   class VertexHeapBuffer : public HeapBuffer {
@@ -0,0 +1,115 @@
+#ifndef __MR_DELTA_UPLOAD_HPP_
+#define __MR_DELTA_UPLOAD_HPP_
+
+#include "pch.hpp"
+
+#include "resources/buffer/buffer.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Upload of changed elements of device array by copies recorded into frame command buffer.
+  // Changed elements are packed to host staging buffer of the frame, there are two of them,
+  // so CPU fills one while copies of previous frame still read another one.
+  // Copies are followed by barrier, so shaders of the frame never read partially written array
+  template <typename T>
+  class DeltaUpload {
+  public:
+    static inline constexpr uint32_t frames_number = 2;
+    static inline constexpr size_t min_staging_capacity = 1024; // in elements
+
+    struct Stats {
+      uint32_t elements_number = 0; // staged for next frame
+      uint32_t regions_number = 0;
+      size_t byte_size = 0;
+    };
+
+  private:
+    const VulkanState *_state = nullptr;
+    std::array<std::unique_ptr<HostBuffer>, frames_number> _staging;
+    std::array<size_t, frames_number> _capacities {};
+    std::vector<vk::BufferCopy> _regions;
+    uint32_t _frame = 0;
+
+    Stats _stats;
+
+  public:
+    DeltaUpload() = default;
+
+    DeltaUpload(const VulkanState &state) noexcept : _state(&state) {}
+
+    DeltaUpload(DeltaUpload &&) noexcept = default;
+    DeltaUpload & operator=(DeltaUpload &&) noexcept = default;
+
+    // Packs elements of 'data' which indices are in sorted 'indices', runs of adjacent ones are one region.
+    // Elements staged since last 'record' are replaced
+    void stage(std::span<const T> data, std::span<const uint32_t> indices) noexcept
+    {
+      ASSERT(_state != nullptr);
+
+      _regions.clear();
+      _stats = {};
+      if (indices.empty()) {
+        return;
+      }
+
+      // Staging buffer of this frame was read by copies of the frame before previous one, which is finished
+      if (_capacities[_frame] < indices.size()) {
+        _capacities[_frame] = std::max(std::bit_ceil(indices.size()), min_staging_capacity);
+        _staging[_frame] = std::make_unique<HostBuffer>(*_state, _capacities[_frame] * sizeof(T),
+                                                        vk::BufferUsageFlagBits::eTransferSrc);
+      }
+
+      auto *staging = reinterpret_cast<T *>(_staging[_frame]->mapped_data().data());
+      size_t staged = 0;
+      for (size_t i = 0; i < indices.size();) {
+        size_t run = 1;
+        while (i + run < indices.size() && indices[i + run] == indices[i] + run) {
+          run++;
+        }
+        ASSERT(indices[i] + run <= data.size());
+        _regions.emplace_back(vk::BufferCopy {
+          .srcOffset = staged * sizeof(T),
+          .dstOffset = indices[i] * sizeof(T),
+          .size = run * sizeof(T),
+        });
+        std::memcpy(staging + staged, data.data() + indices[i], run * sizeof(T));
+        staged += run;
+        i += run;
+      }
+
+      _stats.elements_number = static_cast<uint32_t>(staged);
+      _stats.regions_number = static_cast<uint32_t>(_regions.size());
+      _stats.byte_size = staged * sizeof(T);
+    }
+
+    // Staged elements are dropped, e.g. when whole array is written
+    void discard() noexcept { _regions.clear(); }
+
+    // Records copies of staged elements to 'buffer' and barrier before their reading by shaders,
+    // returns false if nothing is staged
+    bool record(vk::CommandBuffer command_buffer, vk::Buffer buffer, vk::PipelineStageFlags dst_stages) noexcept
+    {
+      if (_regions.empty()) {
+        return false;
+      }
+
+      command_buffer.copyBuffer(_staging[_frame]->buffer(), buffer,
+        vk::ArrayProxy<const vk::BufferCopy>(static_cast<uint32_t>(_regions.size()), _regions.data()));
+
+      vk::MemoryBarrier barrier {
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+      };
+      command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, dst_stages, {}, barrier, {}, {});
+
+      _regions.clear();
+      _frame = (_frame + 1) % frames_number;
+      return true;
+    }
+
+    const Stats & stats() const noexcept { return _stats; }
+  };
+}
+} // namespace mr
+
+#endif // __MR_DELTA_UPLOAD_HPP_
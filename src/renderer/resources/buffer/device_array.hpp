@@ -0,0 +1,130 @@
+#ifndef __MR_DEVICE_ARRAY_HPP_
+#define __MR_DEVICE_ARRAY_HPP_
+
+#include "pch.hpp"
+
+#include "resources/buffer/buffer.hpp"
+#include "resources/descriptor/descriptor.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Device buffer of elements which capacity follows their number.
+  // Capacity is doubled when it is not enough and halved when less than quarter of it is used,
+  // so memory tracks size in both directions without reallocations on each change. Contents are kept by GPU copy.
+  // Buffer is registered in bindless set once, on resize its descriptor is rewritten with the same id,
+  // so ids stored in other buffers stay valid. Descriptor is written on next bindless set flush
+  template <typename T, typename BufferT = StorageBuffer>
+  class DeviceArray {
+  public:
+    static inline constexpr size_t default_min_capacity = 64;
+
+  private:
+    // Address of buffer is key of its bindless registration, so it is kept when array is moved
+    std::unique_ptr<BufferT> _buffer;
+    BindlessDescriptorSet *_bindless_set = nullptr;
+    uint32_t _id = -1;
+    size_t _size = 0;
+    size_t _min_capacity = default_min_capacity;
+    size_t _reserved = 0; // capacity isn't decreased below it
+
+  public:
+    DeviceArray() = default;
+
+    // Buffer is registered in 'bindless_set' if it is not nullptr
+    DeviceArray(const VulkanState &state, BindlessDescriptorSet *bindless_set,
+                vk::BufferUsageFlags usage_flags = vk::BufferUsageFlagBits::eStorageBuffer,
+                size_t min_capacity = default_min_capacity) noexcept
+      : _buffer(std::make_unique<BufferT>(state, min_capacity * sizeof(T), usage_flags))
+      , _bindless_set(bindless_set)
+      , _min_capacity(min_capacity)
+    {
+      ASSERT(min_capacity > 0);
+      if (_bindless_set != nullptr) {
+        _id = _bindless_set->register_resource(_buffer.get());
+      }
+    }
+
+    ~DeviceArray() noexcept
+    {
+      if (_buffer && _bindless_set != nullptr) {
+        _bindless_set->unregister_resource(_buffer.get());
+      }
+    }
+
+    DeviceArray(DeviceArray &&other) noexcept { *this = std::move(other); }
+    DeviceArray & operator=(DeviceArray &&other) noexcept
+    {
+      std::swap(_buffer, other._buffer);
+      std::swap(_bindless_set, other._bindless_set);
+      std::swap(_id, other._id);
+      std::swap(_size, other._size);
+      std::swap(_min_capacity, other._min_capacity);
+      std::swap(_reserved, other._reserved);
+      return *this;
+    }
+
+    // Returns true if buffer was recreated
+    bool resize(size_t size) noexcept
+    {
+      ASSERT(_buffer);
+      _size = size;
+
+      size_t min_capacity = std::max(_min_capacity, _reserved);
+      size_t new_capacity = capacity();
+      while (new_capacity < std::max(size, min_capacity)) {
+        new_capacity *= 2;
+      }
+      while (new_capacity / 2 >= min_capacity && size < new_capacity / 4) {
+        new_capacity /= 2;
+      }
+      if (new_capacity == capacity()) {
+        return false;
+      }
+
+      _buffer->resize(new_capacity * sizeof(T));
+      if (_bindless_set != nullptr) {
+        _bindless_set->update_resource(_buffer.get());
+      }
+      return true;
+    }
+
+    // Capacity is kept not less than 'capacity' regardless of size, e.g. for elements written by GPU
+    bool reserve(size_t capacity) noexcept
+    {
+      _reserved = capacity;
+      return resize(_size);
+    }
+
+    // Resizes array to data size and writes it
+    void assign(std::span<const T> data) noexcept
+    {
+      resize(data.size());
+      if (not data.empty()) {
+        _buffer->write(std::as_bytes(data));
+      }
+    }
+
+    void write(std::span<const T> data, size_t offset = 0) noexcept
+    {
+      ASSERT(offset + data.size() <= _size, "Write is out of array size", offset, data.size(), _size);
+      if (not data.empty()) {
+        _buffer->write(std::as_bytes(data), offset * sizeof(T));
+      }
+    }
+
+    size_t size() const noexcept { return _size; }
+    size_t capacity() const noexcept { return _buffer ? _buffer->byte_size() / sizeof(T) : 0; }
+    size_t byte_size() const noexcept { return _buffer ? _buffer->byte_size() : 0; }
+    uint32_t id() const noexcept { return _id; }
+
+    vk::Buffer buffer() const noexcept { return _buffer->buffer(); }
+    BufferT & device_buffer() noexcept { return *_buffer; }
+    const BufferT & device_buffer() const noexcept { return *_buffer; }
+  };
+
+  template <typename T>
+  using ConditionalArray = DeviceArray<T, ConditionalBuffer>;
+}
+} // namespace mr
+
+#endif // __MR_DEVICE_ARRAY_HPP_
@@ -0,0 +1,153 @@
+#include "resources/defragmenter/defragmenter.hpp"
+#include "resources/descriptor/descriptor.hpp"
+
+mr::Defragmenter::Defragmenter(const VulkanState &state, BindlessDescriptorSet &bindless_set) noexcept
+  : _state(&state)
+  , _bindless_set(&bindless_set)
+  , _command_unit(state)
+{
+}
+
+mr::Defragmenter & mr::Defragmenter::operator=(Defragmenter &&other) noexcept
+{
+  std::swap(_state, other._state);
+  std::swap(_bindless_set, other._bindless_set);
+  std::swap(_command_unit, other._command_unit);
+  std::swap(_context, other._context);
+  std::swap(_bytes_per_frame, other._bytes_per_frame);
+  std::swap(_frames_before_check, other._frames_before_check);
+  std::swap(_stats, other._stats);
+  return *this;
+}
+
+mr::Defragmenter::~Defragmenter() noexcept
+{
+  if (_context != nullptr) {
+    finish();
+  }
+}
+
+bool mr::Defragmenter::is_fragmented() const noexcept
+{
+  VmaBudget budgets[VK_MAX_MEMORY_HEAPS] {};
+  vmaGetHeapBudgets(_state->allocator(), budgets);
+
+  VkDeviceSize block_bytes = 0;
+  VkDeviceSize allocation_bytes = 0;
+  for (const auto &budget : budgets) {
+    block_bytes += budget.statistics.blockBytes;
+    allocation_bytes += budget.statistics.allocationBytes;
+  }
+
+  VkDeviceSize wasted_bytes = block_bytes - allocation_bytes;
+  return wasted_bytes >= min_wasted_bytes && wasted_bytes >= block_bytes * min_wasted_fraction;
+}
+
+void mr::Defragmenter::start() noexcept
+{
+  ASSERT(_state != nullptr);
+  if (_context != nullptr) {
+    return;
+  }
+
+  VmaDefragmentationInfo defragmentation_info {
+    .flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT,
+    .maxBytesPerPass = _bytes_per_frame,
+  };
+  auto result = vmaBeginDefragmentation(_state->allocator(), &defragmentation_info, &_context);
+  ASSERT(result == VK_SUCCESS, "Failed to begin defragmentation", result);
+  MR_DEBUG("VMA defragmentation started");
+}
+
+void mr::Defragmenter::finish() noexcept
+{
+  VmaDefragmentationStats stats {};
+  vmaEndDefragmentation(_state->allocator(), _context, &stats);
+  _context = nullptr;
+
+  _stats.moved_allocations += stats.allocationsMoved;
+  _stats.moved_bytes += stats.bytesMoved;
+  _stats.freed_bytes += stats.bytesFreed;
+  MR_DEBUG("VMA defragmentation finished: moved {} allocations ({} B), freed {} blocks ({} B)",
+    stats.allocationsMoved, stats.bytesMoved, stats.deviceMemoryBlocksFreed, stats.bytesFreed);
+}
+
+void mr::Defragmenter::step() noexcept
+{
+  ASSERT(_state != nullptr);
+
+  if (_context == nullptr) {
+    if (--_frames_before_check > 0) {
+      return;
+    }
+    _frames_before_check = check_period;
+    if (not is_fragmented()) {
+      return;
+    }
+    start();
+  }
+
+  VmaDefragmentationPassMoveInfo pass {};
+  auto result = vmaBeginDefragmentationPass(_state->allocator(), _context, &pass);
+  if (result == VK_SUCCESS) {
+    finish();
+    return;
+  }
+  ASSERT(result == VK_INCOMPLETE, "Failed to begin defragmentation pass", result);
+
+  _command_unit.begin();
+
+  // All previous GPU work is finished by caller, but its writes must be visible for copy
+  vk::MemoryBarrier before_copy_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eMemoryWrite,
+    .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+  };
+  _command_unit->pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+                                 {}, before_copy_barrier, {}, {});
+
+  std::vector<Relocatable *> relocated;
+  relocated.reserve(pass.moveCount);
+  for (uint32_t i = 0; i < pass.moveCount; i++) {
+    auto &move = pass.pMoves[i];
+
+    VmaAllocationInfo allocation_info;
+    vmaGetAllocationInfo(_state->allocator(), move.srcAllocation, &allocation_info);
+    auto *resource = static_cast<Relocatable *>(allocation_info.pUserData);
+    if (resource == nullptr) {
+      move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+      continue;
+    }
+
+    resource->begin_relocation(_command_unit.command_buffer(), move.dstTmpAllocation);
+    relocated.push_back(resource);
+  }
+
+  vk::MemoryBarrier after_copy_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+    .dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite,
+  };
+  _command_unit->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+                                 {}, after_copy_barrier, {}, {});
+  _command_unit.end();
+
+  if (not relocated.empty()) {
+    vk::SubmitInfo submit_info = _command_unit.submit_info();
+    auto fence = _state->device().createFenceUnique({}).value;
+    _state->queue().submit(submit_info, fence.get());
+    _state->device().waitForFences({fence.get()}, VK_TRUE, UINT64_MAX);
+  }
+
+  // Old handles must be destroyed before VMA frees their memory on pass ending
+  for (auto *resource : relocated) {
+    resource->end_relocation();
+    if (auto bindless_resource = resource->bindless_resource()) {
+      _bindless_set->update_resource(bindless_resource.value());
+    }
+  }
+
+  _stats.passes_number++;
+  result = vmaEndDefragmentationPass(_state->allocator(), _context, &pass);
+  if (result == VK_SUCCESS) {
+    finish();
+  }
+}
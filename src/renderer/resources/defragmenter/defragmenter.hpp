@@ -0,0 +1,75 @@
+#ifndef __MR_DEFRAGMENTER_HPP_
+#define __MR_DEFRAGMENTER_HPP_
+
+#include "pch.hpp"
+
+#include <vk_mem_alloc.h>
+
+#include "vulkan_state.hpp"
+#include "resources/command_unit/command_unit.hpp"
+#include "resources/defragmenter/relocatable.hpp"
+
+namespace mr {
+inline namespace graphics {
+  class BindlessDescriptorSet;
+
+  // Incremental defragmentation of VMA device memory.
+  // Each frame moves not more than 'bytes_per_frame' bytes of Relocatable resources
+  // (TextureImage, StorageBuffer), other allocations stay in place.
+  // Memory blocks which become empty are released by VMA.
+  class Defragmenter {
+  public:
+    static inline constexpr VkDeviceSize default_bytes_per_frame = 16 * 1024 * 1024;
+    // Defragmentation starts only if unused memory inside allocated blocks exceeds both thresholds
+    static inline constexpr VkDeviceSize min_wasted_bytes = 64 * 1024 * 1024;
+    static inline constexpr float min_wasted_fraction = 0.25f;
+    // Fragmentation check isn't free, so it is done once per this number of frames
+    static inline constexpr uint32_t check_period = 120;
+
+    struct Stats {
+      uint64_t passes_number = 0;
+      uint64_t moved_allocations = 0;
+      uint64_t moved_bytes = 0;
+      uint64_t freed_bytes = 0;
+    };
+
+  private:
+    const VulkanState *_state = nullptr;
+    BindlessDescriptorSet *_bindless_set = nullptr;
+    CommandUnit _command_unit;
+
+    VmaDefragmentationContext _context = nullptr;
+    VkDeviceSize _bytes_per_frame = default_bytes_per_frame;
+    uint32_t _frames_before_check = check_period;
+
+    Stats _stats;
+
+  public:
+    Defragmenter() = default;
+    Defragmenter(const VulkanState &state, BindlessDescriptorSet &bindless_set) noexcept;
+
+    Defragmenter(Defragmenter &&other) noexcept { *this = std::move(other); }
+    Defragmenter & operator=(Defragmenter &&other) noexcept;
+
+    ~Defragmenter() noexcept;
+
+    // Must be called when GPU doesn't use resources, e.g. right after frame fence waiting
+    void step() noexcept;
+
+    // Start defragmentation regardless of fragmentation level
+    void start() noexcept;
+    bool running() const noexcept { return _context != nullptr; }
+
+    void bytes_per_frame(VkDeviceSize bytes) noexcept { _bytes_per_frame = bytes; }
+    VkDeviceSize bytes_per_frame() const noexcept { return _bytes_per_frame; }
+
+    const Stats & stats() const noexcept { return _stats; }
+
+  private:
+    bool is_fragmented() const noexcept;
+    void finish() noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_DEFRAGMENTER_HPP_
@@ -0,0 +1,40 @@
+#ifndef __MR_RELOCATABLE_HPP_
+#define __MR_RELOCATABLE_HPP_
+
+#include "pch.hpp"
+
+#include <vk_mem_alloc.h>
+
+#include "vulkan_state.hpp"
+#include "resources/shaders/shader.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Interface of resource which memory can be moved by Defragmenter.
+  // Pointer to it is stored in user data of resource's VMA allocation, allocations
+  // without user data are never moved.
+  class Relocatable {
+  public:
+    virtual ~Relocatable() = default;
+
+    // Create new handle bound to dst_allocation and record copy of resource contents to it
+    virtual void begin_relocation(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) noexcept = 0;
+    // Copy is finished and memory is moved: destroy old handle and use new one
+    virtual void end_relocation() noexcept = 0;
+
+    // Resource which descriptors must be rewritten after relocation
+    virtual std::optional<Shader::Resource> bindless_resource() const noexcept = 0;
+
+  protected:
+    // Must be called after each change of allocation owner (creation, move)
+    void register_relocatable(const VulkanState &state, VmaAllocation allocation) noexcept
+    {
+      if (allocation != nullptr) {
+        vmaSetAllocationUserData(state.allocator(), allocation, this);
+      }
+    }
+  };
+}
+} // namespace mr
+
+#endif // __MR_RELOCATABLE_HPP_
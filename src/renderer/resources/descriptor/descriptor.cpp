@@ -69,6 +69,9 @@ mr::DescriptorSetLayout::DescriptorSetLayout(const VulkanState &state,
 
   // Create descriptor set layout
   vk::DescriptorSetLayoutCreateInfo set_layout_create_info {
+    .flags = state.descriptor_buffer_supported()
+      ? vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT
+      : vk::DescriptorSetLayoutCreateFlags {},
     .bindingCount = static_cast<uint32_t>(set_bindings.size()),
     .pBindings = set_bindings.data(),
   };
@@ -83,18 +86,151 @@ mr::DescriptorSetLayout::DescriptorSetLayout(const VulkanState &state,
 // Bindless descriptor set layout functions
 // ============================================================================
 
+static constexpr std::array bindless_types {
+  vk::DescriptorType::eCombinedImageSampler,
+  vk::DescriptorType::eUniformBuffer,
+  vk::DescriptorType::eStorageBuffer,
+};
+
+// Capacity allowed by descriptor limits which apply to bindless layout of backend
+static uint32_t get_device_bindless_capacity(vk::PhysicalDevice phys_device,
+                                             vk::DescriptorType type,
+                                             mr::BindlessBackend backend) noexcept
+{
+  auto properties = phys_device.getProperties2<
+    vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+
+  // All bindless bindings share per stage and per pool limits
+  using enum vk::DescriptorType;
+  uint32_t capacity = 0;
+  if (backend == mr::BindlessBackend::DescriptorPool) {
+    // Layout is created with update after bind pool flag
+    const auto &limits = properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+    capacity = std::min(limits.maxPerStageUpdateAfterBindResources,
+                        limits.maxUpdateAfterBindDescriptorsInAllPools) / static_cast<uint32_t>(bindless_types.size());
+    switch (type) {
+      case eCombinedImageSampler:
+        capacity = std::min({capacity,
+          limits.maxDescriptorSetUpdateAfterBindSampledImages,
+          limits.maxDescriptorSetUpdateAfterBindSamplers,
+          limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+          limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+        break;
+      case eUniformBuffer:
+        capacity = std::min({capacity,
+          limits.maxDescriptorSetUpdateAfterBindUniformBuffers,
+          limits.maxPerStageDescriptorUpdateAfterBindUniformBuffers});
+        break;
+      case eStorageBuffer:
+        capacity = std::min({capacity,
+          limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+          limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+        break;
+      default:
+        ASSERT(false, "Unsupported in bindless set descriptor type", type);
+        return 0;
+    }
+  } else {
+    // Layout of descriptor buffer has no update after bind flag, so ordinary limits apply
+    const auto &limits = properties.get<vk::PhysicalDeviceProperties2>().properties.limits;
+    capacity = limits.maxPerStageResources / static_cast<uint32_t>(bindless_types.size());
+    switch (type) {
+      case eCombinedImageSampler:
+        capacity = std::min({capacity,
+          limits.maxDescriptorSetSampledImages,
+          limits.maxDescriptorSetSamplers,
+          limits.maxPerStageDescriptorSampledImages,
+          limits.maxPerStageDescriptorSamplers});
+        break;
+      case eUniformBuffer:
+        capacity = std::min({capacity,
+          limits.maxDescriptorSetUniformBuffers,
+          limits.maxPerStageDescriptorUniformBuffers});
+        break;
+      case eStorageBuffer:
+        capacity = std::min({capacity,
+          limits.maxDescriptorSetStorageBuffers,
+          limits.maxPerStageDescriptorStorageBuffers});
+        break;
+      default:
+        ASSERT(false, "Unsupported in bindless set descriptor type", type);
+        return 0;
+    }
+  }
+  return std::min(capacity, mr::resource_max_number_per_binding);
+}
+
+static uint32_t get_bindless_descriptor_capacity(
+  vk::PhysicalDevice phys_device,
+  const vk::PhysicalDeviceDescriptorBufferPropertiesEXT &descriptor_buffer_properties,
+  vk::DescriptorType type,
+  mr::BindlessBackend backend) noexcept
+{
+  uint32_t capacity = get_device_bindless_capacity(phys_device, type, backend);
+  if (backend == mr::BindlessBackend::DescriptorPool) {
+    return capacity;
+  }
+
+  // Whole descriptor buffer must be addressable by device, so all bindings are shrunk proportionally to fit it.
+  // Each binding may be padded up to offset alignment
+  using mr::DescriptorBuffer;
+  VkDeviceSize alignment = descriptor_buffer_properties.descriptorBufferOffsetAlignment;
+  VkDeviceSize reserved_byte_size = DescriptorBuffer::default_sets_byte_size + bindless_types.size() * alignment;
+  VkDeviceSize max_byte_size = DescriptorBuffer::max_byte_size(descriptor_buffer_properties);
+  if (reserved_byte_size >= max_byte_size) {
+    return 0;
+  }
+
+  VkDeviceSize bindless_byte_size = 0;
+  for (auto bindless_type : bindless_types) {
+    bindless_byte_size += get_device_bindless_capacity(phys_device, bindless_type, backend) *
+                          DescriptorBuffer::descriptor_size(descriptor_buffer_properties, bindless_type);
+  }
+  if (reserved_byte_size + bindless_byte_size > max_byte_size) {
+    capacity = static_cast<uint32_t>(capacity * (max_byte_size - reserved_byte_size) / bindless_byte_size);
+  }
+  return capacity;
+}
+
+uint32_t mr::get_bindless_descriptor_capacity(const VulkanState &state,
+                                              vk::DescriptorType type,
+                                              BindlessBackend backend) noexcept
+{
+  return ::get_bindless_descriptor_capacity(state.phys_device(), state.descriptor_buffer_properties(), type, backend);
+}
+
+bool mr::is_descriptor_buffer_sufficient(vk::PhysicalDevice phys_device) noexcept
+{
+  auto properties = phys_device.getProperties2<
+    vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+  const auto &descriptor_buffer_properties = properties.get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+  return std::ranges::all_of(bindless_types, [&](vk::DescriptorType type) {
+    return ::get_bindless_descriptor_capacity(phys_device, descriptor_buffer_properties, type,
+                                              BindlessBackend::DescriptorBuffer) >= resource_min_number_per_binding;
+  });
+}
 
 mr::BindlessDescriptorSetLayout::BindlessDescriptorSetLayout(const VulkanState &state,
                                                              const vk::ShaderStageFlags stage,
                                                              std::span<const BindingDescription> bindings) noexcept
 {
   InplaceVector<vk::DescriptorSetLayoutBinding, desciptor_set_max_bindings> set_bindings;
-  fill_binding(set_bindings, stage, bindings, resource_max_number_per_binding);
+  fill_binding(set_bindings, stage, bindings);
+  for (auto &set_binding : set_bindings) {
+    set_binding.descriptorCount =
+      get_bindless_descriptor_capacity(state, set_binding.descriptorType, get_bindless_backend(state));
+    _capacities[set_binding.binding] = set_binding.descriptorCount;
+  }
+
+  // Descriptor buffer can be written at any time, update after bind is only for pools
+  bool descriptor_buffer = state.descriptor_buffer_supported();
 
   InplaceVector<vk::DescriptorBindingFlags, desciptor_set_max_bindings> binding_flags;
   binding_flags.resize(bindings.size());
   std::fill(binding_flags.begin(), binding_flags.end(),
-    vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind);
+    descriptor_buffer
+      ? vk::DescriptorBindingFlagBits::ePartiallyBound
+      : vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind);
   vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info {
     .bindingCount = static_cast<uint32_t>(binding_flags.size()),
     .pBindingFlags = binding_flags.data(),
@@ -103,7 +239,9 @@ mr::BindlessDescriptorSetLayout::BindlessDescriptorSetLayout(const VulkanState &
   // Create descriptor set layout
   vk::DescriptorSetLayoutCreateInfo set_layout_create_info {
     .pNext = &binding_flags_create_info,
-    .flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+    .flags = descriptor_buffer
+      ? vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT
+      : vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
     .bindingCount = static_cast<uint32_t>(set_bindings.size()),
     .pBindings = set_bindings.data(),
   };
@@ -185,6 +323,15 @@ void mr::DescriptorSet::update(
     used_bindings[attachment_view.binding] = true;
   }
 
+  if (_buffer != nullptr) {
+    auto layout = _set_layout->layout();
+    for (const auto &[attach, write_info] : std::views::zip(attachments, write_infos)) {
+      _buffer->write(_buffer_offset + _buffer->binding_offset(layout, attach.binding),
+                     get_descriptor_type(attach), write_info);
+    }
+    return;
+  }
+
   static constexpr size_t max_descriptor_writes = 64;
   ASSERT(attachments.size() < max_descriptor_writes);
   InplaceVector<vk::WriteDescriptorSet, max_descriptor_writes> descriptor_writes;
@@ -204,6 +351,18 @@ void mr::DescriptorSet::update(
   state.device().updateDescriptorSets(descriptor_writes, {});
 }
 
+void mr::DescriptorSet::bind(vk::CommandBuffer command_buffer,
+                             vk::PipelineLayout pipeline_layout,
+                             uint32_t set_number,
+                             vk::PipelineBindPoint bind_point) const noexcept
+{
+  if (_buffer != nullptr) {
+    _buffer->bind_set(command_buffer, bind_point, pipeline_layout, set_number, _buffer_offset);
+  } else {
+    command_buffer.bindDescriptorSets(bind_point, pipeline_layout, set_number, {_set}, {});
+  }
+}
+
 // ============================================================================
 // Descriptor allocator functions
 // ============================================================================
@@ -211,6 +370,30 @@ void mr::DescriptorSet::update(
 mr::DescriptorAllocator::DescriptorAllocator(const VulkanState &state)
   : _state(&state)
 {
+  // Binding can't be grown above device limits, so scenes which need more descriptors would fail on registration
+  BindlessBackend backend = get_bindless_backend(state);
+  for (auto type : bindless_types) {
+    if (uint32_t capacity = get_bindless_descriptor_capacity(state, type, backend);
+        capacity < resource_min_number_per_binding) {
+      MR_FATAL("Device allows only {} bindless descriptors of type {}, at least {} are required",
+        capacity, vk::to_string(type), resource_min_number_per_binding);
+      std::exit(1);
+    }
+  }
+
+  if (backend == BindlessBackend::DescriptorBuffer) {
+    // Bindless set takes the most of buffer, its capacity is fixed for VulkanState lifetime
+    VkDeviceSize alignment = state.descriptor_buffer_properties().descriptorBufferOffsetAlignment;
+    VkDeviceSize byte_size = DescriptorBuffer::default_sets_byte_size;
+    for (auto type : bindless_types) {
+      VkDeviceSize binding_size =
+        get_bindless_descriptor_capacity(state, type, backend) * DescriptorBuffer::descriptor_size(state, type);
+      byte_size += (binding_size + alignment - 1) / alignment * alignment;
+    }
+    _descriptor_buffer = std::make_unique<DescriptorBuffer>(state, byte_size);
+    return;
+  }
+
   static constexpr std::array default_sizes {
     vk::DescriptorPoolSize {vk::DescriptorType::eUniformBuffer, 10},
     vk::DescriptorPoolSize {vk::DescriptorType::eStorageBuffer, 10},
@@ -225,12 +408,15 @@ mr::DescriptorAllocator::DescriptorAllocator(const VulkanState &state)
     _pools.emplace_back(std::move(pool.value()));
   }
 
-  static constexpr std::array bindless_default_sizes {
-    vk::DescriptorPoolSize {vk::DescriptorType::eUniformBuffer,        resource_max_number_per_binding},
-    vk::DescriptorPoolSize {vk::DescriptorType::eStorageBuffer,        resource_max_number_per_binding},
-    vk::DescriptorPoolSize {vk::DescriptorType::eCombinedImageSampler, resource_max_number_per_binding},
+  std::array bindless_sizes {
+    vk::DescriptorPoolSize {vk::DescriptorType::eUniformBuffer, 0},
+    vk::DescriptorPoolSize {vk::DescriptorType::eStorageBuffer, 0},
+    vk::DescriptorPoolSize {vk::DescriptorType::eCombinedImageSampler, 0},
   };
-  auto bindless_pool = allocate_pool(bindless_default_sizes, true);
+  for (auto &size : bindless_sizes) {
+    size.descriptorCount = get_bindless_descriptor_capacity(state, size.type, backend);
+  }
+  auto bindless_pool = allocate_pool(bindless_sizes, true);
   ASSERT(bindless_pool.has_value(), "Error in allocating descriptor pool");
   _bindless_pool = std::move(bindless_pool.value());
 }
@@ -276,6 +462,17 @@ std::optional<mr::SmallVector<mr::DescriptorSet>> mr::DescriptorAllocator::alloc
   SmallVector<DescriptorSet> sets;
   sets.reserve(set_layouts.size());
 
+  if (_descriptor_buffer) {
+    for (const auto &layout : set_layouts) {
+      auto offset = _descriptor_buffer->allocate(layout->layout());
+      if (not offset.has_value()) [[unlikely]] {
+        return std::nullopt;
+      }
+      sets.emplace_back(*_descriptor_buffer, offset.value(), layout);
+    }
+    return std::move(sets);
+  }
+
   for (const auto &layout : set_layouts) {
     layouts.emplace_back(layout->layout());
     sets.emplace_back(vk::DescriptorSet(), layout);
@@ -304,6 +501,12 @@ std::optional<mr::BindlessDescriptorSet> mr::DescriptorAllocator::allocate_bindl
   BindlessDescriptorSetLayoutHandle set_layout) const noexcept
 {
   auto vk_set_layout = set_layout->layout();
+  if (_descriptor_buffer) {
+    auto offset = _descriptor_buffer->allocate(vk_set_layout);
+    ASSERT(offset.has_value(), "Descriptor buffer is too small for bindless set");
+    return BindlessDescriptorSet(*_state, *_descriptor_buffer, offset.value(), set_layout);
+  }
+
   vk::DescriptorSetAllocateInfo allocate_info {
     .descriptorPool = _bindless_pool.get(),
     .descriptorSetCount = 1,
@@ -330,6 +533,25 @@ mr::BindlessDescriptorSet::BindlessDescriptorSet(const VulkanState &state,
                                                  vk::UniqueDescriptorSet set,
                                                  BindlessDescriptorSetLayoutHandle layout) noexcept
   : _state(&state), _set(std::move(set)), _set_layout(std::move(layout))
+{
+  init_resource_pools();
+}
+
+mr::BindlessDescriptorSet::BindlessDescriptorSet(const VulkanState &state,
+                                                 DescriptorBuffer &buffer,
+                                                 VkDeviceSize offset,
+                                                 BindlessDescriptorSetLayoutHandle layout) noexcept
+  : _set_layout(std::move(layout)), _state(&state), _buffer(&buffer), _buffer_offset(offset)
+{
+  for (auto [binding, type] : std::views::enumerate(_set_layout->bindings())) {
+    if (type.has_value()) {
+      _binding_offsets[binding] = _buffer->binding_offset(_set_layout->layout(), binding);
+    }
+  }
+  init_resource_pools();
+}
+
+void mr::BindlessDescriptorSet::init_resource_pools() noexcept
 {
   struct StatInfo {
     uint32_t count = 0;
@@ -350,6 +572,11 @@ mr::BindlessDescriptorSet::BindlessDescriptorSet(const VulkanState &state,
   }
 
   _resource_pools.resize(desciptor_set_max_bindings);
+  for (auto [binding, type] : std::views::enumerate(_set_layout->bindings())) {
+    if (type.has_value()) {
+      _resource_pools[binding] = ResourcePoolData(_set_layout->capacity(binding));
+    }
+  }
 }
 
 mr::graphics::Shader::ResourceView
@@ -376,22 +603,12 @@ uint32_t mr::BindlessDescriptorSet::register_resource(const Shader::ResourceView
     "Type of binding {} differ type of this binding in SetLayout create info",
     resource_view.binding);
 
-  ResourceInfo res_info;
-  vk::WriteDescriptorSet write_info;
-  uint32_t id = fill_resource(resource_view, res_info, write_info);
-  // Maybe accumulating write_infos and calling updateDescriptorSets once per frame would probably be better
-  _state->device().updateDescriptorSets(std::span {&write_info, 1}, {});
-  return id;
+  return fill_resource(resource_view);
 }
 
 uint32_t mr::BindlessDescriptorSet::register_resource(const Shader::Resource &resource) noexcept
 {
-  ResourceInfo res_info;
-  vk::WriteDescriptorSet write_info;
-  uint32_t id = fill_resource(try_convert_view_to_resource(resource), res_info, write_info);
-  // Maybe accumulating write_infos and calling updateDescriptorSets once per frame would probably be better
-  _state->device().updateDescriptorSets(std::span {&write_info, 1}, {});
-  return id;
+  return fill_resource(try_convert_view_to_resource(resource));
 }
 
 mr::InplaceVector<uint32_t, mr::desciptor_set_max_bindings>
@@ -399,13 +616,10 @@ mr::BindlessDescriptorSet::register_resources(std::span<const Shader::Resource>
 {
   ASSERT(resources.size() <= desciptor_set_max_bindings,
     "Max binding value is desciptor_set_max_bindings and all bindings must be unique");
-  InplaceVector<ResourceInfo, desciptor_set_max_bindings> res_infos(resources.size());
-  InplaceVector<vk::WriteDescriptorSet, desciptor_set_max_bindings> write_infos(resources.size());
   InplaceVector<uint32_t, mr::desciptor_set_max_bindings> ids;
-  for (auto &&[resource, res_info, write_info] : std::views::zip(resources, res_infos, write_infos)) {
-    ids.push_back(fill_resource(try_convert_view_to_resource(resource), res_info, write_info));
+  for (const auto &resource : resources) {
+    ids.push_back(fill_resource(try_convert_view_to_resource(resource)));
   }
-  _state->device().updateDescriptorSets(write_infos, {});
   return ids;
 }
 
@@ -417,28 +631,149 @@ static std::uintptr_t get_resource_id(const T *res)
 
 void mr::BindlessDescriptorSet::unregister_resource(const Shader::Resource &resource) noexcept
 {
-  auto tex = [&](const Texture *tex) -> uint32_t {
+  auto tex = [&](const Texture *tex) -> std::uintptr_t {
     return get_resource_id(tex);
   };
-  auto ubuf = [&](const UniformBuffer *buf) -> uint32_t {
+  auto ubuf = [&](const UniformBuffer *buf) -> std::uintptr_t {
     return get_resource_id(buf);
   };
-  auto sbuf = [&](const StorageBuffer *buf) -> uint32_t {
+  auto sbuf = [&](const StorageBuffer *buf) -> std::uintptr_t {
     return get_resource_id(buf);
   };
-  auto other = [](auto &&unknown_res) -> uint32_t {
+  auto other = [](auto &&unknown_res) -> std::uintptr_t {
     ASSERT(false, "Unsupported in BindlessSet resource type", unknown_res);
     return 0;
   };
   auto resource_id = std::visit(Overloads {tex, ubuf, sbuf, other}, resource);
 
-  uint32_t binding = _bindings_of_resources[resource_id];
-  _resource_pools[binding].unregister(resource_id);
+  decltype(_bindings_of_resources)::const_accessor binding;
+  if (not _bindings_of_resources.find(binding, resource_id)) {
+    ASSERT(false, "Unregistered resource can not be unregistered");
+    return;
+  }
+  _resource_pools[binding->second].unregister(resource_id);
+}
+
+void mr::BindlessDescriptorSet::update_resource(const Shader::Resource &resource) noexcept
+{
+  ResourceInfo res_info;
+  std::uintptr_t resource_id = fill_resource_info(resource, res_info);
+
+  uint32_t binding;
+  {
+    decltype(_bindings_of_resources)::const_accessor accessor;
+    if (not _bindings_of_resources.find(accessor, resource_id)) {
+      return;
+    }
+    binding = accessor->second;
+  }
+  auto index = _resource_pools[binding].find_id(resource_id);
+  if (not index.has_value()) {
+    return;
+  }
+
+  write_descriptor(PendingWrite {
+    .binding = binding,
+    .index = index.value(),
+    .type = get_descriptor_type(resource),
+    .info = res_info,
+  });
+}
+
+void mr::BindlessDescriptorSet::flush() noexcept
+{
+  // Descriptor set updates must be externally synchronized
+  std::lock_guard lock(_flush_data->mutex);
+
+  auto &writes = _flush_data->writes;
+  auto &write_infos = _flush_data->write_infos;
+  writes.clear();
+  write_infos.clear();
+
+  PendingWrite write;
+  while (_pending_writes.try_pop(write)) {
+    writes.push_back(write);
+  }
+  if (writes.empty()) {
+    return;
+  }
+
+  // Writes are applied in order, so if slot was reused the last write wins
+  write_infos.reserve(writes.size());
+  for (const auto &write : writes) {
+    write_infos.emplace_back(vk::WriteDescriptorSet {
+      .dstSet = _set.get(),
+      .dstBinding = write.binding,
+      .dstArrayElement = write.index,
+      .descriptorCount = 1,
+      .descriptorType = write.type,
+      .pImageInfo = std::get_if<vk::DescriptorImageInfo>(&write.info),
+      .pBufferInfo = std::get_if<vk::DescriptorBufferInfo>(&write.info),
+    });
+  }
+  _state->device().updateDescriptorSets(write_infos, {});
+
+  _flush_data->flushes++;
+  _flush_data->flushed_writes += writes.size();
+}
+
+void mr::BindlessDescriptorSet::write_descriptor(const PendingWrite &write) noexcept
+{
+  if (_buffer == nullptr) {
+    _pending_writes.push(write);
+    return;
+  }
+
+  // Descriptors of binding are tightly packed array
+  VkDeviceSize offset = _buffer_offset + _binding_offsets[write.binding] +
+                        write.index * DescriptorBuffer::descriptor_size(*_state, write.type);
+  _buffer->write(offset, write.type, write.info);
+}
+
+void mr::BindlessDescriptorSet::bind(vk::CommandBuffer command_buffer,
+                                     vk::PipelineLayout pipeline_layout,
+                                     uint32_t set_number,
+                                     vk::PipelineBindPoint bind_point) const noexcept
+{
+  if (_buffer != nullptr) {
+    _buffer->bind_set(command_buffer, bind_point, pipeline_layout, set_number, _buffer_offset);
+  } else {
+    command_buffer.bindDescriptorSets(bind_point, pipeline_layout, set_number, {_set.get()}, {});
+  }
+}
+
+mr::BindlessDescriptorSet::Stats mr::BindlessDescriptorSet::stats() const noexcept
+{
+  return Stats {
+    .registrations = _flush_data->registrations.load(),
+    .flushes = _flush_data->flushes.load(),
+    .flushed_writes = _flush_data->flushed_writes.load(),
+  };
 }
 
-uint32_t mr::BindlessDescriptorSet::fill_resource(const Shader::ResourceView &resource,
-                                                  ResourceInfo &resource_info,
-                                                  vk::WriteDescriptorSet &write_info) noexcept
+uint32_t mr::BindlessDescriptorSet::fill_resource(const Shader::ResourceView &resource) noexcept
+{
+  ResourceInfo resource_info;
+  auto resource_id = fill_resource_info(resource.res, resource_info);
+  {
+    decltype(_bindings_of_resources)::accessor accessor;
+    _bindings_of_resources.insert(accessor, resource_id);
+    accessor->second = resource.binding;
+  }
+
+  uint32_t index = _resource_pools[resource.binding].get_id(resource_id);
+  write_descriptor(PendingWrite {
+    .binding = resource.binding,
+    .index = index,
+    .type = get_descriptor_type(resource.res),
+    .info = resource_info,
+  });
+  _flush_data->registrations++;
+  return index;
+}
+
+std::uintptr_t mr::BindlessDescriptorSet::fill_resource_info(const Shader::Resource &resource,
+                                                             ResourceInfo &resource_info) const noexcept
 {
   auto tex = [&](const Texture *tex) -> std::uintptr_t {
     fill_texture(tex, resource_info.emplace<vk::DescriptorImageInfo>());
@@ -456,20 +791,7 @@ uint32_t mr::BindlessDescriptorSet::fill_resource(const Shader::ResourceView &re
     ASSERT(false, "Unsupported in BindlessSet resource type", unknown_res);
     return {};
   };
-  auto resource_id = std::visit(Overloads {tex, ubuf, sbuf, other}, resource.res);
-  _bindings_of_resources[resource_id] = resource.binding;
-
-  uint32_t index = _resource_pools[resource.binding].get_id(resource_id);
-  write_info = vk::WriteDescriptorSet {
-    .dstSet = _set.get(),
-    .dstBinding = resource.binding,
-    .dstArrayElement = index,
-    .descriptorCount = 1,
-    .descriptorType = get_descriptor_type(resource.res),
-    .pImageInfo = std::get_if<vk::DescriptorImageInfo>(&resource_info),
-    .pBufferInfo = std::get_if<vk::DescriptorBufferInfo>(&resource_info),
-  };
-  return index;
+  return std::visit(Overloads {tex, ubuf, sbuf, other}, resource);
 }
 
 void mr::BindlessDescriptorSet::fill_texture(const Texture *texture,
@@ -507,15 +829,21 @@ void mr::BindlessDescriptorSet::fill_storage_buffer(const StorageBuffer *buffer,
 // ============================================================================
 
 mr::BindlessDescriptorSet::ResourcePoolData::ResourcePoolData(uint32_t max_resource_number) noexcept
-  : max_number(max_resource_number) {}
+  : max_number(max_resource_number)
+{
+  if (max_number > 0) {
+    free_next = std::make_unique<std::atomic_uint32_t[]>(max_number);
+  }
+}
 
 mr::BindlessDescriptorSet::ResourcePoolData &
 mr::BindlessDescriptorSet::ResourcePoolData::operator=(ResourcePoolData &&other) noexcept
 {
-  free_ids = std::move(other.free_ids);
+  current_id = other.current_id.load();
+  free_head = other.free_head.load();
+  free_next = std::move(other.free_next);
   usage = std::move(other.usage);
   max_number = other.max_number;
-  current_id = other.current_id.load();
   return *this;
 }
 
@@ -524,44 +852,67 @@ mr::BindlessDescriptorSet::ResourcePoolData::ResourcePoolData(ResourcePoolData &
   *this = std::move(other);
 }
 
-static uint32_t pop_back_vector(mr::InplaceVector<uint32_t, mr::resource_max_number_per_binding> &v)
+uint32_t mr::BindlessDescriptorSet::ResourcePoolData::allocate_id() noexcept
 {
-  uint32_t res = v.back();
-  v.pop_back();
-  return res;
+  uint64_t head = free_head.load(std::memory_order_acquire);
+  while (static_cast<uint32_t>(head) != invalid_id) {
+    uint32_t id = static_cast<uint32_t>(head);
+    uint64_t tag = (head >> 32) + 1;
+    uint64_t next = (tag << 32) | free_next[id].load(std::memory_order_relaxed);
+    if (free_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      return id;
+    }
+  }
+  return current_id.fetch_add(1, std::memory_order_relaxed);
 }
 
-uint32_t mr::BindlessDescriptorSet::ResourcePoolData::get_id(std::uintptr_t resource) noexcept
+void mr::BindlessDescriptorSet::ResourcePoolData::free_id(uint32_t id) noexcept
 {
-  std::lock_guard lock(mutex);
+  uint64_t head = free_head.load(std::memory_order_acquire);
+  uint64_t next;
+  do {
+    free_next[id].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    uint64_t tag = (head >> 32) + 1;
+    next = (tag << 32) | id;
+  } while (not free_head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_acquire));
+}
 
-  // Check if resource was already registered
-  if (auto res_iter = usage.find(resource); res_iter != usage.end()) {
-    auto &res_stat = res_iter->second;
-    res_stat.usage_count++;
-    return res_stat.id;
+uint32_t mr::BindlessDescriptorSet::ResourcePoolData::get_id(std::uintptr_t resource) noexcept
+{
+  // Accessor locks only bucket of this resource
+  decltype(usage)::accessor accessor;
+  if (usage.insert(accessor, resource)) {
+    // Resource wasn't registered before - find new id for it
+    accessor->second.id = allocate_id();
+    ASSERT(accessor->second.id < max_number, "Not enough space for allocate index descriptor set. "
+      "Binding capacity is limited by device descriptor indexing limits and "
+      "'resource_max_number_per_binding' in descriptor.hpp", max_number);
   }
+  accessor->second.usage_count++;
+  return accessor->second.id;
+}
 
-  // Find new id for resource
-  uint32_t id = free_ids.empty() ? current_id++ : pop_back_vector(free_ids);
-  ASSERT(id < max_number, "Not enough space for allocate index descriptor set. "
-    "To fix this you can increase 'resource_max_number_per_binding' in descriptor.hpp");
-  usage[resource] = ResourceStat {
-    .id = id,
-    .usage_count = 1,
-  };
-  return id;
+std::optional<uint32_t> mr::BindlessDescriptorSet::ResourcePoolData::find_id(std::uintptr_t resource) const noexcept
+{
+  decltype(usage)::const_accessor accessor;
+  if (usage.find(accessor, resource)) {
+    return accessor->second.id;
+  }
+  return std::nullopt;
 }
 
 void mr::BindlessDescriptorSet::ResourcePoolData::unregister(std::uintptr_t resource) noexcept
 {
-  std::lock_guard lock(mutex);
+  decltype(usage)::accessor accessor;
+  if (not usage.find(accessor, resource)) {
+    ASSERT(false, "Resource is not registered in bindless set");
+    return;
+  }
 
-  auto &stat = usage[resource];
+  auto &stat = accessor->second;
   stat.usage_count--;
   if (stat.usage_count == 0) {
-    free_ids.push_back(stat.id);
-    usage.erase(resource);
+    free_id(stat.id);
+    usage.erase(accessor);
   }
 }
-
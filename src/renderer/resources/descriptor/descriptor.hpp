@@ -3,26 +3,20 @@
 
 #include "pch.hpp"
 #include "resources/shaders/shader.hpp"
+#include "resources/descriptor/descriptor_buffer.hpp"
 
 namespace mr {
 inline namespace graphics {
   class DescriptorAllocator;
 
-  // TODO(dk6): It will be very cool to make BindlessDescriptorSet size dynamicly increased, but:
-  //  For this:
-  //  1) We must store registered resources (now we store only uintptr_t like hash).
-  //     Maybe we can store write infos instead.
-  //  2) We must recreate descriptor allocator, but we have no link on this in descriptor set.
-  //     Maybe we can move vulkan descriptor allocator in set class instead creating set from
-  //     descriptor allocator class.
-  //  3) We must recreate descriptor set layout - and this is the biggest trouble because:
-  //     1. We store set layout as readonly reference, because a lot of sets can use one layout
-  //     2. If each descriptor set will have own unique set layout it follows big increasment of
-  //        number of pipelines, but it is bad for indirect rendering
-  //     3. After recreate descriptor set layout we must recreate all pipelines - it is very
-  //        slow operation and very uncomfortable for supporting in code
-  // So, decisions of 1) and 2) aren't very difficult, but 3) is an issue
-  constexpr static uint32_t resource_max_number_per_binding = 4730;
+  // Bindless descriptor set is never grown after creation. Its layout is shared by all materials and
+  // lights pipelines, so a bigger layout would require recompilation of every pipeline.
+  // Instead each binding gets the biggest capacity which device allows for bindless layout
+  // (see get_bindless_descriptor_capacity), but not more than this value.
+  // Because of PARTIALLY_BOUND flag unused descriptors cost only descriptor pool memory.
+  constexpr static uint32_t resource_max_number_per_binding = 1 << 16;
+  // Devices which allow less descriptors per binding are rejected on render context creation
+  constexpr static uint32_t resource_min_number_per_binding = 4730;
 
   constexpr static uint32_t desciptor_set_max_bindings = 30;
 
@@ -60,7 +54,30 @@ inline namespace graphics {
   };
   MR_DECLARE_HANDLE(DescriptorSetLayout);
 
+  // Storage of bindless descriptors, it decides which device limits apply to bindless layout
+  enum class BindlessBackend {
+    DescriptorPool,   // update-after-bind pool
+    DescriptorBuffer, // VK_EXT_descriptor_buffer
+  };
+
+  inline BindlessBackend get_bindless_backend(const VulkanState &state) noexcept
+  {
+    return state.descriptor_buffer_supported() ? BindlessBackend::DescriptorBuffer : BindlessBackend::DescriptorPool;
+  }
+
+  // Number of descriptors of type in one binding of bindless set. It is fixed for VulkanState lifetime.
+  // With descriptor buffer capacities are also reduced, so whole buffer fits its device range
+  uint32_t get_bindless_descriptor_capacity(const VulkanState &state,
+                                            vk::DescriptorType type,
+                                            BindlessBackend backend) noexcept;
+  // True if every binding of bindless set in descriptor buffer gets at least 'resource_min_number_per_binding'
+  // descriptors. Descriptor buffer extension must be supported by device, it is checked before device creation
+  bool is_descriptor_buffer_sufficient(vk::PhysicalDevice phys_device) noexcept;
+
   class BindlessDescriptorSetLayout : public DescriptorSetLayout, public ResourceBase<BindlessDescriptorSetLayout> {
+  private:
+    std::array<uint32_t, desciptor_set_max_bindings> _capacities {};
+
   public:
     BindlessDescriptorSetLayout() noexcept = default;
 
@@ -70,6 +87,8 @@ inline namespace graphics {
     BindlessDescriptorSetLayout(const VulkanState &state,
                                 const vk::ShaderStageFlags stage,
                                 std::span<const BindingDescription> bindings) noexcept;
+
+    uint32_t capacity(uint32_t binding) const noexcept { return _capacities[binding]; }
   };
   MR_DECLARE_HANDLE(BindlessDescriptorSetLayout);
 
@@ -79,6 +98,9 @@ inline namespace graphics {
   private:
     vk::DescriptorSet _set;
     DescriptorSetLayoutHandle _set_layout;
+    // Used instead of '_set' if descriptor buffers are supported
+    DescriptorBuffer *_buffer = nullptr;
+    VkDeviceSize _buffer_offset = 0;
 
   public:
     DescriptorSet() = default;
@@ -89,47 +111,93 @@ inline namespace graphics {
     DescriptorSet(vk::DescriptorSet set, DescriptorSetLayoutHandle layout) noexcept
       : _set(set), _set_layout(std::move(layout)) {}
 
+    DescriptorSet(DescriptorBuffer &buffer, VkDeviceSize offset, DescriptorSetLayoutHandle layout) noexcept
+      : _set_layout(std::move(layout)), _buffer(&buffer), _buffer_offset(offset) {}
+
     void update(const VulkanState &state,
                 std::span<const Shader::ResourceView> attachments) noexcept;
 
+    void bind(vk::CommandBuffer command_buffer,
+              vk::PipelineLayout pipeline_layout,
+              uint32_t set_number,
+              vk::PipelineBindPoint bind_point = vk::PipelineBindPoint::eGraphics) const noexcept;
+
     vk::DescriptorSet set() const noexcept { return _set; }
     const DescriptorSetLayoutHandle& layout_handle() const noexcept { return _set_layout; }
 
     operator vk::DescriptorSet() const noexcept { return _set; }
   };
 
+  // Bindless descriptor set. Registration is thread safe and doesn't call Vulkan:
+  // slot ids are allocated lock-free and descriptor writes are queued until 'flush',
+  // which makes all of them in one vkUpdateDescriptorSets call.
+  // If descriptor buffers are supported set is a region of DescriptorBuffer and
+  // descriptors are written to it immediately, 'flush' has nothing to do.
   class BindlessDescriptorSet {
     friend class DescriptorAllocator;
 
+  public:
+    struct Stats {
+      uint64_t registrations = 0;
+      uint64_t flushes = 0;
+      uint64_t flushed_writes = 0;
+    };
+
   private:
     class ResourcePoolData {
       struct ResourceStat {
-        // if mutex will be removed this variable must be atomic
         uint32_t id = -1;
         uint32_t usage_count = 0;
       };
 
+      static constexpr uint32_t invalid_id = -1;
+
     private:
       std::atomic_uint32_t current_id = 0;
-      InplaceVector<uint32_t, resource_max_number_per_binding> free_ids;
-      boost::unordered_map<std::uintptr_t, ResourceStat> usage;
-      // Mutex may be bottle neck, it require profiling. Now it used for simple hanlde consistency
-      // of two data sctuctures (vector and map)
-      std::mutex mutex;
-      uint32_t max_number;
+      // Lock-free stack (Treiber stack) of released ids. Head stores id in low 32 bits
+      // and modification counter in high 32 bits to avoid ABA problem
+      std::atomic_uint64_t free_head = invalid_id;
+      std::unique_ptr<std::atomic_uint32_t[]> free_next;
+      // Per bucket locking - registrations of different resources don't wait each other
+      tbb::concurrent_hash_map<std::uintptr_t, ResourceStat> usage;
+      uint32_t max_number = 0;
 
     public:
-      ResourcePoolData(uint32_t max_resource_number = resource_max_number_per_binding) noexcept;
+      ResourcePoolData(uint32_t max_resource_number = 0) noexcept;
 
       ResourcePoolData(ResourcePoolData &&other) noexcept;
       ResourcePoolData & operator=(ResourcePoolData &&other) noexcept;
 
       uint32_t get_id(std::uintptr_t resource) noexcept;
+      std::optional<uint32_t> find_id(std::uintptr_t resource) const noexcept;
       void unregister(std::uintptr_t resource) noexcept;
+
+    private:
+      uint32_t allocate_id() noexcept;
+      void free_id(uint32_t id) noexcept;
     };
 
     using ResourceInfo = std::variant<vk::DescriptorBufferInfo, vk::DescriptorImageInfo>;
 
+    struct PendingWrite {
+      uint32_t binding;
+      uint32_t index;
+      vk::DescriptorType type;
+      ResourceInfo info;
+    };
+
+    // Not movable data, it is stored in heap to keep set movable
+    struct FlushData {
+      std::mutex mutex;
+      // Reused between flushes to avoid allocations each frame
+      std::vector<PendingWrite> writes;
+      std::vector<vk::WriteDescriptorSet> write_infos;
+
+      std::atomic_uint64_t registrations = 0;
+      std::atomic_uint64_t flushes = 0;
+      std::atomic_uint64_t flushed_writes = 0;
+    };
+
     using TypeBindingPair = std::pair<vk::DescriptorType, uint32_t>;
     // we will use not more than 15 descriptor types
     static constexpr uint32_t unique_types_array_size = 15;
@@ -140,15 +208,21 @@ inline namespace graphics {
     BindlessDescriptorSetLayoutHandle _set_layout;
     const VulkanState *_state = nullptr;
 
+    DescriptorBuffer *_buffer = nullptr;
+    VkDeviceSize _buffer_offset = 0;
+    // Offsets of bindings in set region of descriptor buffer
+    std::array<VkDeviceSize, desciptor_set_max_bindings> _binding_offsets {};
+
     UniqueDesciptorTypes _unique_resources_types;
-    // We know it max size - desciptor_set_max_bindings. But size of this array is 100kb,
-    // this is too much for stack allocation, so we use heap memory with one time allocation
-    // in consturctor
+    // Pool per binding, its index is binding number
     std::vector<ResourcePoolData> _resource_pools;
     // It is necessary for deletion. We can delete this if change interface of 'unregister_resource`: change parameter
     // from Resource to ResourceView, with data of binding. But it loops like dirty interface, I think deletion of
     // resource must be easy
-    boost::unordered_map<std::uintptr_t, uint32_t> _bindings_of_resources;
+    tbb::concurrent_hash_map<std::uintptr_t, uint32_t> _bindings_of_resources;
+
+    tbb::concurrent_queue<PendingWrite> _pending_writes;
+    std::unique_ptr<FlushData> _flush_data = std::make_unique<FlushData>();
 
   public:
     BindlessDescriptorSet() = default;
@@ -159,7 +233,12 @@ inline namespace graphics {
     BindlessDescriptorSet(const VulkanState &state,
                           vk::UniqueDescriptorSet set,
                           BindlessDescriptorSetLayoutHandle layout) noexcept;
+    BindlessDescriptorSet(const VulkanState &state,
+                          DescriptorBuffer &buffer,
+                          VkDeviceSize offset,
+                          BindlessDescriptorSetLayoutHandle layout) noexcept;
 
+    // Returned index is valid immediately, but descriptor is written only on 'flush'
     uint32_t register_resource(const Shader::Resource &resource) noexcept;
     uint32_t register_resource(const Shader::ResourceView &resource_view) noexcept;
     // If RVO here doesn't work it will be coping 120 bytes.
@@ -169,21 +248,40 @@ inline namespace graphics {
 
     void unregister_resource(const Shader::Resource &resource) noexcept;
 
+    // Rewrite descriptor of already registered resource, e.g. after its memory was moved.
+    // Index of resource in binding stays the same
+    void update_resource(const Shader::Resource &resource) noexcept;
+
+    // Write all queued descriptors. Must be called before submitting work which uses
+    // registered resources - once per frame or after loading batch of resources
+    void flush() noexcept;
+
+    Stats stats() const noexcept;
+
+    void bind(vk::CommandBuffer command_buffer,
+              vk::PipelineLayout pipeline_layout,
+              uint32_t set_number,
+              vk::PipelineBindPoint bind_point = vk::PipelineBindPoint::eGraphics) const noexcept;
+
     vk::DescriptorSet set() const noexcept { return _set.get(); }
     const BindlessDescriptorSetLayoutHandle & layout_handle() const noexcept { return _set_layout; }
 
     operator vk::DescriptorSet() const noexcept { return _set.get(); }
 
   private:
+    void init_resource_pools() noexcept;
+    // Queue write or, in descriptor buffer mode, write descriptor immediately
+    void write_descriptor(const PendingWrite &write) noexcept;
+
     void fill_texture(const Texture *texture,
                       vk::DescriptorImageInfo &image_info) const noexcept;
     void fill_uniform_buffer(const UniformBuffer *buffer,
                              vk::DescriptorBufferInfo &buffer_info) const noexcept;
     void fill_storage_buffer(const StorageBuffer *buffer,
                              vk::DescriptorBufferInfo &buffer_info) const noexcept;
-    uint32_t fill_resource(const Shader::ResourceView &resource,
-                           ResourceInfo &resource_info,
-                           vk::WriteDescriptorSet &write_info) noexcept;
+    uint32_t fill_resource(const Shader::ResourceView &resource) noexcept;
+    std::uintptr_t fill_resource_info(const Shader::Resource &resource,
+                                      ResourceInfo &resource_info) const noexcept;
 
     Shader::ResourceView try_convert_view_to_resource(const Shader::Resource &resource) const noexcept;
   };
@@ -192,6 +290,8 @@ inline namespace graphics {
   private:
     std::vector<vk::UniqueDescriptorPool> _pools;
     vk::UniqueDescriptorPool _bindless_pool;
+    // If descriptor buffers are supported all sets are allocated from it instead of pools
+    std::unique_ptr<DescriptorBuffer> _descriptor_buffer;
     const VulkanState *_state {};
 
   public:
@@ -205,8 +305,12 @@ inline namespace graphics {
     std::optional<BindlessDescriptorSet> allocate_bindless_set(
       BindlessDescriptorSetLayoutHandle set_layout) const noexcept;
 
+    // Resets only pools, regions of descriptor buffer live until allocator destruction
     void reset() noexcept;
 
+    // nullptr if descriptor buffers are not supported
+    DescriptorBuffer * descriptor_buffer() const noexcept { return _descriptor_buffer.get(); }
+
     DescriptorAllocator & operator=(DescriptorAllocator &&) noexcept = default;
     DescriptorAllocator(DescriptorAllocator &&) noexcept = default;
 
@@ -0,0 +1,150 @@
+#include "resources/descriptor/descriptor_buffer.hpp"
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+mr::DescriptorBuffer::DescriptorBuffer(const VulkanState &state, VkDeviceSize byte_size) noexcept
+  : _state(&state)
+  , _dispatch_table(state.dispatch_table())
+  , _buffer(state, byte_size,
+            vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT |
+            vk::BufferUsageFlagBits::eSamplerDescriptorBufferEXT |
+            vk::BufferUsageFlagBits::eShaderDeviceAddress)
+{
+  ASSERT(state.descriptor_buffer_supported());
+
+  // Bindless capacities are reduced to fit range, so bigger buffer is an error of its size calculation
+  if (byte_size > max_byte_size(state)) {
+    MR_FATAL("Descriptor buffer size {} B exceeds device limit {} B", byte_size, max_byte_size(state));
+    std::exit(1);
+  }
+
+  _data = _buffer.mapped_data().data();
+  _address = state.device().getBufferAddress(vk::BufferDeviceAddressInfo {.buffer = _buffer.buffer()});
+}
+
+VkDeviceSize mr::DescriptorBuffer::max_byte_size(
+  const vk::PhysicalDeviceDescriptorBufferPropertiesEXT &properties) noexcept
+{
+  return std::min({
+    properties.maxResourceDescriptorBufferRange,
+    properties.maxSamplerDescriptorBufferRange,
+    properties.resourceDescriptorBufferAddressSpaceSize,
+    properties.samplerDescriptorBufferAddressSpaceSize,
+    properties.descriptorBufferAddressSpaceSize,
+  });
+}
+
+size_t mr::DescriptorBuffer::descriptor_size(const vk::PhysicalDeviceDescriptorBufferPropertiesEXT &properties,
+                                             vk::DescriptorType type) noexcept
+{
+  using enum vk::DescriptorType;
+  switch (type) {
+    case eUniformBuffer:
+      return properties.uniformBufferDescriptorSize;
+    case eStorageBuffer:
+      return properties.storageBufferDescriptorSize;
+    case eCombinedImageSampler:
+      return properties.combinedImageSamplerDescriptorSize;
+    case eInputAttachment:
+      return properties.inputAttachmentDescriptorSize;
+    default:
+      ASSERT(false, "Unsupported in descriptor buffer descriptor type", type);
+      return 0;
+  }
+}
+
+std::optional<VkDeviceSize> mr::DescriptorBuffer::allocate(vk::DescriptorSetLayout layout) noexcept
+{
+  VkDeviceSize layout_size = 0;
+  _dispatch_table.getDescriptorSetLayoutSizeEXT(layout, &layout_size);
+
+  // All region sizes are aligned, so each region offset is aligned too
+  VkDeviceSize size = align_up(layout_size, _state->descriptor_buffer_properties().descriptorBufferOffsetAlignment);
+  VkDeviceSize offset = _allocated_size.fetch_add(size);
+  if (offset + size > byte_size()) [[unlikely]] {
+    MR_ERROR("Not enough space in descriptor buffer for set of {} B", layout_size);
+    return std::nullopt;
+  }
+  return offset;
+}
+
+VkDeviceSize mr::DescriptorBuffer::binding_offset(vk::DescriptorSetLayout layout, uint32_t binding) const noexcept
+{
+  VkDeviceSize offset = 0;
+  _dispatch_table.getDescriptorSetLayoutBindingOffsetEXT(layout, binding, &offset);
+  return offset;
+}
+
+void mr::DescriptorBuffer::write(VkDeviceSize offset, vk::DescriptorType type, const DescriptorInfo &info) noexcept
+{
+  size_t size = descriptor_size(*_state, type);
+  ASSERT(offset + size <= byte_size(), "Descriptor is out of descriptor buffer", offset);
+
+  VkDescriptorGetInfoEXT get_info {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+    .type = static_cast<VkDescriptorType>(type),
+  };
+  VkDescriptorAddressInfoEXT address_info {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+  };
+  const auto *image_info = reinterpret_cast<const VkDescriptorImageInfo *>(
+    std::get_if<vk::DescriptorImageInfo>(&info));
+
+  using enum vk::DescriptorType;
+  switch (type) {
+    case eUniformBuffer:
+    case eStorageBuffer: {
+      // Buffers are referenced by address instead of handle
+      const auto &buffer_info = std::get<vk::DescriptorBufferInfo>(info);
+      address_info.address = _state->device().getBufferAddress(vk::BufferDeviceAddressInfo {
+        .buffer = buffer_info.buffer,
+      }) + buffer_info.offset;
+      address_info.range = buffer_info.range;
+      if (type == eUniformBuffer) {
+        get_info.data.pUniformBuffer = &address_info;
+      } else {
+        get_info.data.pStorageBuffer = &address_info;
+      }
+      break;
+    }
+    case eCombinedImageSampler:
+      ASSERT(image_info != nullptr);
+      get_info.data.pCombinedImageSampler = image_info;
+      break;
+    case eInputAttachment:
+      ASSERT(image_info != nullptr);
+      get_info.data.pInputAttachmentImage = image_info;
+      break;
+    default:
+      ASSERT(false, "Unsupported in descriptor buffer descriptor type", type);
+      return;
+  }
+
+  _dispatch_table.getDescriptorEXT(&get_info, size, _data + offset);
+}
+
+void mr::DescriptorBuffer::bind(vk::CommandBuffer command_buffer) const noexcept
+{
+  VkDescriptorBufferBindingInfoEXT binding_info {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+    .address = _address,
+    .usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT,
+  };
+  _dispatch_table.cmdBindDescriptorBuffersEXT(command_buffer, 1, &binding_info);
+}
+
+void mr::DescriptorBuffer::bind_set(vk::CommandBuffer command_buffer,
+                                    vk::PipelineBindPoint bind_point,
+                                    vk::PipelineLayout layout,
+                                    uint32_t set_number,
+                                    VkDeviceSize offset) const noexcept
+{
+  // There is only one bound descriptor buffer
+  uint32_t buffer_index = 0;
+  _dispatch_table.cmdSetDescriptorBufferOffsetsEXT(command_buffer,
+                                                   static_cast<VkPipelineBindPoint>(bind_point),
+                                                   layout, set_number, 1, &buffer_index, &offset);
+}
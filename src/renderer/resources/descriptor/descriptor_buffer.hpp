@@ -0,0 +1,75 @@
+#ifndef __MR_DESCRIPTOR_BUFFER_HPP_
+#define __MR_DESCRIPTOR_BUFFER_HPP_
+
+#include "pch.hpp"
+
+#include "vulkan_state.hpp"
+#include "resources/buffer/buffer.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Host visible buffer which stores descriptors of all sets (VK_EXT_descriptor_buffer).
+  // Descriptor set is a region of this buffer and descriptor writing is a copy of data returned
+  // by vkGetDescriptorEXT to mapped memory - there are no descriptor pools and vkUpdateDescriptorSets.
+  // Regions are allocated linearly and are released only with buffer.
+  class DescriptorBuffer {
+  public:
+    using DescriptorInfo = std::variant<vk::DescriptorBufferInfo, vk::DescriptorImageInfo>;
+
+    // Space for ordinary (not bindless) descriptor sets
+    static inline constexpr VkDeviceSize default_sets_byte_size = 64 * 1024;
+
+  private:
+    const VulkanState *_state = nullptr;
+    // Cached to avoid copying whole table on each descriptor write
+    vkb::DispatchTable _dispatch_table;
+
+    HostBuffer _buffer;
+    std::byte *_data = nullptr;
+    vk::DeviceAddress _address = 0;
+
+    std::atomic<VkDeviceSize> _allocated_size = 0;
+
+  public:
+    DescriptorBuffer(const VulkanState &state, VkDeviceSize byte_size) noexcept;
+
+    DescriptorBuffer(DescriptorBuffer &&) = delete;
+    DescriptorBuffer & operator=(DescriptorBuffer &&) = delete;
+
+    // Properties variants are used before device creation
+    static size_t descriptor_size(const vk::PhysicalDeviceDescriptorBufferPropertiesEXT &properties,
+                                  vk::DescriptorType type) noexcept;
+    static size_t descriptor_size(const VulkanState &state, vk::DescriptorType type) noexcept
+    {
+      return descriptor_size(state.descriptor_buffer_properties(), type);
+    }
+    // Biggest buffer which is addressable by device both as resource and sampler descriptor buffer
+    static VkDeviceSize max_byte_size(const vk::PhysicalDeviceDescriptorBufferPropertiesEXT &properties) noexcept;
+    static VkDeviceSize max_byte_size(const VulkanState &state) noexcept
+    {
+      return max_byte_size(state.descriptor_buffer_properties());
+    }
+
+    // Returns offset of region for set with this layout, thread safe
+    std::optional<VkDeviceSize> allocate(vk::DescriptorSetLayout layout) noexcept;
+    // Offset of binding from start of set region
+    VkDeviceSize binding_offset(vk::DescriptorSetLayout layout, uint32_t binding) const noexcept;
+
+    // Thread safe for different offsets
+    void write(VkDeviceSize offset, vk::DescriptorType type, const DescriptorInfo &info) noexcept;
+
+    // Must be called once in command buffer before 'bind_set'
+    void bind(vk::CommandBuffer command_buffer) const noexcept;
+    void bind_set(vk::CommandBuffer command_buffer,
+                  vk::PipelineBindPoint bind_point,
+                  vk::PipelineLayout layout,
+                  uint32_t set_number,
+                  VkDeviceSize offset) const noexcept;
+
+    VkDeviceSize byte_size() const noexcept { return _buffer.byte_size(); }
+    VkDeviceSize allocated_byte_size() const noexcept { return _allocated_size.load(); }
+  };
+}
+} // namespace mr
+
+#endif // __MR_DESCRIPTOR_BUFFER_HPP_
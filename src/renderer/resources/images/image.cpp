@@ -186,16 +186,27 @@ void mr::Image::switch_layout(vk::ImageLayout new_layout) {
 }
 
 void mr::Image::write(std::span<const std::byte> src) {
+  write(src, _mip_level - 1);
+}
+
+void mr::Image::write(std::span<const std::byte> src, uint mip_level) {
   ASSERT(_state != nullptr);
   ASSERT(src.data());
   ASSERT(src.size() <= _size);
+  ASSERT(mip_level < _mip_level, "Mip level is out of image mips", mip_level, _mip_level);
+
+  vk::Extent3D mip_extent {
+    .width = std::max(_extent.width >> mip_level, 1u),
+    .height = std::max(_extent.height >> mip_level, 1u),
+    .depth = 1,
+  };
 
-  auto stage_buffer = HostBuffer(*_state, _size, vk::BufferUsageFlagBits::eTransferSrc);
+  auto stage_buffer = HostBuffer(*_state, src.size(), vk::BufferUsageFlagBits::eTransferSrc);
   stage_buffer.write(std::span {src});
 
   vk::ImageSubresourceLayers range {
     .aspectMask = _aspect_flags,
-      .mipLevel = _mip_level - 1,
+      .mipLevel = mip_level,
       .baseArrayLayer = 0,
       .layerCount = 1,
   };
@@ -205,7 +216,7 @@ void mr::Image::write(std::span<const std::byte> src) {
       .bufferImageHeight = 0,
       .imageSubresource = range,
       .imageOffset = {0, 0, 0},
-      .imageExtent = _extent,
+      .imageExtent = mip_extent,
   };
 
   // TODO: delete static
@@ -356,17 +367,160 @@ mr::SwapchainImage::~SwapchainImage() {
 }
 
 // ---- TextureImage ----
+// Transfer source is required to move image to another allocation on defragmentation
+static constexpr vk::ImageUsageFlags relocatable_usage_flags =
+  vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+
 mr::TextureImage::TextureImage(const VulkanState &state, Extent extent, vk::Format format,
                                vk::ImageUsageFlags usage_flags, uint mip_level)
     // TODO: replace transfer bit with StagingImage(?)
-  : DeviceImage(state, extent, format,
-                usage_flags | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
-                vk::ImageAspectFlagBits::eColor, mip_level)
-{}
+  : DeviceImage(state, extent, format, usage_flags | relocatable_usage_flags, vk::ImageAspectFlagBits::eColor, mip_level)
+  , _usage_flags(usage_flags | relocatable_usage_flags)
+{
+  register_relocatable(*_state, _allocation);
+}
 
 mr::TextureImage::TextureImage(const VulkanState &state, const mr::importer::ImageData &image, vk::ImageUsageFlags usage_flags)
-  : DeviceImage(state, image, usage_flags | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::ImageAspectFlagBits::eColor)
+  : DeviceImage(state, image, usage_flags | relocatable_usage_flags, vk::ImageAspectFlagBits::eColor)
+  , _usage_flags(usage_flags | relocatable_usage_flags)
+{
+  register_relocatable(*_state, _allocation);
+}
+
+mr::TextureImage::TextureImage(TextureImage &&other) noexcept
+  : DeviceImage(std::move(other))
+{
+  std::swap(_usage_flags, other._usage_flags);
+  std::swap(_owner, other._owner);
+  if (_state != nullptr) {
+    register_relocatable(*_state, _allocation);
+  }
+}
+
+mr::TextureImage & mr::TextureImage::operator=(TextureImage &&other) noexcept
+{
+  DeviceImage::operator=(std::move(other));
+  std::swap(_usage_flags, other._usage_flags);
+  std::swap(_owner, other._owner);
+  if (_state != nullptr) {
+    register_relocatable(*_state, _allocation);
+  }
+  if (other._state != nullptr) {
+    other.register_relocatable(*other._state, other._allocation);
+  }
+  return *this;
+}
+
+void mr::TextureImage::begin_relocation(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) noexcept
+{
+  ASSERT(not _relocated_image, "Image is already relocating");
+
+  vk::ImageCreateInfo image_create_info {
+    .imageType = vk::ImageType::e2D,
+    .format = _format,
+    .extent = _extent,
+    .mipLevels = _mip_level,
+    .arrayLayers = 1,
+    .samples = vk::SampleCountFlagBits::e1,
+    .tiling = vk::ImageTiling::eOptimal,
+    .usage = _usage_flags,
+    .sharingMode = vk::SharingMode::eExclusive,
+    .initialLayout = vk::ImageLayout::eUndefined,
+  };
+  _relocated_image = _state->device().createImage(image_create_info).value;
+  vmaBindImageMemory(_state->allocator(), dst_allocation, _relocated_image);
+
+  // Image without contents - nothing to copy
+  if (_layout == vk::ImageLayout::eUndefined) {
+    return;
+  }
+
+  vk::ImageSubresourceRange range {
+    .aspectMask = _aspect_flags,
+    .baseMipLevel = 0,
+    .levelCount = _mip_level,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+  };
+  std::array barriers {
+    vk::ImageMemoryBarrier {
+      .srcAccessMask = vk::AccessFlagBits::eMemoryWrite,
+      .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+      .oldLayout = _layout,
+      .newLayout = vk::ImageLayout::eTransferSrcOptimal,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = _image,
+      .subresourceRange = range,
+    },
+    vk::ImageMemoryBarrier {
+      .srcAccessMask = {},
+      .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .oldLayout = vk::ImageLayout::eUndefined,
+      .newLayout = vk::ImageLayout::eTransferDstOptimal,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = _relocated_image,
+      .subresourceRange = range,
+    },
+  };
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+                                 {}, {}, {}, barriers);
+
+  InplaceVector<vk::ImageCopy, 16> regions;
+  for (uint mip = 0; mip < _mip_level; mip++) {
+    vk::ImageSubresourceLayers layers {
+      .aspectMask = _aspect_flags,
+      .mipLevel = mip,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+    };
+    regions.emplace_back(vk::ImageCopy {
+      .srcSubresource = layers,
+      .dstSubresource = layers,
+      .extent = {
+        std::max(_extent.width >> mip, 1u),
+        std::max(_extent.height >> mip, 1u),
+        1
+      },
+    });
+  }
+  command_buffer.copyImage(_image, vk::ImageLayout::eTransferSrcOptimal,
+                           _relocated_image, vk::ImageLayout::eTransferDstOptimal,
+                           vk::ArrayProxy<const vk::ImageCopy>(regions.size(), regions.data()));
+
+  // New image is returned to layout in which image was used before relocation
+  vk::ImageMemoryBarrier barrier {
+    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+    .dstAccessMask = vk::AccessFlagBits::eMemoryRead,
+    .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+    .newLayout = _layout,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .image = _relocated_image,
+    .subresourceRange = range,
+  };
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+                                 {}, {}, {}, barrier);
+}
+
+void mr::TextureImage::end_relocation() noexcept
 {
+  ASSERT(_relocated_image, "Image relocation was not started");
+
+  // Memory is owned by allocation, which now points to new place
+  _state->device().destroyImageView(_image_view);
+  _state->device().destroyImage(_image);
+  _image = std::exchange(_relocated_image, vk::Image {});
+  create_image_view();
+}
+
+std::optional<mr::Shader::Resource> mr::TextureImage::bindless_resource() const noexcept
+{
+  if (_owner == nullptr) {
+    return std::nullopt;
+  }
+  return Shader::Resource(_owner);
 }
 
 // ---- DepthImage ----
@@ -375,7 +529,8 @@ mr::DepthImage::DepthImage(const VulkanState &state, Extent extent, uint mip_lev
       state,
       extent,
       get_depthbuffer_format(state),
-      vk::ImageUsageFlagBits::eDepthStencilAttachment,
+      // Depth is copied to depth pyramid for occlusion culling
+      vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferSrc,
       vk::ImageAspectFlagBits::eDepth,
       mip_level
     )
@@ -4,6 +4,7 @@
 #include "pch.hpp"
 
 #include "vulkan_state.hpp"
+#include "resources/defragmenter/relocatable.hpp"
 
 namespace mr {
 inline namespace graphics {
@@ -78,6 +79,8 @@ inline namespace graphics {
 
   public:
     void write(std::span<const std::byte> src);
+    // Writes tightly packed texels of single mip level
+    void write(std::span<const std::byte> src, uint mip_level);
 
     template <typename T>
     void write(std::span<T> src) { write(std::as_bytes(src)); }
@@ -158,22 +161,35 @@ inline namespace graphics {
   };
 
   // TextureImage: for sampled images (textures)
-  class TextureImage : public DeviceImage {
+  class TextureImage : public DeviceImage, public Relocatable {
+    private:
+      vk::ImageUsageFlags _usage_flags {};
+      // Texture which registers this image in bindless set
+      const Texture *_owner = nullptr;
+      // Image bound to new allocation while defragmentation moves it
+      vk::Image _relocated_image {};
+
     public:
       TextureImage(const VulkanState &state, Extent extent, vk::Format format, vk::ImageUsageFlags usage_flags = {}, uint mip_level = 1);
       TextureImage(const VulkanState &state, const mr::importer::ImageData &image, vk::ImageUsageFlags usage_flags = {});
-      TextureImage(TextureImage&&) noexcept = default;
-      TextureImage & operator=(TextureImage&&) noexcept = default;
+      TextureImage(TextureImage &&other) noexcept;
+      TextureImage & operator=(TextureImage &&other) noexcept;
       ~TextureImage() override = default;
       // Add mipmap generation, upload helpers as needed
 
+      void set_owner(const Texture *owner) noexcept { _owner = owner; }
+
+      void begin_relocation(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) noexcept override;
+      void end_relocation() noexcept override;
+      std::optional<Shader::Resource> bindless_resource() const noexcept override;
+
       static bool is_texture_format_supported(const VulkanState &state, vk::Format format) {
         return is_image_format_supported(
           state,
           format,
           vk::ImageType::e2D,
           vk::ImageTiling::eOptimal,
-          vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled
+          vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled
         );
       }
   };
@@ -0,0 +1,27 @@
+#include "resources/pipelines/compute_pipeline.hpp"
+
+mr::ComputePipeline::ComputePipeline(const VulkanState &state,
+                                     mr::ShaderHandle shader,
+                                     std::span<const DescriptorSetLayoutHandle> descriptor_layouts)
+  : Pipeline(state, shader, descriptor_layouts, vk::ShaderStageFlagBits::eCompute)
+{
+  ASSERT(_shader->stage_number() == 1, "Compute pipeline must have only compute stage", _shader->name());
+  ASSERT(_shader->stages()[0].stage == vk::ShaderStageFlagBits::eCompute);
+
+  vk::ComputePipelineCreateInfo create_info {
+    .flags = state.descriptor_buffer_supported()
+      ? vk::PipelineCreateFlagBits::eDescriptorBufferEXT
+      : vk::PipelineCreateFlags {},
+    .stage = _shader->stages()[0],
+    .layout = _layout.get(),
+  };
+
+  auto [result, pipeline] = state.device().createComputePipelineUnique(state.pipeline_cache(), create_info);
+  ASSERT(result == vk::Result::eSuccess, "Failed to create compute pipeline", _shader->name());
+  _pipeline = std::move(pipeline);
+}
+
+void mr::ComputePipeline::apply(vk::CommandBuffer cmd_buffer) const
+{
+  cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, _pipeline.get());
+}
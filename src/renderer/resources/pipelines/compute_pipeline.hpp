@@ -5,15 +5,42 @@
 
 namespace mr {
 inline namespace graphics {
-  class ComputePipeline : public Pipeline {
-    private:
-      uint32_t _subpass;
+  class ComputePipeline : public Pipeline, public ResourceBase<ComputePipeline> {
+    public:
+      ComputePipeline() = default;
 
-      vk::PrimitiveTopology _topology;
-      vk::VertexInputBindingDescription _binding_descriptor;
+      ComputePipeline(const VulkanState &state,
+                      mr::ShaderHandle shader,
+                      std::span<const DescriptorSetLayoutHandle> descriptor_layouts);
 
-      uint32_t PipelineParametersFlag;
+      ComputePipeline(ComputePipeline &&) noexcept = default;
+      ComputePipeline & operator=(ComputePipeline &&) noexcept = default;
+
+      void apply(vk::CommandBuffer cmd_buffer) const override;
+
+      // Push 'data' and dispatch enough workgroups for 'invocations_number' invocations
+      template <typename T>
+      void dispatch(vk::CommandBuffer cmd_buffer, const T &data, uint32_t invocations_number) const noexcept
+      {
+        static_assert(sizeof(T) <= push_constants_size, "Push constants are too big");
+        cmd_buffer.pushConstants(_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(T), &data);
+        cmd_buffer.dispatch((invocations_number + workgroup_size - 1) / workgroup_size, 1, 1);
+      }
+
+      // Push 'data' and dispatch workgroups number written to 'args_buffer' by previous GPU pass
+      template <typename T>
+      void dispatch_indirect(vk::CommandBuffer cmd_buffer, const T &data,
+                             vk::Buffer args_buffer, vk::DeviceSize offset = 0) const noexcept
+      {
+        static_assert(sizeof(T) <= push_constants_size, "Push constants are too big");
+        cmd_buffer.pushConstants(_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(T), &data);
+        cmd_buffer.dispatchIndirect(args_buffer, offset);
+      }
+
+      // Must be equal to 'local_size_x' of compute shaders
+      static inline constexpr uint32_t workgroup_size = 64;
   };
+  MR_DECLARE_HANDLE(ComputePipeline);
 }
 } // namespace mr
 
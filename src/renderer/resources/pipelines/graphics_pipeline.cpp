@@ -145,8 +145,14 @@ mr::GraphicsPipeline::GraphicsPipeline(const RenderContext &render_context,
 
   ASSERT(_shader.get());
 
+  // Pipelines which use descriptor buffers can not use descriptor sets and vice versa
+  vk::PipelineCreateFlags pipeline_flags = state.descriptor_buffer_supported()
+    ? vk::PipelineCreateFlagBits::eDescriptorBufferEXT
+    : vk::PipelineCreateFlags {};
+
   vk::StructureChain chain {
     vk::GraphicsPipelineCreateInfo {
+      .flags = pipeline_flags,
       .stageCount = _shader->stage_number(),
       .pStages = _shader->stages().data(),
       .pVertexInputState = &vertex_input_create_info,
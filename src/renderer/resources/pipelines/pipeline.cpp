@@ -5,7 +5,8 @@ void mr::Pipeline::apply(vk::CommandBuffer cmd_buffer) const {}
 
 mr::Pipeline::Pipeline(const VulkanState &state,
                        mr::ShaderHandle shader,
-                       std::span<const DescriptorSetLayoutHandle> descriptor_layouts)
+                       std::span<const DescriptorSetLayoutHandle> descriptor_layouts,
+                       vk::ShaderStageFlags push_constants_stages)
   : _shader(shader)
 {
   ASSERT(shader.get(), "Shader should be valid");
@@ -21,11 +22,17 @@ mr::Pipeline::Pipeline(const VulkanState &state,
     vk_descriptor_layouts.emplace_back(layout->layout());
   }
 
+  vk::PushConstantRange push_constant_range {
+    .stageFlags = push_constants_stages,
+    .offset = 0,
+    .size = push_constants_size,
+  };
+
   vk::PipelineLayoutCreateInfo pipeline_layout_create_info {
     .setLayoutCount = static_cast<uint32_t>(vk_descriptor_layouts.size()),
     .pSetLayouts = vk_descriptor_layouts.data(),
     .pushConstantRangeCount = 1,
-    .pPushConstantRanges = &_push_constant_range,
+    .pPushConstantRanges = &push_constant_range,
   };
 
   auto [res, layout] = state.device().createPipelineLayoutUnique(pipeline_layout_create_info);
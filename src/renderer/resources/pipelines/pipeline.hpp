@@ -8,12 +8,10 @@
 namespace mr {
 inline namespace graphics {
   class Pipeline {
-    private:
-    static inline constexpr vk::PushConstantRange _push_constant_range {
-      .stageFlags = vk::ShaderStageFlagBits::eAllGraphics,
-      .offset = 0,
-      .size = sizeof(uint32_t) * 5
-    };
+    public:
+      // All pipelines share push constants size, it is enough for 32 bindless ids and parameters.
+      // 128 bytes is minimal guaranteed maxPushConstantsSize
+      static inline constexpr uint32_t push_constants_size = sizeof(uint32_t) * 32;
 
     protected:
       vk::UniquePipeline _pipeline;
@@ -27,7 +25,8 @@ inline namespace graphics {
       Pipeline() = default;
 
       Pipeline(const VulkanState &state, mr::ShaderHandle _shader,
-               std::span<const DescriptorSetLayoutHandle> descriptor_layouts);
+               std::span<const DescriptorSetLayoutHandle> descriptor_layouts,
+               vk::ShaderStageFlags push_constants_stages = vk::ShaderStageFlagBits::eAllGraphics);
 
       const vk::Pipeline pipeline() const { return _pipeline.get(); }
 
@@ -7,6 +7,8 @@
 
 #include "resources/command_unit/command_unit.hpp"
 
+#include "resources/defragmenter/defragmenter.hpp"
+
 #include "resources/descriptor/descriptor.hpp"
 
 #include "resources/framedata/framedata.hpp"
@@ -20,5 +22,6 @@
 
 #include "resources/texture/sampler/sampler.hpp"
 #include "resources/texture/texture.hpp"
+#include "resources/texture/atlas/texture_atlas.hpp"
 
 #endif // __MR_RESOURCES_HPP_
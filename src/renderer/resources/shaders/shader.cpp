@@ -107,7 +107,10 @@ bool mr::graphics::Shader::_validate_stage(Stage stage, bool present) const noex
 {
   // TODO: add mesh & task stages
   if (not present && (stage == Stage::Vertex || stage == Stage::Fragment)) {
-    return false;
+    // Compute shaders have no graphics stages
+    std::filesystem::path compute_path = _path;
+    compute_path.append("shader").replace_extension(get_stage_name(Stage::Compute));
+    return std::filesystem::exists(compute_path);
   }
 
   auto find_stage = [this](Stage stage) {
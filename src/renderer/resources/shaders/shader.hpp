@@ -11,6 +11,7 @@ namespace mr {
 inline namespace graphics {
   class UniformBuffer;
   class StorageBuffer;
+  class ConditionalBuffer;
   class Texture;
   class Image;
 
@@ -0,0 +1,229 @@
+#include "resources/texture/atlas/texture_atlas.hpp"
+#include "manager/manager.hpp"
+
+static uint32_t align_up(uint32_t value, uint32_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// sRGB bytes are decoded to linear values for filtering, as GPU filters sRGB textures
+static float srgb_to_linear(uint32_t value) noexcept
+{
+  static const auto table = [] {
+    std::array<float, 256> table;
+    for (uint32_t i = 0; i < table.size(); i++) {
+      float srgb = i / 255.f;
+      table[i] = srgb <= 0.04045f ? srgb / 12.92f : std::pow((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+    return table;
+  }();
+  return table[value];
+}
+
+static std::byte linear_to_srgb(float value) noexcept
+{
+  float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1 / 2.4f) - 0.055f;
+  return static_cast<std::byte>(std::lround(std::clamp(srgb, 0.f, 1.f) * 255));
+}
+
+// Region must start and end on texel which exists on every mip level of the page
+static constexpr uint32_t region_alignment = 1 << (mr::TextureAtlasBuilder::page_mip_levels - 1);
+
+bool mr::TextureAtlasBuilder::is_packable(const mr::importer::ImageData &image) noexcept
+{
+  if (image.pixels.get() == nullptr || image.mips.empty()) {
+    return false;
+  }
+
+  auto extent = image.extent();
+  if (extent.width > max_packed_extent || extent.height > max_packed_extent) {
+    return false;
+  }
+
+  // Block compressed formats can not be mixed per texel, box filter below works only with byte components
+  if (vk::texelsPerBlock(image.format) != 1) {
+    return false;
+  }
+  uint8_t components = vk::componentCount(image.format);
+  for (uint8_t i = 0; i < components; i++) {
+    if (vk::componentBits(image.format, i) != 8) {
+      return false;
+    }
+  }
+  return components != 0 && vk::blockSize(image.format) == components;
+}
+
+bool mr::TextureAtlasBuilder::add(const mr::importer::ImageData &image) noexcept
+{
+  ASSERT(not _built, "Images can not be added after atlas building");
+
+  if (not is_packable(image)) {
+    return false;
+  }
+
+  const void *key = image.pixels.get();
+  if (not _sources_map.contains(key)) {
+    _sources_map[key] = _sources.size();
+    _sources.emplace_back(Source {.image = &image});
+  }
+  return true;
+}
+
+bool mr::TextureAtlasBuilder::place(Source &source) noexcept
+{
+  auto extent = source.image->extent();
+  uint32_t width = align_up(extent.width + 2 * padding, region_alignment);
+  uint32_t height = align_up(extent.height + 2 * padding, region_alignment);
+
+  // Shelf packing: sources come sorted by height, so each shelf is filled with similar regions
+  for (auto [page_index, page] : std::views::enumerate(_pages)) {
+    if (page.format != source.image->format) {
+      continue;
+    }
+
+    if (page.cursor_x + width > page_extent) {
+      page.shelf_y += page.shelf_height;
+      page.shelf_height = 0;
+      page.cursor_x = 0;
+    }
+    if (page.shelf_y + height > page_extent) {
+      continue;
+    }
+
+    source.page = page_index;
+    source.x = page.cursor_x;
+    source.y = page.shelf_y;
+    page.cursor_x += width;
+    page.shelf_height = std::max(page.shelf_height, height);
+    return true;
+  }
+  return false;
+}
+
+void mr::TextureAtlasBuilder::build() noexcept
+{
+  ASSERT(not _built, "Atlas is already built");
+  _built = true;
+
+  if (_sources.empty()) {
+    return;
+  }
+
+  std::vector<uint32_t> order(_sources.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::sort(order, std::greater {}, [this](uint32_t index) {
+    return _sources[index].image->extent().height;
+  });
+
+  for (uint32_t index : order) {
+    auto &source = _sources[index];
+    if (place(source)) {
+      continue;
+    }
+    _pages.emplace_back(Page {
+      .format = source.image->format,
+      .texel_size = vk::blockSize(source.image->format),
+    });
+    bool placed = place(source);
+    ASSERT(placed, "Texture must fit in an empty atlas page");
+  }
+
+  for (uint32_t page_index = 0; page_index < _pages.size(); page_index++) {
+    fill_page(page_index);
+  }
+
+  MR_INFO("Packed {} textures into {} atlas pages", _sources.size(), _pages.size());
+}
+
+void mr::TextureAtlasBuilder::fill_page(uint32_t page_index) noexcept
+{
+  auto &page = _pages[page_index];
+  const uint32_t texel_size = page.texel_size;
+
+  std::vector<std::vector<std::byte>> mips(page_mip_levels);
+  mips[0].resize(page_extent * page_extent * texel_size);
+
+  for (const auto &source : _sources) {
+    if (source.page != page_index) {
+      continue;
+    }
+
+    auto extent = source.image->extent();
+    std::span<const std::byte> src = source.image->mips[0];
+    ASSERT(src.size() >= extent.width * extent.height * texel_size);
+
+    // Gutter is filled with wrapped texels, so repeat addressing stays seamless on filtering
+    const int32_t pad = padding;
+    for (int32_t y = -pad; y < (int32_t)extent.height + pad; y++) {
+      uint32_t src_y = (y + extent.height) % extent.height;
+      uint32_t dst_y = source.y + pad + y;
+      for (int32_t x = -pad; x < (int32_t)extent.width + pad; x++) {
+        uint32_t src_x = (x + extent.width) % extent.width;
+        uint32_t dst_x = source.x + pad + x;
+        std::memcpy(&mips[0][(dst_y * page_extent + dst_x) * texel_size],
+                    &src[(src_y * extent.width + src_x) * texel_size],
+                    texel_size);
+      }
+    }
+  }
+
+  // Color components of sRGB formats are filtered in linear space, alpha is always linear
+  std::array<bool, 4> srgb_components {};
+  for (uint32_t c = 0; c < texel_size; c++) {
+    srgb_components[c] = std::string_view(vk::componentNumericFormat(page.format, c)) == "SRGB";
+  }
+
+  // Box filtered mips, page regions are aligned so texels of different regions are never mixed
+  for (uint32_t level = 1; level < page_mip_levels; level++) {
+    uint32_t src_extent = page_extent >> (level - 1);
+    uint32_t dst_extent = page_extent >> level;
+    const auto &src = mips[level - 1];
+    auto &dst = mips[level];
+    dst.resize(dst_extent * dst_extent * texel_size);
+
+    for (uint32_t y = 0; y < dst_extent; y++) {
+      for (uint32_t x = 0; x < dst_extent; x++) {
+        for (uint32_t c = 0; c < texel_size; c++) {
+          auto texel = [&](uint32_t sx, uint32_t sy) {
+            return std::to_integer<uint32_t>(src[(sy * src_extent + sx) * texel_size + c]);
+          };
+          auto &result = dst[(y * dst_extent + x) * texel_size + c];
+          if (srgb_components[c]) {
+            float sum = srgb_to_linear(texel(2 * x, 2 * y)) + srgb_to_linear(texel(2 * x + 1, 2 * y)) +
+                        srgb_to_linear(texel(2 * x, 2 * y + 1)) + srgb_to_linear(texel(2 * x + 1, 2 * y + 1));
+            result = linear_to_srgb(sum / 4);
+          } else {
+            uint32_t sum = texel(2 * x, 2 * y) + texel(2 * x + 1, 2 * y) +
+                           texel(2 * x, 2 * y + 1) + texel(2 * x + 1, 2 * y + 1);
+            result = static_cast<std::byte>((sum + 2) / 4);
+          }
+        }
+      }
+    }
+  }
+
+  page.texture = ResourceManager<Texture>::get().create(mr::unnamed,
+    *_state, Extent {page_extent, page_extent}, page.format, std::span<const std::vector<std::byte>>(mips));
+}
+
+std::optional<mr::TextureAtlasBuilder::Entry>
+mr::TextureAtlasBuilder::find(const mr::importer::ImageData &image) const noexcept
+{
+  ASSERT(_built, "Atlas must be built before regions lookup");
+
+  auto it = _sources_map.find(image.pixels.get());
+  if (it == _sources_map.end()) {
+    return std::nullopt;
+  }
+
+  const auto &source = _sources[it->second];
+  auto extent = image.extent();
+  const float page_size = page_extent;
+  return Entry {
+    .texture = _pages[source.page].texture,
+    .uv_transform = Vec4f(extent.width / page_size,
+                          extent.height / page_size,
+                          (source.x + padding) / page_size,
+                          (source.y + padding) / page_size),
+  };
+}
@@ -0,0 +1,80 @@
+#ifndef __MR_TEXTURE_ATLAS_HPP_
+#define __MR_TEXTURE_ATLAS_HPP_
+
+#include "resources/texture/texture.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Import time packer of small textures into shared atlas pages.
+  // Every packed texture becomes a region of some page, material addresses it with
+  // uv transform (xy - scale, zw - bias) which is applied in pbr_params.h
+  class TextureAtlasBuilder {
+  public:
+    // Textures which both sides are not greater than this value are packed
+    static inline constexpr uint32_t max_packed_extent = 128;
+    static inline constexpr uint32_t page_extent = 2048;
+    // Gutter around each region, filled with wrapped texels of region.
+    // It also bounds mip levels number of page: gutter must be at least 1 texel on the last mip
+    static inline constexpr uint32_t padding = 4;
+    static inline constexpr uint32_t page_mip_levels = std::bit_width(padding);
+
+    struct Entry {
+      TextureHandle texture;
+      Vec4f uv_transform;
+    };
+
+  private:
+    struct Source {
+      const mr::importer::ImageData *image;
+      uint32_t page = -1;
+      uint32_t x = 0;
+      uint32_t y = 0;
+    };
+
+    struct Page {
+      vk::Format format;
+      uint32_t texel_size;
+      // shelf packer state
+      uint32_t shelf_y = 0;
+      uint32_t shelf_height = 0;
+      uint32_t cursor_x = 0;
+
+      TextureHandle texture;
+    };
+
+    const VulkanState *_state = nullptr;
+
+    std::vector<Source> _sources;
+    std::vector<Page> _pages;
+    // image pixels pointer -> index in _sources, one image can be referenced by several materials
+    boost::unordered_map<const void *, uint32_t> _sources_map;
+
+    bool _built = false;
+
+  public:
+    TextureAtlasBuilder(const VulkanState &state) noexcept : _state(&state) {}
+
+    TextureAtlasBuilder(TextureAtlasBuilder &&) noexcept = default;
+    TextureAtlasBuilder & operator=(TextureAtlasBuilder &&) noexcept = default;
+
+    static bool is_packable(const mr::importer::ImageData &image) noexcept;
+
+    // Returns false if image will not be packed and must be loaded as standalone texture
+    bool add(const mr::importer::ImageData &image) noexcept;
+
+    // Pack all added images and upload atlas pages
+    void build() noexcept;
+
+    std::optional<Entry> find(const mr::importer::ImageData &image) const noexcept;
+
+    size_t pages_number() const noexcept { return _pages.size(); }
+    size_t packed_number() const noexcept { return _sources.size(); }
+
+  private:
+    bool place(Source &source) noexcept;
+    void fill_page(uint32_t page_index) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_TEXTURE_ATLAS_HPP_
@@ -4,6 +4,7 @@ mr::Texture::Texture(const VulkanState &state, const std::byte *data, Extent ext
   : _image (state, extent, format)
   , _sampler (state, vk::Filter::eLinear, vk::SamplerAddressMode::eRepeat)
 {
+  _image.set_owner(this);
   _image.switch_layout(vk::ImageLayout::eTransferDstOptimal);
   _image.write<const std::byte>(std::span{data, _image.size()});
   _image.switch_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
@@ -13,7 +14,21 @@ mr::Texture::Texture(const VulkanState &state, const mr::importer::ImageData &im
   : _image (state, image)
   , _sampler (state, vk::Filter::eLinear, vk::SamplerAddressMode::eRepeat)
 {
+  _image.set_owner(this);
   _image.switch_layout(vk::ImageLayout::eTransferDstOptimal);
   _image.write<const std::byte>(image.mips[0]);
   _image.switch_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
 }
+
+mr::Texture::Texture(const VulkanState &state, Extent extent, vk::Format format,
+                     std::span<const std::vector<std::byte>> mips) noexcept
+  : _image (state, extent, format, {}, mips.size())
+  , _sampler (state, vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge, mips.size())
+{
+  _image.set_owner(this);
+  _image.switch_layout(vk::ImageLayout::eTransferDstOptimal);
+  for (uint mip = 0; mip < mips.size(); mip++) {
+    _image.write(std::span<const std::byte>(mips[mip]), mip);
+  }
+  _image.switch_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
+}
@@ -13,11 +13,27 @@ inline namespace graphics {
       Sampler _sampler;
 
     public:
-      Texture(Texture&&) = default;
-      Texture & operator=(Texture&&) = default;
+      // Image keeps pointer to texture for descriptors update after defragmentation
+      Texture(Texture &&other) noexcept
+        : _image(std::move(other._image))
+        , _sampler(std::move(other._sampler))
+      {
+        _image.set_owner(this);
+      }
+      Texture & operator=(Texture &&other) noexcept
+      {
+        _image = std::move(other._image);
+        _sampler = std::move(other._sampler);
+        _image.set_owner(this);
+        other._image.set_owner(&other);
+        return *this;
+      }
 
       Texture(const VulkanState &state, const std::byte *data, Extent extent, vk::Format format) noexcept;
       Texture(const VulkanState &state, const mr::importer::ImageData &image) noexcept;
+      // Texture with full mip chain given by caller, each mip is tightly packed
+      Texture(const VulkanState &state, Extent extent, vk::Format format,
+              std::span<const std::vector<std::byte>> mips) noexcept;
 
       const TextureImage &image() const { return _image; }
 
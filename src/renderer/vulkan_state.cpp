@@ -1,4 +1,5 @@
 #include "vulkan_state.hpp"
+#include "resources/descriptor/descriptor.hpp"
 #include <vulkan/vulkan_core.h>
 
 mr::VulkanGlobalState::VulkanGlobalState()
@@ -96,6 +97,7 @@ void mr::VulkanGlobalState::_create_phys_device()
   };
 
   vk::PhysicalDeviceVulkan12Features features12 {
+    .drawIndirectCount = true,
     .descriptorIndexing = true,
     .descriptorBindingUniformBufferUpdateAfterBind = true,
     .descriptorBindingSampledImageUpdateAfterBind = true,
@@ -134,6 +136,22 @@ void mr::VulkanGlobalState::_create_phys_device()
   _phys_device = phys_device.value();
 
   _phys_device.enable_extensions_if_present({VK_EXT_VALIDATION_CACHE_EXTENSION_NAME});
+
+  // Descriptor buffers are optional: without them descriptor sets are allocated from pools
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptor_buffer_features {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
+    .descriptorBuffer = VK_TRUE,
+  };
+  bool descriptor_buffer_present = _phys_device.is_extension_present(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+  // Descriptor buffer layouts use limits without update-after-bind, which are much lower on some devices
+  if (descriptor_buffer_present && not is_descriptor_buffer_sufficient(_phys_device.physical_device)) {
+    MR_WARNING("Descriptor buffer limits are too low for bindless set, descriptor pools are used");
+    descriptor_buffer_present = false;
+  }
+  _descriptor_buffer_supported = descriptor_buffer_present &&
+    _phys_device.enable_extension_if_present(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) &&
+    _phys_device.enable_extension_features_if_present(descriptor_buffer_features);
+  MR_INFO("Descriptor buffers are {}", _descriptor_buffer_supported ? "used" : "not supported");
 }
 
 #ifndef NDEBUG
@@ -150,6 +168,12 @@ mr::VulkanState::VulkanState(VulkanGlobalState *state)
   _create_device();
   _create_allocator();
   _create_pipeline_cache();
+
+  if (descriptor_buffer_supported()) {
+    _descriptor_buffer_properties = phys_device().getProperties2<
+      vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorBufferPropertiesEXT>()
+        .get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+  }
 }
 
 mr::VulkanState::~VulkanState()
@@ -172,6 +196,8 @@ void mr::VulkanState::_create_allocator() {
   allocator_create_info.physicalDevice = phys_device();
   allocator_create_info.device = device();
   allocator_create_info.instance = instance();
+  // Descriptor buffers reference buffers by device address
+  allocator_create_info.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
   vmaCreateAllocator(&allocator_create_info, &_allocator);
 }
 
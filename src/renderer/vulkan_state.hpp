@@ -12,6 +12,8 @@ inline namespace graphics {
       friend class VulkanState;
       vkb::Instance _instance;
       vkb::PhysicalDevice _phys_device;
+      // VK_EXT_descriptor_buffer is enabled, all descriptors are stored in DescriptorBuffer
+      bool _descriptor_buffer_supported = false;
 
       CacheFile _pipeline_cache_file;
 
@@ -32,6 +34,7 @@ inline namespace graphics {
       vk::Queue _queue;
       vk::UniquePipelineCache _pipeline_cache;
       VmaAllocator _allocator;
+      vk::PhysicalDeviceDescriptorBufferPropertiesEXT _descriptor_buffer_properties {};
 
     public:
       VulkanState() = default;
@@ -48,6 +51,13 @@ inline namespace graphics {
       vk::Queue queue() const noexcept { return _queue; }
       vk::PipelineCache pipeline_cache() const noexcept { return *_pipeline_cache; }
       VmaAllocator allocator() const noexcept { return _allocator; }
+
+      bool descriptor_buffer_supported() const noexcept { return _global->_descriptor_buffer_supported; }
+      // Valid only if descriptor buffers are supported
+      const vk::PhysicalDeviceDescriptorBufferPropertiesEXT & descriptor_buffer_properties() const noexcept
+      {
+        return _descriptor_buffer_properties;
+      }
 #ifndef NDEBUG
       const VmaBudget * memory_budgets() const noexcept;
 #endif
@@ -30,6 +30,9 @@ inline namespace graphics {
     // semaphores for waiting frame is ready before presentin
     vk::Semaphore _current_render_finished_semaphore;
 
+    // Changed when target images are recreated, so commands recorded for old ones are outdated
+    uint64_t _targets_version = 0;
+
   protected:
     Presenter(const RenderContext &parent, Extent extent = {800, 600})
       : _extent(extent), _parent(&parent) {}
@@ -51,6 +54,7 @@ inline namespace graphics {
     vk::Semaphore render_finished_semaphore() const noexcept { return _current_render_finished_semaphore; }
 
     Extent extent() const noexcept { return _extent; }
+    uint64_t targets_version() const noexcept { return _targets_version; }
     const RenderContext & render_context() const noexcept { return *_parent; }
   };
 }
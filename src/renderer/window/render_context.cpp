@@ -7,14 +7,25 @@
 #include "resources/descriptor/descriptor.hpp"
 #include "resources/images/image.hpp"
 #include "resources/pipelines/graphics_pipeline.hpp"
+#include "resources/pipelines/compute_pipeline.hpp"
 #include "vkfw/vkfw.hpp"
 #include <vulkan/vulkan_core.h>
 #include <vulkan/vulkan_enums.hpp>
 
+// Bindings of bindless set are passed to all shaders as defines
+static boost::unordered_map<std::string, std::string> bindless_defines()
+{
+  return {
+    {"TEXTURES_BINDING",        std::to_string(mr::RenderContext::textures_binding)},
+    {"UNIFORM_BUFFERS_BINDING", std::to_string(mr::RenderContext::uniform_buffer_binding)},
+    {"STORAGE_BUFFERS_BINDING", std::to_string(mr::RenderContext::storage_buffer_binding)},
+  };
+}
+
 mr::RenderContext::RenderContext(VulkanGlobalState *global_state, Extent extent)
   : _state(std::make_shared<VulkanState>(global_state))
+  , _uploads_command_unit(*_state)
   , _models_command_unit(*_state)
-  , _lights_command_unit(*_state)
   , _transfer_command_unit(*_state)
   , _extent(extent)
   , _depthbuffer(*_state, _extent)
@@ -32,6 +43,10 @@ mr::RenderContext::RenderContext(VulkanGlobalState *global_state, Extent extent)
 
   init_bindless_rendering();
   init_lights_render_data();
+  init_culling();
+  init_impostors();
+
+  _defragmenter = Defragmenter(*_state, _bindless_set);
 }
 
 // TODO(dk6): maybe create lights_render_data.cpp file and move this function?
@@ -69,11 +84,7 @@ void mr::RenderContext::init_lights_render_data() {
 
   _lights_render_data.lights_descriptor_set.update(*_state, std::span(shader_resources.data(), gbuffers_number));
 
-  boost::unordered_map<std::string, std::string> defines {
-    {"TEXTURES_BINDING",        std::to_string(textures_binding)},
-    {"UNIFORM_BUFFERS_BINDING", std::to_string(uniform_buffer_binding)},
-    {"STORAGE_BUFFERS_BINDING", std::to_string(storage_buffer_binding)},
-  };
+  auto defines = bindless_defines();
 
   for (const auto &shader_name : LightsRenderData::shader_names) {
     std::string shader_name_str = {shader_name.begin(), shader_name.end()};
@@ -102,13 +113,197 @@ void mr::RenderContext::init_bindless_rendering()
   };
 
   _bindless_set_layout = ResourceManager<BindlessDescriptorSetLayout>::get().create("BindlessSetLayout",
-    *_state, vk::ShaderStageFlagBits::eAllGraphics, bindings);
+    *_state, vk::ShaderStageFlagBits::eAllGraphics | vk::ShaderStageFlagBits::eCompute, bindings);
 
   auto set = _default_descriptor_allocator.allocate_bindless_set(_bindless_set_layout);
   ASSERT(set.has_value(), "Failed to allocate bindless descriptor set");
   _bindless_set = std::move(set.value());
 }
 
+void mr::RenderContext::init_culling()
+{
+  auto defines = bindless_defines();
+  std::array set_layouts {DescriptorSetLayoutHandle(_bindless_set_layout)};
+
+  auto instances_shader = ResourceManager<Shader>::get().create("instances_culling",
+    *_state, "instances_culling", defines);
+  _instances_culling_pipeline = ComputePipeline(*_state, instances_shader, set_layouts);
+
+  auto draws_shader = ResourceManager<Shader>::get().create("draws_culling", *_state, "draws_culling", defines);
+  _draws_culling_pipeline = ComputePipeline(*_state, draws_shader, set_layouts);
+
+  auto meshlets_shader = ResourceManager<Shader>::get().create("meshlets_culling",
+    *_state, "meshlets_culling", defines);
+  _meshlets_culling_pipeline = ComputePipeline(*_state, meshlets_shader, set_layouts);
+
+  auto pyramid_shader = ResourceManager<Shader>::get().create("depth_pyramid", *_state, "depth_pyramid", defines);
+  _depth_pyramid_pipeline = ComputePipeline(*_state, pyramid_shader, set_layouts);
+
+  // Depth is copied to pyramid as raw floats
+  _occlusion_culling_supported = get_depthbuffer_format(*_state) == vk::Format::eD32Sfloat;
+  if (not _occlusion_culling_supported) {
+    MR_WARNING("Occlusion culling is disabled: depth buffer format is not D32_SFLOAT");
+  }
+
+  // Levels sizes are rounded up down to 1x1
+  uint32_t width = _depthbuffer.extent().width;
+  uint32_t height = _depthbuffer.extent().height;
+  uint32_t offset = 0;
+  while (true) {
+    _depth_pyramid_levels.emplace_back(DepthPyramidLevel {offset, width, height});
+    offset += width * height;
+    if (width == 1 && height == 1) {
+      break;
+    }
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+  _depth_pyramid = StorageBuffer(*_state, offset * sizeof(float));
+  _depth_pyramid_buffer_id = _bindless_set.register_resource(&_depth_pyramid);
+}
+
+void mr::RenderContext::init_impostors()
+{
+  static_assert(Impostor::atlases_number == gbuffers_number, "Impostor atlas is baked for each geometry buffer");
+
+  // Impostor quad is the same as lights screen quad
+  vk::VertexInputAttributeDescription corner_descr {
+    .location = 0,
+    .binding = 0,
+    .format = vk::Format::eR32G32Sfloat,
+    .offset = 0
+  };
+  std::array set_layouts {DescriptorSetLayoutHandle(_bindless_set_layout)};
+
+  auto shader = ResourceManager<Shader>::get().create("impostor", *_state, "impostor", bindless_defines());
+  _impostor_pipeline = GraphicsPipeline(*this, GraphicsPipeline::Subpass::OpaqueGeometry, shader,
+                                        {&corner_descr, 1}, set_layouts);
+}
+
+std::vector<std::vector<std::byte>> mr::RenderContext::bake_impostor(const Mesh &mesh,
+                                                                     const GraphicsPipeline &pipeline,
+                                                                     uint32_t material_ubo_id,
+                                                                     const Impostor::Sphere &sphere)
+{
+  Extent extent {Impostor::atlas_size, Impostor::atlas_size};
+  InplaceVector<ColorAttachmentImage, gbuffers_number> atlases;
+  for (auto _ : std::views::iota(0, gbuffers_number)) {
+    atlases.emplace_back(*_state, extent, Impostor::baked_format);
+    atlases.back().switch_layout(vk::ImageLayout::eColorAttachmentOptimal);
+  }
+  DepthImage depthbuffer(*_state, extent);
+  depthbuffer.switch_layout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+  // Each frame is separate draw with its own camera, mesh is drawn with identity transform
+  std::array<float, 16> identity {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  uint32_t first_instance = 0;
+  StorageBuffer transforms(*_state, std::span(identity));
+  StorageBuffer visible_instances(*_state, std::span(&first_instance, 1));
+  uint32_t transforms_id = _bindless_set.register_resource(&transforms);
+  uint32_t visible_instances_id = _bindless_set.register_resource(&visible_instances);
+
+  std::vector<UniformBuffer> cameras;
+  cameras.reserve(Impostor::frames_number);
+  std::vector<Mesh::RenderInfo> render_info;
+  std::vector<vk::DrawIndexedIndirectCommand> commands;
+  for (uint32_t y = 0; y < Impostor::frames_per_side; y++) {
+    for (uint32_t x = 0; x < Impostor::frames_per_side; x++) {
+      ShaderCameraData camera_data {};
+      auto viewproj = Impostor::frame_viewproj(sphere, x, y);
+      static_assert(sizeof(camera_data.vp) == sizeof(viewproj));
+      std::memcpy(&camera_data.vp, viewproj.data(), sizeof(viewproj));
+      auto &camera = cameras.emplace_back(*_state, std::span(&camera_data, 1));
+
+      render_info.emplace_back(Mesh::RenderInfo {
+        .mesh_offset = mesh._mesh_offset,
+        .instance_offset = 0,
+        .material_ubo_id = material_ubo_id,
+        .camera_buffer_id = _bindless_set.register_resource(&camera),
+        .transforms_buffer_id = transforms_id,
+        .visible_instances_buffer_id = visible_instances_id,
+      });
+      commands.emplace_back(vk::DrawIndexedIndirectCommand {
+        .indexCount = mesh.element_count(),
+        .instanceCount = 1,
+        .firstIndex = static_cast<uint32_t>(mesh._ibufs[0].offset / sizeof(uint32_t)),
+        .vertexOffset = static_cast<int32_t>(mesh._vbufs[0].offset / position_bytes_size),
+        .firstInstance = 0,
+      });
+    }
+  }
+  StorageBuffer render_info_buffer(*_state, std::span(render_info));
+  uint32_t render_info_id = _bindless_set.register_resource(&render_info_buffer);
+  StorageBuffer commands_buffer(*_state, commands.size() * sizeof(vk::DrawIndexedIndirectCommand),
+                                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer);
+  commands_buffer.write(std::span(commands));
+  _bindless_set.flush();
+
+  CommandUnit command_unit(*_state);
+  command_unit.begin();
+
+  auto atlases_attachments = atlases | std::views::transform([](const ColorAttachmentImage &atlas) {
+    return atlas.attachment_info();
+  }) | std::ranges::to<InplaceVector<vk::RenderingAttachmentInfoKHR, gbuffers_number>>();
+  auto depth_attachment_info = depthbuffer.attachment_info();
+  vk::RenderingInfoKHR attachment_info {
+    .renderArea = {0, 0, extent.width, extent.height},
+    .layerCount = 1,
+    .colorAttachmentCount = static_cast<uint32_t>(atlases_attachments.size()),
+    .pColorAttachments = atlases_attachments.data(),
+    .pDepthAttachment = &depth_attachment_info,
+  };
+  command_unit->beginRendering(&attachment_info);
+
+  vk::Viewport viewport {
+    .x = 0, .y = 0,
+    .width = static_cast<float>(extent.width),
+    .height = static_cast<float>(extent.height),
+    .minDepth = 0, .maxDepth = 1,
+  };
+  command_unit->setViewport(0, viewport);
+  command_unit->setScissor(0, vk::Rect2D {.offset = {0, 0}, .extent = {extent.width, extent.height}});
+
+  if (auto *descriptor_buffer = _default_descriptor_allocator.descriptor_buffer()) {
+    descriptor_buffer->bind(command_unit.command_buffer());
+  }
+  command_unit->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.pipeline());
+  _bindless_set.bind(command_unit.command_buffer(), pipeline.layout(), 0);
+  command_unit->pushConstants(pipeline.layout(), vk::ShaderStageFlagBits::eAllGraphics,
+                              0, sizeof(uint32_t), &render_info_id);
+
+  std::array vertex_buffers {
+    _positions_vertex_buffer.buffer(),
+    _attributes_vertex_buffer.buffer(),
+  };
+  std::array vertex_buffers_offsets {0ul, 0ul};
+  command_unit->bindVertexBuffers(0, vertex_buffers, vertex_buffers_offsets);
+  command_unit->bindIndexBuffer(_index_buffer.buffer(), 0, vk::IndexType::eUint32);
+  command_unit->drawIndexedIndirect(commands_buffer.buffer(), 0, static_cast<uint32_t>(commands.size()),
+                                    sizeof(vk::DrawIndexedIndirectCommand));
+
+  command_unit->endRendering();
+  command_unit.end();
+
+  auto submit_info = command_unit.submit_info();
+  auto fence = _state->device().createFenceUnique({}).value;
+  _state->queue().submit(submit_info, fence.get());
+  _state->device().waitForFences({fence.get()}, VK_TRUE, UINT64_MAX);
+
+  std::vector<std::vector<std::byte>> result;
+  for (uint32_t i = 0; i < atlases.size(); i++) {
+    auto baked = atlases[i].read_to_host_buffer(_transfer_command_unit).copy();
+    result.emplace_back(Impostor::pack_atlas(i, baked));
+  }
+
+  for (auto &camera : cameras) {
+    _bindless_set.unregister_resource(&camera);
+  }
+  _bindless_set.unregister_resource(&transforms);
+  _bindless_set.unregister_resource(&visible_instances);
+  _bindless_set.unregister_resource(&render_info_buffer);
+  return result;
+}
+
 mr::RenderContext::~RenderContext()
 {
   ASSERT(_state != nullptr);
@@ -142,6 +337,7 @@ mr::VertexBuffersArray mr::RenderContext::add_vertex_buffers(
   if (alloc_info.resized) {
     _positions_vertex_buffer.resize(_vertex_buffers_heap.size() * position_bytes_size);
     _attributes_vertex_buffer.resize(_vertex_buffers_heap.size() * attributes_bytes_size);
+    _vertex_buffers_version++;
   }
 
   VkDeviceSize positions_offset = alloc_info.offset * position_bytes_size;
@@ -184,66 +380,414 @@ mr::SceneHandle mr::RenderContext::create_scene() noexcept
   return ResourceManager<Scene>::get().create(mr::unnamed, *this);
 }
 
-void mr::RenderContext::render_lights(const SceneHandle scene, Presenter &presenter)
+void mr::RenderContext::render_lights(const SceneHandle scene, CommandUnit &command_unit,
+                                      const vk::RenderingAttachmentInfoKHR &target_info, Extent target_extent)
 {
-  for (auto &gbuf : _gbuffers) {
-    gbuf.switch_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
-  }
-
-  vk::RenderingAttachmentInfoKHR swapchain_image_attachment_info = presenter.target_image_info();
-
   vk::RenderingInfoKHR attachment_info {
-    .renderArea = { 0, 0, presenter.extent().width, presenter.extent().height },
+    .renderArea = { 0, 0, target_extent.width, target_extent.height },
     .layerCount = 1,
     .colorAttachmentCount = 1,
-    .pColorAttachments = &swapchain_image_attachment_info,
+    .pColorAttachments = &target_info,
   };
 
-  _depthbuffer.switch_layout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
-
-  _lights_command_unit->beginRendering(&attachment_info);
+  command_unit->beginRendering(&attachment_info);
 
   vk::Viewport viewport {
     .x = 0, .y = 0,
-    .width = static_cast<float>(presenter.extent().width),
-    .height = static_cast<float>(presenter.extent().height),
+    .width = static_cast<float>(target_extent.width),
+    .height = static_cast<float>(target_extent.height),
     .minDepth = 0, .maxDepth = 1,
   };
-  _lights_command_unit->setViewport(0, viewport);
+  command_unit->setViewport(0, viewport);
 
   vk::Rect2D scissors {
     .offset = {0, 0},
     .extent = {
-      static_cast<uint32_t>(presenter.extent().width),
-      static_cast<uint32_t>(presenter.extent().height),
+      static_cast<uint32_t>(target_extent.width),
+      static_cast<uint32_t>(target_extent.height),
     },
   };
-  _lights_command_unit->setScissor(0, scissors);
+  command_unit->setScissor(0, scissors);
+
+  if (auto *descriptor_buffer = _default_descriptor_allocator.descriptor_buffer()) {
+    descriptor_buffer->bind(command_unit.command_buffer());
+  }
 
   // shade all
-  _lights_command_unit->bindVertexBuffers(0, {_lights_render_data.screen_vbuf.buffer()}, {0});
-  _lights_command_unit->bindIndexBuffer(_lights_render_data.screen_ibuf.buffer(), 0, vk::IndexType::eUint32);
+  command_unit->bindVertexBuffers(0, {_lights_render_data.screen_vbuf.buffer()}, {0});
+  command_unit->bindIndexBuffer(_lights_render_data.screen_ibuf.buffer(), 0, vk::IndexType::eUint32);
 
-  std::apply([this](const auto &lights) {
+  std::apply([&command_unit](const auto &lights) {
     for (auto light_handle : lights) {
-      light_handle->shade(_lights_command_unit);
+      light_handle->shade(command_unit);
     }
   }, scene->_lights);
 
-  _lights_command_unit->endRendering();
+  command_unit->endRendering();
+}
+
+mr::RenderContext::LightsRecord & mr::RenderContext::lights_record(const SceneHandle scene,
+                                                                   const Presenter &presenter,
+                                                                   vk::ImageView target, bool &recorded) noexcept
+{
+  // Records of recreated or other presenter targets are dropped, their images can be destroyed
+  std::erase_if(_lights_records, [&](const LightsRecord &record) {
+    return record.presenter != &presenter || record.targets_version != presenter.targets_version();
+  });
+
+  auto record = std::ranges::find(_lights_records, target, &LightsRecord::target);
+  if (record == _lights_records.end()) {
+    if (_lights_records.size() == max_images_number) {
+      _lights_records.clear();
+    }
+    record = _lights_records.emplace(_lights_records.end(), LightsRecord {
+      .command_unit = CommandUnit(*_state),
+      .presenter = &presenter,
+      .targets_version = presenter.targets_version(),
+      .target = target,
+    });
+    recorded = false;
+    return *record;
+  }
+
+  recorded = _commands_reuse && record->scene == scene.get() && record->lights == _lights_state &&
+             record->extent.width == presenter.extent().width && record->extent.height == presenter.extent().height;
+  return *record;
+}
+
+void mr::RenderContext::cull_models(const SceneHandle scene, CullingPhase phase)
+{
+  uint32_t instances_number = scene->instances_number();
+  if (instances_number == 0) {
+    return;
+  }
+
+  auto command_buffer = _models_command_unit.command_buffer();
+
+  // Counters are accumulated by atomics, so they are cleared each frame
+  command_buffer.fillBuffer(scene->_mesh_visible_counts.buffer(), 0,
+                            scene->_bounds_data.size() * Scene::mesh_visible_counts_stride * sizeof(uint32_t), 0);
+  command_buffer.fillBuffer(scene->_draw_counts.buffer(), 0, scene->_draws.size() * sizeof(uint32_t), 0);
+  command_buffer.fillBuffer(scene->_meshlet_draw_counts.buffer(), 0, scene->_draws.size() * sizeof(uint32_t), 0);
+  command_buffer.fillBuffer(scene->_depth_bucket_counts.buffer(), 0,
+                            scene->_draws.size() * 2 * Scene::depth_buckets_number * sizeof(uint32_t), 0);
+  // Nearest depth is accumulated by atomicMin on float bits
+  command_buffer.fillBuffer(scene->_mesh_depths.buffer(), 0, scene->_bounds_data.size() * sizeof(uint32_t),
+                            std::numeric_limits<uint32_t>::max());
+  if (phase != CullingPhase::Late) {
+    command_buffer.fillBuffer(scene->_culling_stats.buffer(), 0, sizeof(Scene::OcclusionStats), 0);
+  }
+  Scene::MeshletTasksHeader empty_tasks {.x = 0, .y = 1, .z = 1};
+  command_buffer.updateBuffer(scene->_meshlet_tasks.buffer(), 0, sizeof(empty_tasks), &empty_tasks);
+
+  vk::MemoryBarrier clear_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+    .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+  };
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+                                 {}, clear_barrier, {}, {});
+
+  // ===== Instances culling =====
+
+  struct {
+    uint32_t camera_buffer_id;
+    uint32_t transforms_buffer_id;
+    uint32_t bounds_buffer_id;
+    uint32_t instance_meshes_buffer_id;
+    uint32_t mesh_visible_counts_buffer_id;
+    uint32_t visible_instances_buffer_id;
+    uint32_t instance_visibility_buffer_id;
+    uint32_t depth_pyramid_buffer_id;
+    uint32_t culling_stats_buffer_id;
+    uint32_t instances_number;
+    CullingPhase phase;
+    uint32_t pyramid_width;
+    uint32_t pyramid_height;
+    uint32_t pyramid_levels;
+    uint32_t mesh_meshlets_buffer_id;
+    uint32_t meshlet_tasks_buffer_id;
+    uint32_t mesh_lods_buffer_id;
+    uint32_t instance_lods_buffer_id;
+    uint32_t lod_selection;
+    float lod_threshold;
+    float lod_hysteresis;
+    float viewport_height;
+    uint32_t meshlet_draw_counts_buffer_id;
+    uint32_t mesh_depths_buffer_id;
+  } instances_params {
+    .camera_buffer_id = scene->_camera_buffer_id,
+    .transforms_buffer_id = scene->_transforms.id(),
+    .bounds_buffer_id = scene->_bounds.id(),
+    .instance_meshes_buffer_id = scene->_instance_meshes.id(),
+    .mesh_visible_counts_buffer_id = scene->_mesh_visible_counts.id(),
+    .visible_instances_buffer_id = scene->_visible_instances.id(),
+    .instance_visibility_buffer_id = scene->_instance_visibility.id(),
+    .depth_pyramid_buffer_id = _depth_pyramid_buffer_id,
+    .culling_stats_buffer_id = scene->_culling_stats_buffer_id,
+    .instances_number = instances_number,
+    .phase = phase,
+    .pyramid_width = _depth_pyramid_levels.front().width,
+    .pyramid_height = _depth_pyramid_levels.front().height,
+    .pyramid_levels = static_cast<uint32_t>(_depth_pyramid_levels.size()),
+    .mesh_meshlets_buffer_id = scene->_mesh_meshlets.id(),
+    .meshlet_tasks_buffer_id = scene->_meshlet_tasks.id(),
+    .mesh_lods_buffer_id = scene->_mesh_lods.id(),
+    .instance_lods_buffer_id = scene->_instance_lods.id(),
+    .lod_selection = scene->_lod_selection,
+    .lod_threshold = scene->_lod_selector.threshold(),
+    .lod_hysteresis = scene->_lod_selector.hysteresis(),
+    .viewport_height = static_cast<float>(_extent.height),
+    .meshlet_draw_counts_buffer_id = scene->_meshlet_draw_counts.id(),
+    .mesh_depths_buffer_id = scene->_mesh_depths.id(),
+  };
+
+  _instances_culling_pipeline.apply(command_buffer);
+  _bindless_set.bind(command_buffer, _instances_culling_pipeline.layout(), 0, vk::PipelineBindPoint::eCompute);
+  _instances_culling_pipeline.dispatch(command_buffer, instances_params, instances_number);
+
+  vk::MemoryBarrier instances_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+    .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+  };
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                                 {}, instances_barrier, {}, {});
+
+  // ===== Draws compaction =====
+
+  // Commands of each group are sorted front to back by depth buckets of their meshes: the first pass counts
+  // commands of each bucket, the second one writes them after commands of nearer buckets
+  _draws_culling_pipeline.apply(command_buffer);
+  _bindless_set.bind(command_buffer, _draws_culling_pipeline.layout(), 0, vk::PipelineBindPoint::eCompute);
+
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    if (pass > 0) {
+      vk::MemoryBarrier counts_barrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+      };
+      command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                     vk::PipelineStageFlagBits::eComputeShader, {}, counts_barrier, {}, {});
+    }
+
+    for (auto &[pipeline, draw] : scene->_draws) {
+      struct {
+        uint32_t commands_buffer_id;
+        uint32_t render_info_buffer_id;
+        uint32_t culled_commands_buffer_id;
+        uint32_t culled_render_info_buffer_id;
+        uint32_t mesh_visible_counts_buffer_id;
+        uint32_t draw_counts_buffer_id;
+        uint32_t draw_group;
+        uint32_t draws_number;
+        uint32_t mesh_lods_buffer_id;
+        uint32_t instances_number;
+        uint32_t mesh_depths_buffer_id;
+        uint32_t depth_bucket_counts_buffer_id;
+        uint32_t pass;
+      } draws_params {
+        .commands_buffer_id = draw.commands_buffer.id(),
+        .render_info_buffer_id = draw.meshes_render_info.id(),
+        .culled_commands_buffer_id = draw.culled_commands_buffer.id(),
+        .culled_render_info_buffer_id = draw.culled_render_info.id(),
+        .mesh_visible_counts_buffer_id = scene->_mesh_visible_counts.id(),
+        .draw_counts_buffer_id = scene->_draw_counts.id(),
+        .draw_group = draw.index,
+        .draws_number = static_cast<uint32_t>(draw.meshes.size()),
+        .mesh_lods_buffer_id = scene->_mesh_lods.id(),
+        .instances_number = instances_number,
+        .mesh_depths_buffer_id = scene->_mesh_depths.id(),
+        .depth_bucket_counts_buffer_id = scene->_depth_bucket_counts.id(),
+        .pass = pass,
+      };
+      _draws_culling_pipeline.dispatch(command_buffer, draws_params, draws_params.draws_number);
+    }
+  }
+
+  // ===== Meshlets culling =====
+
+  // Tasks number is known only by GPU, so meshlets culling is dispatched indirectly.
+  // Its commands are appended after compacted commands of whole meshes
+  vk::MemoryBarrier tasks_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+    .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead |
+                     vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+  };
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                 vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+                                 {}, tasks_barrier, {}, {});
+
+  struct {
+    uint32_t camera_buffer_id;
+    uint32_t transforms_buffer_id;
+    uint32_t visible_instances_buffer_id;
+    uint32_t meshlets_buffer_id;
+    uint32_t mesh_meshlets_buffer_id;
+    uint32_t meshlet_tasks_buffer_id;
+    uint32_t draw_counts_buffer_id;
+  } meshlets_params {
+    .camera_buffer_id = scene->_camera_buffer_id,
+    .transforms_buffer_id = scene->_transforms.id(),
+    .visible_instances_buffer_id = scene->_visible_instances.id(),
+    .meshlets_buffer_id = scene->_meshlets.id(),
+    .mesh_meshlets_buffer_id = scene->_mesh_meshlets.id(),
+    .meshlet_tasks_buffer_id = scene->_meshlet_tasks.id(),
+    .draw_counts_buffer_id = scene->_draw_counts.id(),
+  };
+
+  _meshlets_culling_pipeline.apply(command_buffer);
+  _bindless_set.bind(command_buffer, _meshlets_culling_pipeline.layout(), 0, vk::PipelineBindPoint::eCompute);
+  _meshlets_culling_pipeline.dispatch_indirect(command_buffer, meshlets_params, scene->_meshlet_tasks.buffer());
+
+  vk::MemoryBarrier draws_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+    .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead,
+  };
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                 vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader,
+                                 {}, draws_barrier, {}, {});
+}
+
+void mr::RenderContext::build_depth_pyramid()
+{
+  auto command_buffer = _models_command_unit.command_buffer();
+
+  // Previous phase draws must finish before culling buffers are rewritten
+  vk::MemoryBarrier draws_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead,
+    .dstAccessMask = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite,
+  };
+  vk::ImageMemoryBarrier depth_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+    .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+    .oldLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+    .newLayout = vk::ImageLayout::eTransferSrcOptimal,
+    .image = _depthbuffer.image(),
+    .subresourceRange = {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1},
+  };
+  command_buffer.pipelineBarrier(
+    vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader |
+      vk::PipelineStageFlagBits::eLateFragmentTests,
+    vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+    {}, draws_barrier, {}, depth_barrier);
+
+  // Level 0 is depth buffer itself
+  const auto &base_level = _depth_pyramid_levels.front();
+  vk::BufferImageCopy region {
+    .bufferOffset = 0,
+    .imageSubresource = {vk::ImageAspectFlagBits::eDepth, 0, 0, 1},
+    .imageExtent = {base_level.width, base_level.height, 1},
+  };
+  command_buffer.copyImageToBuffer(_depthbuffer.image(), vk::ImageLayout::eTransferSrcOptimal,
+                                   _depth_pyramid.buffer(), region);
+
+  std::swap(depth_barrier.oldLayout, depth_barrier.newLayout);
+  depth_barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+  depth_barrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                                vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+  vk::MemoryBarrier copy_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+    .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+  };
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                 vk::PipelineStageFlagBits::eComputeShader |
+                                   vk::PipelineStageFlagBits::eEarlyFragmentTests,
+                                 {}, copy_barrier, {}, depth_barrier);
+
+  _depth_pyramid_pipeline.apply(command_buffer);
+  _bindless_set.bind(command_buffer, _depth_pyramid_pipeline.layout(), 0, vk::PipelineBindPoint::eCompute);
+
+  vk::MemoryBarrier level_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+    .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+  };
+  for (auto [src, dst] : _depth_pyramid_levels | std::views::adjacent<2>) {
+    struct {
+      uint32_t depth_pyramid_buffer_id;
+      uint32_t src_offset;
+      uint32_t src_width;
+      uint32_t src_height;
+      uint32_t dst_offset;
+      uint32_t dst_width;
+      uint32_t dst_height;
+    } level_params {
+      .depth_pyramid_buffer_id = _depth_pyramid_buffer_id,
+      .src_offset = src.offset,
+      .src_width = src.width,
+      .src_height = src.height,
+      .dst_offset = dst.offset,
+      .dst_width = dst.width,
+      .dst_height = dst.height,
+    };
+    _depth_pyramid_pipeline.dispatch(command_buffer, level_params, dst.width * dst.height);
+    command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                   vk::PipelineStageFlagBits::eComputeShader,
+                                   {}, level_barrier, {}, {});
+  }
 }
 
 void mr::RenderContext::render_models(const SceneHandle scene)
 {
-  for (auto &gbuf : _gbuffers) {
-    gbuf.switch_layout(vk::ImageLayout::eColorAttachmentOptimal);
+  _draw_stats = {};
+
+  if (auto *descriptor_buffer = _default_descriptor_allocator.descriptor_buffer()) {
+    descriptor_buffer->bind(_models_command_unit.command_buffer());
   }
-  _depthbuffer.switch_layout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
-  auto gbufs_attachs = _gbuffers | std::views::transform([](const ColorAttachmentImage &gbuf) {
-    return gbuf.attachment_info();
+  if (not scene->_gpu_culling) {
+    draw_models(scene, true);
+    return;
+  }
+
+  if (scene->_occlusion_culling && _occlusion_culling_supported) {
+    // Instances visible in previous frame are good occluders for this frame
+    cull_models(scene, CullingPhase::Early);
+    draw_models(scene, true);
+
+    build_depth_pyramid();
+
+    cull_models(scene, CullingPhase::Late);
+
+    // Second pass loads gbuffers written by the first one
+    vk::MemoryBarrier gbuffers_barrier {
+      .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+      .dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+    };
+    _models_command_unit->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                          vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                          {}, gbuffers_barrier, {}, {});
+    draw_models(scene, false);
+  } else {
+    cull_models(scene, CullingPhase::Frustum);
+    draw_models(scene, true);
+  }
+
+  // Statistics are read by scene after frame finishes
+  vk::MemoryBarrier stats_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+    .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+  };
+  _models_command_unit->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+                                        {}, stats_barrier, {}, {});
+  _models_command_unit->copyBuffer(scene->_culling_stats.buffer(), scene->_culling_stats_readback.buffer(),
+                                   vk::BufferCopy {.size = sizeof(Scene::OcclusionStats)});
+  vk::MemoryBarrier readback_barrier {
+    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+    .dstAccessMask = vk::AccessFlagBits::eHostRead,
+  };
+  _models_command_unit->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                                        {}, readback_barrier, {}, {});
+}
+
+void mr::RenderContext::draw_models(const SceneHandle scene, bool clear)
+{
+  auto load_op = clear ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
+  auto gbufs_attachs = _gbuffers | std::views::transform([load_op](const ColorAttachmentImage &gbuf) {
+    auto attachment_info = gbuf.attachment_info();
+    attachment_info.loadOp = load_op;
+    return attachment_info;
   }) | std::ranges::to<InplaceVector<vk::RenderingAttachmentInfoKHR, gbuffers_number>>();
   auto depth_attachment_info = _depthbuffer.attachment_info();
+  depth_attachment_info.loadOp = load_op;
 
   vk::RenderingInfoKHR attachment_info {
     .renderArea = { 0, 0, _extent.width, _extent.height },
@@ -284,25 +828,42 @@ void mr::RenderContext::render_models(const SceneHandle scene)
 
   _models_command_unit->bindIndexBuffer(_index_buffer.buffer(), 0, vk::IndexType::eUint32);
 
-  for (auto &[pipeline, draw] : scene->_draws) {
+  // Groups are drawn in order of pipelines in draw list keys, commands inside of group are sorted by
+  // material and depth by CPU culling. Layouts of all material pipelines have the same bindless set and
+  // push constants range, so they are compatible and set stays bound after pipeline changes
+  bool set_bound = false;
+  for (const auto &[pipeline, draw] : scene->_draw_order) {
+    if (not scene->_gpu_culling && draw->culled_commands_data.empty()) {
+      continue;
+    }
+
     _models_command_unit->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->pipeline());
+    _draw_stats.pipeline_binds++;
 
-    std::array sets {_bindless_set.set()};
-    _models_command_unit->bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                             {pipeline->layout()},
-                                             0, // TODO(dk6): give name for this magic number
-                                             sets,
-                                             {});
+    if (not set_bound) {
+      _bindless_set.bind(_models_command_unit.command_buffer(), pipeline->layout(),
+                         0); // TODO(dk6): give name for this magic number
+      _draw_stats.descriptor_set_binds++;
+      set_bound = true;
+    }
 
+    uint32_t render_info_id = draw->culled_render_info.id();
     _models_command_unit->pushConstants(pipeline->layout(), vk::ShaderStageFlagBits::eAllGraphics,
-                                        0, sizeof(uint32_t), &draw.meshes_render_info_id);
-
-    // TODO(dk6): Update only if scene updates on this frame
-    draw.commands_buffer.write(std::span(draw.commands_buffer_data));
-    draw.meshes_render_info.write(std::span(draw.meshes_render_info_data));
+                                        0, sizeof(uint32_t), &render_info_id);
 
     uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
-    _models_command_unit->drawIndexedIndirect(draw.commands_buffer.buffer(), 0, draw.meshes.size(), stride);
+    if (scene->_gpu_culling) {
+      // Draws number is written by culling compute shaders, meshlets can give more draws than meshes
+      _models_command_unit->drawIndexedIndirectCount(draw->culled_commands_buffer.buffer(), 0,
+                                                     scene->_draw_counts.buffer(), draw->index * sizeof(uint32_t),
+                                                     static_cast<uint32_t>(draw->culled_commands_buffer.capacity()),
+                                                     stride);
+    } else {
+      _models_command_unit->drawIndexedIndirect(draw->culled_commands_buffer.buffer(), 0,
+                                                draw->culled_commands_data.size(), stride);
+      _draw_stats.draw_commands += static_cast<uint32_t>(draw->culled_commands_data.size());
+    }
+    _draw_stats.indirect_draws++;
 
     // TODO(dk6): If we rendering different meshes for one indirect commands we can not use conditional rendering :(
 
@@ -324,6 +885,25 @@ void mr::RenderContext::render_models(const SceneHandle scene)
     // }
   }
 
+  // ===== Rendering impostors ======
+
+  // Impostor instances are selected with LODs, which works only with CPU culling
+  if (not scene->_gpu_culling && not scene->_impostor_commands_data.empty()) {
+    _impostor_pipeline.apply(_models_command_unit.command_buffer());
+    _bindless_set.bind(_models_command_unit.command_buffer(), _impostor_pipeline.layout(), 0);
+    _draw_stats.pipeline_binds++;
+    _draw_stats.descriptor_set_binds++;
+    uint32_t impostor_draws_id = scene->_impostor_draws.id();
+    _models_command_unit->pushConstants(_impostor_pipeline.layout(), vk::ShaderStageFlagBits::eAllGraphics,
+                                        0, sizeof(uint32_t), &impostor_draws_id);
+
+    _models_command_unit->bindVertexBuffers(0, {_lights_render_data.screen_vbuf.buffer()}, {0});
+    _models_command_unit->bindIndexBuffer(_lights_render_data.screen_ibuf.buffer(), 0, vk::IndexType::eUint32);
+    _models_command_unit->drawIndexedIndirect(scene->_impostor_commands.buffer(), 0,
+                                              scene->_impostor_commands_data.size(),
+                                              sizeof(vk::DrawIndexedIndirectCommand));
+  }
+
   _models_command_unit->endRendering();
 }
 
@@ -340,19 +920,58 @@ void mr::RenderContext::render(const SceneHandle scene, Presenter &presenter)
   _state->device().waitForFences(_image_fence.get(), VK_TRUE, UINT64_MAX);
   _state->device().resetFences(_image_fence.get());
 
+  // Previous frame is finished, so resources can be moved in memory
+  bool defragmenting = _defragmenter.running();
+  _defragmenter.step();
+  defragmenting = defragmenting || _defragmenter.running();
+
   resize(presenter.extent());
   // NOTE: Camera UBO is already updated and this resize will only affect next frame
   scene->_camera.cam().projection().resize((float)_extent.width / _extent.height);
 
+  scene->cull();
+
+  // Descriptors registered since previous frame, moved by defragmentation or resized by culling are written here
+  _bindless_set.flush();
+
+  _record_stats.frames++;
+
+  // Transforms of moved instances are copied before they are read by culling and drawing
+  _uploads_command_unit.begin();
+  bool uploads_recorded = scene->record_uploads(_uploads_command_unit.command_buffer());
+  _uploads_command_unit.end();
+  if (uploads_recorded) {
+    _state->queue().submit(_uploads_command_unit.submit_info());
+  }
+
   // --------------------------------------------------------------------------
   // Model rendering pass
   // --------------------------------------------------------------------------
 
-  _models_command_unit.begin();
-  render_models(scene);
+  // Layouts are switched by separate submissions, so they aren't recorded into reused commands
+  for (auto &gbuf : _gbuffers) {
+    gbuf.switch_layout(vk::ImageLayout::eColorAttachmentOptimal);
+  }
+  _depthbuffer.switch_layout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+  // Defragmentation moves buffers which are recorded into commands
+  bool models_recorded = _commands_reuse && scene->_gpu_culling && not defragmenting && _models_record &&
+                         _models_record->scene == scene.get() &&
+                         _models_record->scene_version == scene->_structure_version &&
+                         _models_record->geometry_version == geometry_version() &&
+                         _models_record->extent.width == _extent.width &&
+                         _models_record->extent.height == _extent.height;
+  if (models_recorded) {
+    _models_command_unit.clear_semaphores();
+  } else {
+    _models_command_unit.begin();
+    render_models(scene);
+    _models_command_unit.end();
+    _models_record = ModelsRecord {scene.get(), scene->_structure_version, geometry_version(), _extent};
+    _record_stats.models_records++;
+  }
 
   _models_command_unit.add_signal_semaphore(_models_render_finished_semaphore.get());
-  _models_command_unit.end();
   vk::SubmitInfo models_submit_info = _models_command_unit.submit_info();
 
   _state->queue().submit(models_submit_info);
@@ -361,20 +980,44 @@ void mr::RenderContext::render(const SceneHandle scene, Presenter &presenter)
   // Lights shading pass
   // --------------------------------------------------------------------------
 
-  _lights_command_unit.begin();
-  render_lights(scene, presenter);
+  _lights_state.clear();
+  std::apply([this](const auto &lights) {
+    for (const auto &light_handle : lights) {
+      light_handle->update_ubo();
+      _lights_state.emplace_back(light_handle.get(), light_handle->enabled());
+    }
+  }, scene->_lights);
+
+  for (auto &gbuf : _gbuffers) {
+    gbuf.switch_layout(vk::ImageLayout::eShaderReadOnlyOptimal);
+  }
+  _depthbuffer.switch_layout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+  vk::RenderingAttachmentInfoKHR target_info = presenter.target_image_info();
+  bool lights_recorded = false;
+  auto &lights = lights_record(scene, presenter, target_info.imageView, lights_recorded);
+  if (lights_recorded) {
+    lights.command_unit.clear_semaphores();
+  } else {
+    lights.command_unit.begin();
+    render_lights(scene, lights.command_unit, target_info, presenter.extent());
+    lights.command_unit.end();
+    lights.scene = scene.get();
+    lights.extent = presenter.extent();
+    lights.lights = _lights_state;
+    _record_stats.lights_records++;
+  }
 
-  _lights_command_unit.add_wait_semaphore(_models_render_finished_semaphore.get(),
-                                   vk::PipelineStageFlagBits::eColorAttachmentOutput);
+  lights.command_unit.add_wait_semaphore(_models_render_finished_semaphore.get(),
+                                         vk::PipelineStageFlagBits::eColorAttachmentOutput);
   auto image_available_semaphore = presenter.image_available_semaphore();
   if (image_available_semaphore) {
-    _lights_command_unit.add_wait_semaphore(image_available_semaphore,
-                                     vk::PipelineStageFlagBits::eColorAttachmentOutput);
+    lights.command_unit.add_wait_semaphore(image_available_semaphore,
+                                           vk::PipelineStageFlagBits::eColorAttachmentOutput);
   }
-  _lights_command_unit.add_signal_semaphore(presenter.render_finished_semaphore());
-  _lights_command_unit.end();
+  lights.command_unit.add_signal_semaphore(presenter.render_finished_semaphore());
 
-  vk::SubmitInfo light_submit_info = _lights_command_unit.submit_info();
+  vk::SubmitInfo light_submit_info = lights.command_unit.submit_info();
 
   _state->queue().submit(light_submit_info, _image_fence.get());
 
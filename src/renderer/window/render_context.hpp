@@ -43,12 +43,54 @@ inline namespace graphics {
     constexpr static inline uint32_t default_vertex_number = 10'000'000;
     constexpr static inline uint32_t default_index_number = default_vertex_number * 2;
 
+    // State changes of last recorded geometry pass
+    struct DrawStats {
+      uint32_t pipeline_binds = 0;
+      uint32_t descriptor_set_binds = 0;
+      uint32_t indirect_draws = 0;
+      uint32_t draw_commands = 0; // in indirect draws, known only with CPU culling
+    };
+
+    // Numbers of frames which recorded passes again, the rest of frames resubmitted recorded commands
+    struct RecordStats {
+      uint64_t frames = 0;
+      uint64_t models_records = 0;
+      uint64_t lights_records = 0;
+    };
+
   private:
     std::shared_ptr<VulkanState> _state;
     Extent _extent;
 
+    // Geometry and lighting passes are recorded once and submitted again while nothing recorded
+    // into them changes: camera and lights are read from uniform buffers, instances from storage buffers.
+    // Only GPU culling pass can be reused, CPU culling changes draws number each frame.
+    // One frame is in flight, so the same command buffers are free after frame fence waiting
+    struct ModelsRecord {
+      const Scene *scene = nullptr;
+      uint64_t scene_version = 0;
+      uint64_t geometry_version = 0; // vertex and index buffers are bound by recorded commands
+      Extent extent;
+    };
+    // Lights pass writes presenter target image, so it is recorded for each of them
+    struct LightsRecord {
+      CommandUnit command_unit;
+      const Presenter *presenter = nullptr;
+      uint64_t targets_version = 0;
+      vk::ImageView target;
+      Extent extent;
+      const Scene *scene = nullptr;
+      std::vector<std::pair<const Light *, bool>> lights; // with enabled flag
+    };
+
+    // Per frame copies to scene buffers, submitted before geometry pass
+    CommandUnit _uploads_command_unit;
     CommandUnit _models_command_unit;
-    CommandUnit _lights_command_unit;
+    std::optional<ModelsRecord> _models_record;
+    std::vector<LightsRecord> _lights_records;
+    std::vector<std::pair<const Light *, bool>> _lights_state;
+    bool _commands_reuse = true;
+    RecordStats _record_stats;
     // RenderContext doesn't use transfer command unit, only gives it for buffers
     // Writting commands to it doesn't affect RenderContext internal state
     mutable CommandUnit _transfer_command_unit;
@@ -78,6 +120,32 @@ inline namespace graphics {
     VertexVectorBuffer _positions_vertex_buffer;
     VertexVectorBuffer _attributes_vertex_buffer;
     IndexHeapBuffer _index_buffer;
+    uint64_t _vertex_buffers_version = 0; // incremented each time vertex buffers are recreated by growth
+
+    Defragmenter _defragmenter;
+
+    // GPU culling of instances and compaction of draw commands
+    ComputePipeline _instances_culling_pipeline;
+    ComputePipeline _draws_culling_pipeline;
+    // Culling of meshlets of visible instances, dispatched by instances culling results
+    ComputePipeline _meshlets_culling_pipeline;
+
+    // Max depth mip chain for occlusion culling, all levels are stored in one buffer
+    struct DepthPyramidLevel {
+      uint32_t offset; // in floats
+      uint32_t width;
+      uint32_t height;
+    };
+    ComputePipeline _depth_pyramid_pipeline;
+    StorageBuffer _depth_pyramid;
+    uint32_t _depth_pyramid_buffer_id = -1;
+    std::vector<DepthPyramidLevel> _depth_pyramid_levels;
+    bool _occlusion_culling_supported = false;
+
+    // Camera facing quads of far instances, they write geometry buffers from impostor atlases
+    GraphicsPipeline _impostor_pipeline;
+
+    DrawStats _draw_stats;
 
   public:
     RenderContext(RenderContext &&other) noexcept = default;
@@ -104,6 +172,8 @@ inline namespace graphics {
     IndexHeapBuffer & index_buffer() noexcept { return _index_buffer; }
     VertexBuffersArray add_vertex_buffers(std::span<const std::span<const std::byte>> vbufs_data) noexcept;
     void delete_vertex_buffers(std::span<const VertexBufferDescription> vbufs) noexcept;
+    // Changes each time vertex or index buffer is recreated, commands which bind them must be recorded again
+    uint64_t geometry_version() const noexcept { return _vertex_buffers_version + _index_buffer.version(); }
 
     // ===== Resources creation =====
     WindowHandle create_window() const noexcept;
@@ -112,6 +182,11 @@ inline namespace graphics {
 
     SceneHandle create_scene() noexcept;
 
+    // Renders mesh by its material pipeline to frames of octahedral impostor,
+    // returns texels of atlas for each geometry buffer
+    std::vector<std::vector<std::byte>> bake_impostor(const Mesh &mesh, const GraphicsPipeline &pipeline,
+                                                      uint32_t material_ubo_id, const Impostor::Sphere &sphere);
+
     // ===== Bindless rendering =====
     DescriptorSetLayoutHandle bindless_set_layout() const noexcept { return _bindless_set_layout; }
     BindlessDescriptorSet & bindless_set() noexcept { return _bindless_set; }
@@ -119,12 +194,41 @@ inline namespace graphics {
 
     const DescriptorAllocator & desciptor_allocator() const noexcept { return _default_descriptor_allocator; }
 
+    Defragmenter & defragmenter() noexcept { return _defragmenter; }
+    const Defragmenter & defragmenter() const noexcept { return _defragmenter; }
+
+    const DrawStats & draw_stats() const noexcept { return _draw_stats; }
+
+    // Disabled reuse records all passes each frame
+    void commands_reuse(bool enable) noexcept { _commands_reuse = enable; }
+    bool commands_reuse() const noexcept { return _commands_reuse; }
+    const RecordStats & record_stats() const noexcept { return _record_stats; }
+
   private:
     void init_lights_render_data();
     void init_bindless_rendering();
+    void init_culling();
+    void init_impostors();
+
+    // Must be equal to PHASE_* in instances culling shader
+    enum struct CullingPhase : uint32_t {
+      Frustum = 0, // frustum culling only
+      Early = 1,   // instances visible in previous frame
+      Late = 2,    // occlusion test of all instances by depth pyramid
+    };
 
+    // Records culling dispatches, must be called outside of rendering
+    void cull_models(const SceneHandle scene, CullingPhase phase);
+    // Copies depth buffer to depth pyramid and builds its levels
+    void build_depth_pyramid();
     void render_models(const SceneHandle scene);
-    void render_lights(const SceneHandle scene, Presenter &presenter);
+    // Draws culled commands, 'clear' is false for second pass of occlusion culling
+    void draw_models(const SceneHandle scene, bool clear);
+    void render_lights(const SceneHandle scene, CommandUnit &command_unit,
+                       const vk::RenderingAttachmentInfoKHR &target_info, Extent target_extent);
+    // Record of lights pass for target, commands of record are outdated if 'recorded' is false
+    LightsRecord & lights_record(const SceneHandle scene, const Presenter &presenter,
+                                 vk::ImageView target, bool &recorded) noexcept;
 
     void update_camera_buffer(UniformBuffer &uniform_buffer);
   };
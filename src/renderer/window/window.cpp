@@ -22,6 +22,7 @@ void mr::Window::update_swapchain() noexcept
     _extent.height = h;
 
     _swapchain = mr::Swapchain(_parent->vulkan_state(), _surface.get(), _extent);
+    _targets_version++;
   }
 }
 
@@ -143,6 +144,8 @@ void mr::Window::update_state() noexcept
 
   if (_input_state.key_tapped(vkfw::Key::eEscape)) {
     _window->setShouldClose(true);
+    // Main thread can wait for events
+    vkfw::postEmptyEvent();
   }
 
   if (_input_state.key_tapped(vkfw::Key::eF11)) {
@@ -0,0 +1,378 @@
+#include "scene/bvh.hpp"
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+
+using Box = mr::Bvh::Box;
+
+// Items are partitioned together with their boxes, so build reads memory sequentially
+struct mr::Bvh::BuildItem {
+  Box box;
+  std::array<float, 3> centroid;
+  uint32_t item;
+};
+
+static Box empty_box() noexcept
+{
+  return {
+    .min = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()},
+    .max = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()},
+  };
+}
+
+static void grow(Box &box, const Box &other) noexcept
+{
+  for (int i = 0; i < 3; i++) {
+    box.min[i] = std::min(box.min[i], other.min[i]);
+    box.max[i] = std::max(box.max[i], other.max[i]);
+  }
+}
+
+static float half_area(const Box &box) noexcept
+{
+  float x = box.max[0] - box.min[0];
+  float y = box.max[1] - box.min[1];
+  float z = box.max[2] - box.min[2];
+  return x < 0 ? 0 : x * y + y * z + z * x;
+}
+
+void mr::Bvh::build(std::span<const Box> boxes) noexcept
+{
+  auto start = std::chrono::steady_clock::now();
+
+  uint32_t items_number = static_cast<uint32_t>(boxes.size());
+  _boxes.assign(boxes.begin(), boxes.end());
+  _items.resize(items_number);
+  _dirty_leaves.clear();
+
+  _nodes.clear();
+  if (items_number > 0) {
+    std::vector<BuildItem> build_items(items_number);
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, items_number), [&](const tbb::blocked_range<uint32_t> &range) {
+      for (uint32_t i = range.begin(); i < range.end(); i++) {
+        build_items[i].box = boxes[i];
+        for (int axis = 0; axis < 3; axis++) {
+          build_items[i].centroid[axis] = (boxes[i].min[axis] + boxes[i].max[axis]) * 0.5f;
+        }
+        build_items[i].item = i;
+      }
+    });
+
+    // Binary tree with at least one item in leaf has less than 2 * n nodes
+    _nodes.resize(2 * items_number - 1);
+    std::atomic_uint32_t nodes_number = 1;
+    build_node(0, 0, 0, build_items, nodes_number);
+    _nodes.resize(nodes_number);
+    for (uint32_t i = 0; i < items_number; i++) {
+      _items[i] = build_items[i].item;
+    }
+  }
+
+  _parents.assign(_nodes.size(), 0);
+  _item_leaves.resize(items_number);
+  for (uint32_t node = 0; node < _nodes.size(); node++) {
+    if (_nodes[node].is_leaf()) {
+      for (uint32_t i = 0; i < _nodes[node].items_number; i++) {
+        _item_leaves[_items[_nodes[node].first_item + i]] = node;
+      }
+    } else {
+      _parents[_nodes[node].left_child] = node;
+      _parents[_nodes[node].left_child + 1] = node;
+    }
+  }
+
+  _stats.items_number = items_number;
+  _stats.nodes_number = static_cast<uint32_t>(_nodes.size());
+  _stats.build_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void mr::Bvh::build_node(uint32_t node, uint32_t first, uint32_t depth, std::span<BuildItem> items,
+                         std::atomic_uint32_t &nodes_number) noexcept
+{
+  uint32_t count = static_cast<uint32_t>(items.size());
+  Box box = empty_box();
+  Box centroids_box = empty_box();
+  for (const auto &item : items) {
+    grow(box, item.box);
+    grow(centroids_box, {item.centroid, item.centroid});
+  }
+  _nodes[node] = {.box = box, .first_item = first, .items_number = count, .left_child = 0};
+  if (count <= max_leaf_size) {
+    return;
+  }
+
+  // Binned SAH over all axes, split is after bin 'split_bin'
+  uint32_t split_axis = 0;
+  uint32_t split_bin = 0;
+  float split_cost = std::numeric_limits<float>::max();
+  if (depth < max_sah_depth) {
+    // All axes are binned in one pass over items
+    std::array<float, 3> scales;
+    for (int axis = 0; axis < 3; axis++) {
+      float extent = centroids_box.max[axis] - centroids_box.min[axis];
+      scales[axis] = extent > 0 ? bins_number / extent : 0;
+    }
+    std::array<std::array<Box, bins_number>, 3> bin_boxes;
+    std::array<std::array<uint32_t, bins_number>, 3> bin_counts {};
+    for (auto &axis_boxes : bin_boxes) {
+      axis_boxes.fill(empty_box());
+    }
+    for (const auto &item : items) {
+      for (int axis = 0; axis < 3; axis++) {
+        uint32_t bin = std::min(bins_number - 1,
+                                static_cast<uint32_t>((item.centroid[axis] - centroids_box.min[axis]) * scales[axis]));
+        grow(bin_boxes[axis][bin], item.box);
+        bin_counts[axis][bin]++;
+      }
+    }
+
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      if (scales[axis] == 0) {
+        continue;
+      }
+
+      // Right side costs are accumulated from the end, then left side is swept from the beginning
+      std::array<float, bins_number> right_costs {};
+      Box right_box = empty_box();
+      uint32_t right_count = 0;
+      for (uint32_t bin = bins_number - 1; bin > 0; bin--) {
+        grow(right_box, bin_boxes[axis][bin]);
+        right_count += bin_counts[axis][bin];
+        right_costs[bin - 1] = half_area(right_box) * right_count;
+      }
+      Box left_box = empty_box();
+      uint32_t left_count = 0;
+      for (uint32_t bin = 0; bin < bins_number - 1; bin++) {
+        grow(left_box, bin_boxes[axis][bin]);
+        left_count += bin_counts[axis][bin];
+        if (left_count == 0 || left_count == count) {
+          continue;
+        }
+        float cost = half_area(left_box) * left_count + right_costs[bin];
+        if (cost < split_cost) {
+          split_cost = cost;
+          split_axis = axis;
+          split_bin = bin;
+        }
+      }
+    }
+  }
+
+  uint32_t left_count;
+  if (split_cost < std::numeric_limits<float>::max()) {
+    float scale = bins_number / (centroids_box.max[split_axis] - centroids_box.min[split_axis]);
+    auto middle = std::partition(items.begin(), items.end(), [&](const BuildItem &item) {
+      uint32_t bin = std::min(bins_number - 1,
+        static_cast<uint32_t>((item.centroid[split_axis] - centroids_box.min[split_axis]) * scale));
+      return bin <= split_bin;
+    });
+    left_count = static_cast<uint32_t>(middle - items.begin());
+  } else {
+    // All centroids are in one point or tree is too deep: median split along the longest axis
+    uint32_t axis = 0;
+    for (uint32_t i = 1; i < 3; i++) {
+      if (centroids_box.max[i] - centroids_box.min[i] > centroids_box.max[axis] - centroids_box.min[axis]) {
+        axis = i;
+      }
+    }
+    left_count = count / 2;
+    std::ranges::nth_element(items, items.begin() + left_count, {},
+                             [axis](const BuildItem &item) { return item.centroid[axis]; });
+  }
+
+  uint32_t left_child = nodes_number.fetch_add(2);
+  _nodes[node].left_child = left_child;
+
+  auto build_left = [&] { build_node(left_child, first, depth + 1, items.first(left_count), nodes_number); };
+  auto build_right = [&] {
+    build_node(left_child + 1, first + left_count, depth + 1, items.subspan(left_count), nodes_number);
+  };
+  if (count > parallel_build_size) {
+    tbb::parallel_invoke(build_left, build_right);
+  } else {
+    build_left();
+    build_right();
+  }
+}
+
+void mr::Bvh::update(uint32_t item, const Box &box) noexcept
+{
+  ASSERT(item < _boxes.size());
+  _boxes[item] = box;
+  _dirty_leaves.push_back(_item_leaves[item]);
+}
+
+bool mr::Bvh::refit_node(uint32_t node) noexcept
+{
+  auto &data = _nodes[node];
+  Box box = empty_box();
+  if (data.is_leaf()) {
+    for (uint32_t i = 0; i < data.items_number; i++) {
+      grow(box, _boxes[_items[data.first_item + i]]);
+    }
+  } else {
+    grow(box, _nodes[data.left_child].box);
+    grow(box, _nodes[data.left_child + 1].box);
+  }
+  if (box.min == data.box.min && box.max == data.box.max) {
+    return false;
+  }
+  data.box = box;
+  return true;
+}
+
+void mr::Bvh::refit() noexcept
+{
+  if (_dirty_leaves.empty()) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+
+  _stats.refitted_nodes_number = 0;
+  // When big part of tree is moved all nodes are refitted in bottom up order
+  if (_dirty_leaves.size() > _nodes.size() / 8) {
+    for (uint32_t node = static_cast<uint32_t>(_nodes.size()); node-- > 0;) {
+      refit_node(node);
+    }
+    _stats.refitted_nodes_number = static_cast<uint32_t>(_nodes.size());
+  } else {
+    // Ancestors are refitted until box stops changing, other dirty leaves refit what is above
+    for (auto leaf : _dirty_leaves) {
+      uint32_t node = leaf;
+      while (refit_node(node)) {
+        _stats.refitted_nodes_number++;
+        if (node == 0) {
+          break;
+        }
+        node = _parents[node];
+      }
+    }
+  }
+  _dirty_leaves.clear();
+
+  _stats.refit_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+mr::Bvh::Overlap mr::Bvh::test_frustum(const Box &box, const std::array<std::array<float, 4>, 6> &planes) noexcept
+{
+  Overlap overlap = Overlap::inside;
+  for (const auto &plane : planes) {
+    // Signed distances of box corners which are the most far and the most near along plane normal
+    float center_distance = plane[3];
+    float projected_extent = 0;
+    for (int i = 0; i < 3; i++) {
+      center_distance += plane[i] * (box.min[i] + box.max[i]) * 0.5f;
+      projected_extent += std::abs(plane[i]) * (box.max[i] - box.min[i]) * 0.5f;
+    }
+    if (center_distance + projected_extent < 0) {
+      return Overlap::outside;
+    }
+    if (center_distance - projected_extent < 0) {
+      overlap = Overlap::intersects;
+    }
+  }
+  return overlap;
+}
+
+void mr::Bvh::query_frustum(const std::array<std::array<float, 4>, 6> &planes,
+                            std::vector<uint32_t> &result) const noexcept
+{
+  traverse(
+    [&planes](const Box &box) { return test_frustum(box, planes); },
+    [&](uint32_t first, uint32_t count, Overlap overlap) {
+      for (auto item : std::span(_items).subspan(first, count)) {
+        if (overlap == Overlap::inside || test_frustum(_boxes[item], planes) != Overlap::outside) {
+          result.push_back(item);
+        }
+      }
+    });
+}
+
+void mr::Bvh::query_box(const Box &query, std::vector<uint32_t> &result) const noexcept
+{
+  auto test = [&query](const Box &box) {
+    Overlap overlap = Overlap::inside;
+    for (int i = 0; i < 3; i++) {
+      if (box.max[i] < query.min[i] || box.min[i] > query.max[i]) {
+        return Overlap::outside;
+      }
+      if (box.min[i] < query.min[i] || box.max[i] > query.max[i]) {
+        overlap = Overlap::intersects;
+      }
+    }
+    return overlap;
+  };
+  traverse(test, [&](uint32_t first, uint32_t count, Overlap overlap) {
+    for (auto item : std::span(_items).subspan(first, count)) {
+      if (overlap == Overlap::inside || test(_boxes[item]) != Overlap::outside) {
+        result.push_back(item);
+      }
+    }
+  });
+}
+
+void mr::Bvh::query_sphere(const std::array<float, 3> &center, float radius,
+                           std::vector<uint32_t> &result) const noexcept
+{
+  // Box is inside if its farthest corner is inside, outside if its nearest point is outside
+  auto test = [&center, radius](const Box &box) {
+    float near_distance2 = 0;
+    float far_distance2 = 0;
+    for (int i = 0; i < 3; i++) {
+      float near = std::clamp(center[i], box.min[i], box.max[i]) - center[i];
+      float far = std::max(std::abs(box.min[i] - center[i]), std::abs(box.max[i] - center[i]));
+      near_distance2 += near * near;
+      far_distance2 += far * far;
+    }
+    if (near_distance2 > radius * radius) {
+      return Overlap::outside;
+    }
+    return far_distance2 <= radius * radius ? Overlap::inside : Overlap::intersects;
+  };
+  traverse(test, [&](uint32_t first, uint32_t count, Overlap overlap) {
+    for (auto item : std::span(_items).subspan(first, count)) {
+      if (overlap == Overlap::inside || test(_boxes[item]) != Overlap::outside) {
+        result.push_back(item);
+      }
+    }
+  });
+}
+
+std::optional<mr::Bvh::RayHit> mr::Bvh::query_ray(const std::array<float, 3> &origin,
+                                                  const std::array<float, 3> &direction,
+                                                  float max_distance) const noexcept
+{
+  std::array<float, 3> inverse_direction;
+  for (int i = 0; i < 3; i++) {
+    inverse_direction[i] = 1.f / direction[i];
+  }
+
+  // Slab test, returns distance to box or infinity if it is missed
+  auto intersect = [&](const Box &box) {
+    float near = 0;
+    float far = max_distance;
+    for (int i = 0; i < 3; i++) {
+      float t0 = (box.min[i] - origin[i]) * inverse_direction[i];
+      float t1 = (box.max[i] - origin[i]) * inverse_direction[i];
+      near = std::max(near, std::min(t0, t1));
+      far = std::min(far, std::max(t0, t1));
+    }
+    return near <= far ? near : std::numeric_limits<float>::infinity();
+  };
+
+  std::optional<RayHit> hit;
+  traverse(
+    [&](const Box &box) {
+      float distance = intersect(box);
+      return distance < (hit ? hit->distance : max_distance) ? Overlap::intersects : Overlap::outside;
+    },
+    [&](uint32_t first, uint32_t count, Overlap) {
+      for (auto item : std::span(_items).subspan(first, count)) {
+        float distance = intersect(_boxes[item]);
+        if (distance <= max_distance && (not hit || distance < hit->distance)) {
+          hit = RayHit {item, distance};
+        }
+      }
+    });
+  return hit;
+}
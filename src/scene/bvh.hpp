@@ -0,0 +1,135 @@
+#ifndef __MR_BVH_HPP_
+#define __MR_BVH_HPP_
+
+#include "pch.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Bounding volume hierarchy over boxes of items (scene instances).
+  // Built top down with binned SAH, subtrees are built by different TBB workers.
+  // Moved items are refitted incrementally: boxes of their ancestors are recomputed up to the first one
+  // which doesn't change. Refit doesn't change tree topology, so it should be rebuilt if items moved far.
+  // Children of node are stored after it, so reverse order of nodes is valid bottom up order.
+  class Bvh {
+  public:
+    static inline constexpr uint32_t max_leaf_size = 4;
+    static inline constexpr uint32_t bins_number = 16;
+    // Subtrees with more items are built in parallel
+    static inline constexpr uint32_t parallel_build_size = 4096;
+    // Deeper nodes are split by median, so traversal stack is bounded
+    static inline constexpr uint32_t max_sah_depth = 32;
+
+    struct Box {
+      std::array<float, 3> min {};
+      std::array<float, 3> max {};
+    };
+
+    // Result of node test in queries
+    enum class Overlap {
+      outside,
+      intersects,
+      inside, // all items of node pass the test, they are not tested separately
+    };
+
+    struct RayHit {
+      uint32_t item;
+      float distance; // to item box along ray direction
+    };
+
+    // Items of subtree are contiguous range of items
+    struct Node {
+      Box box;
+      uint32_t first_item;
+      uint32_t items_number;
+      uint32_t left_child; // 0 for leaf, right child is next to it
+
+      bool is_leaf() const noexcept { return left_child == 0; }
+    };
+
+    struct Stats {
+      uint32_t items_number = 0;
+      uint32_t nodes_number = 0;
+      uint32_t refitted_nodes_number = 0;
+      float build_ms = 0;
+      float refit_ms = 0;
+    };
+
+  private:
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _parents;
+    std::vector<uint32_t> _items;        // item indices, leaves reference ranges of it
+    std::vector<uint32_t> _item_leaves;  // leaf node of each item
+    std::vector<Box> _boxes;             // box of each item
+
+    std::vector<uint32_t> _dirty_leaves; // leaves of updated items, refitted by 'refit'
+
+    Stats _stats;
+
+  public:
+    Bvh() = default;
+
+    Bvh(Bvh &&) noexcept = default;
+    Bvh & operator=(Bvh &&) noexcept = default;
+
+    void build(std::span<const Box> boxes) noexcept;
+
+    // Changes box of item, tree is valid after 'refit'
+    void update(uint32_t item, const Box &box) noexcept;
+    void refit() noexcept;
+
+    // Calls 'visit(first, count, overlap)' for ranges of items of nodes which are not outside,
+    // items of ranges are 'items().subspan(first, count)'
+    template <typename NodeTest, typename RangeVisit>
+    void traverse(const NodeTest &test, const RangeVisit &visit) const noexcept
+    {
+      if (_nodes.empty()) {
+        return;
+      }
+
+      std::array<uint32_t, 64> stack;
+      uint32_t stack_size = 0;
+      stack[stack_size++] = 0;
+      while (stack_size > 0) {
+        const auto &node = _nodes[stack[--stack_size]];
+        Overlap overlap = test(node.box);
+        if (overlap == Overlap::outside) {
+          continue;
+        }
+        if (node.is_leaf() || overlap == Overlap::inside) {
+          visit(node.first_item, node.items_number, overlap);
+          continue;
+        }
+        ASSERT(stack_size + 2 <= stack.size(), "BVH is too deep");
+        stack[stack_size++] = node.left_child + 1;
+        stack[stack_size++] = node.left_child;
+      }
+    }
+
+    // Items which boxes are not outside of query, they are appended to 'result'
+    void query_frustum(const std::array<std::array<float, 4>, 6> &planes, std::vector<uint32_t> &result) const noexcept;
+    void query_box(const Box &box, std::vector<uint32_t> &result) const noexcept;
+    void query_sphere(const std::array<float, 3> &center, float radius, std::vector<uint32_t> &result) const noexcept;
+    // Nearest item which box is hit by ray, 'direction' must be normalized
+    std::optional<RayHit> query_ray(const std::array<float, 3> &origin, const std::array<float, 3> &direction,
+                                    float max_distance = std::numeric_limits<float>::max()) const noexcept;
+
+    static Overlap test_frustum(const Box &box, const std::array<std::array<float, 4>, 6> &planes) noexcept;
+
+    bool empty() const noexcept { return _nodes.empty(); }
+    std::span<const Node> nodes() const noexcept { return _nodes; }
+    std::span<const uint32_t> items() const noexcept { return _items; }
+    const Box & item_box(uint32_t item) const noexcept { return _boxes[item]; }
+
+    const Stats & stats() const noexcept { return _stats; }
+
+  private:
+    struct BuildItem;
+    // 'first' is index of first of 'items' in all items
+    void build_node(uint32_t node, uint32_t first, uint32_t depth, std::span<BuildItem> items,
+                    std::atomic_uint32_t &nodes_number) noexcept;
+    bool refit_node(uint32_t node) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_BVH_HPP_
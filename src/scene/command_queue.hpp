@@ -0,0 +1,83 @@
+#ifndef __MR_COMMAND_QUEUE_HPP_
+#define __MR_COMMAND_QUEUE_HPP_
+
+#include "pch.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Lock-free multiple producers single consumer queue.
+  // Producers push nodes to intrusive stack by CAS on its head, consumer takes the whole stack
+  // by one exchange and reverses it, so commands are consumed in order of pushes.
+  // Nodes are never popped one by one, so there is no ABA problem unlike in Treiber stack with pops
+  template <typename T>
+  class CommandQueue {
+  private:
+    struct Node {
+      T command;
+      Node *next = nullptr;
+    };
+
+    std::atomic<Node *> _head = nullptr;
+
+  public:
+    CommandQueue() = default;
+
+    // Moves are not thread safe, queue must not be used by other threads during them
+    CommandQueue(CommandQueue &&other) noexcept : _head(other._head.exchange(nullptr)) {}
+    CommandQueue & operator=(CommandQueue &&other) noexcept
+    {
+      if (this != &other) {
+        clear();
+        _head = other._head.exchange(nullptr);
+      }
+      return *this;
+    }
+
+    ~CommandQueue() { clear(); }
+
+    // Can be called by any thread
+    void push(T command) noexcept
+    {
+      auto *node = new Node {std::move(command)};
+      node->next = _head.load(std::memory_order_relaxed);
+      while (not _head.compare_exchange_weak(node->next, node,
+                                             std::memory_order_release, std::memory_order_relaxed)) {
+      }
+    }
+
+    bool empty() const noexcept { return _head.load(std::memory_order_relaxed) == nullptr; }
+
+    // Calls 'consumer' for each pushed command in order of pushes, returns number of commands.
+    // Must be called by one thread at a time
+    template <std::invocable<T &&> F>
+    uint32_t consume(F &&consumer) noexcept
+    {
+      Node *reversed = _head.exchange(nullptr, std::memory_order_acquire);
+      Node *node = nullptr;
+      while (reversed != nullptr) {
+        Node *next = reversed->next;
+        reversed->next = node;
+        node = reversed;
+        reversed = next;
+      }
+
+      uint32_t number = 0;
+      while (node != nullptr) {
+        Node *next = node->next;
+        consumer(std::move(node->command));
+        delete node;
+        node = next;
+        number++;
+      }
+      return number;
+    }
+
+    void clear() noexcept
+    {
+      consume([](T &&) {});
+    }
+  };
+}
+} // namespace mr
+
+#endif // __MR_COMMAND_QUEUE_HPP_
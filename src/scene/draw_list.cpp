@@ -0,0 +1,98 @@
+#include "scene/draw_list.hpp"
+
+#include <tbb/parallel_for.h>
+
+void mr::DrawList::sort() noexcept
+{
+  uint32_t size = this->size();
+  if (size < 2) {
+    return;
+  }
+
+  // Each block is counted and scattered by one task, blocks keep their order, so each pass is stable
+  uint32_t blocks_number = 1;
+  if (size >= parallel_size) {
+    blocks_number = std::min<uint32_t>(size / (parallel_size / 4),
+                                       4 * static_cast<uint32_t>(tbb::this_task_arena::max_concurrency()));
+  }
+  uint32_t block_size = (size + blocks_number - 1) / blocks_number;
+  auto for_blocks = [&](auto &&function) {
+    if (blocks_number == 1) {
+      function(0u);
+    } else {
+      tbb::parallel_for(0u, blocks_number, function);
+    }
+  };
+  auto digit_value = [](uint64_t key, uint32_t digit) {
+    return static_cast<uint32_t>(key >> (digit * digit_bits)) & (digit_values_number - 1);
+  };
+
+  using Histogram = std::array<uint32_t, digit_values_number>;
+
+  // Histograms of all digits don't depend on order, they are counted once to find digits to skip
+  std::vector<std::array<Histogram, digits_number>> digit_histograms(blocks_number);
+  for_blocks([&](uint32_t block) {
+    auto &histograms = digit_histograms[block];
+    for (auto &histogram : histograms) {
+      histogram.fill(0);
+    }
+    uint32_t last = std::min(size, (block + 1) * block_size);
+    for (uint32_t i = block * block_size; i < last; i++) {
+      for (uint32_t digit = 0; digit < digits_number; digit++) {
+        histograms[digit][digit_value(_keys[i], digit)]++;
+      }
+    }
+  });
+
+  _keys_tmp.resize(size);
+  _draws_tmp.resize(size);
+  std::vector<Histogram> offsets(blocks_number);
+  for (uint32_t digit = 0; digit < digits_number; digit++) {
+    // Digit with one value in all keys doesn't change order
+    uint32_t first_value = digit_value(_keys[0], digit);
+    uint32_t first_value_count = 0;
+    for (const auto &histograms : digit_histograms) {
+      first_value_count += histograms[digit][first_value];
+    }
+    if (first_value_count == size) {
+      continue;
+    }
+
+    // Counts of blocks are changed by previous passes
+    if (blocks_number > 1) {
+      for_blocks([&](uint32_t block) {
+        auto &histogram = offsets[block];
+        histogram.fill(0);
+        uint32_t last = std::min(size, (block + 1) * block_size);
+        for (uint32_t i = block * block_size; i < last; i++) {
+          histogram[digit_value(_keys[i], digit)]++;
+        }
+      });
+    } else {
+      offsets[0] = digit_histograms[0][digit];
+    }
+
+    // Draws with the same digit value are placed in order of blocks
+    uint32_t offset = 0;
+    for (uint32_t value = 0; value < digit_values_number; value++) {
+      for (auto &block_offsets : offsets) {
+        uint32_t count = block_offsets[value];
+        block_offsets[value] = offset;
+        offset += count;
+      }
+    }
+
+    for_blocks([&](uint32_t block) {
+      auto &block_offsets = offsets[block];
+      uint32_t last = std::min(size, (block + 1) * block_size);
+      for (uint32_t i = block * block_size; i < last; i++) {
+        uint32_t target = block_offsets[digit_value(_keys[i], digit)]++;
+        _keys_tmp[target] = _keys[i];
+        _draws_tmp[target] = _draws[i];
+      }
+    });
+
+    std::swap(_keys, _keys_tmp);
+    std::swap(_draws, _draws_tmp);
+  }
+}
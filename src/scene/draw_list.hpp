@@ -0,0 +1,79 @@
+#ifndef __MR_DRAW_LIST_HPP_
+#define __MR_DRAW_LIST_HPP_
+
+#include "pch.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Order of culled draws which minimizes state changes: 64 bit sort key of draw is
+  // draws group (pipeline) in high bits, then material, then front-to-back depth bucket.
+  // Keys are sorted together with draws by LSD radix sort with 8 bit digits, histograms and scatter
+  // of big lists are split between TBB workers, digits which are equal in all keys are skipped
+  class DrawList {
+  public:
+    static inline constexpr uint32_t group_bits = 12;
+    static inline constexpr uint32_t material_bits = 24;
+    static inline constexpr uint32_t depth_bits = 64 - group_bits - material_bits;
+    static_assert(depth_bits <= 31);
+
+    static inline constexpr uint32_t digit_bits = 8;
+    static inline constexpr uint32_t digits_number = 64 / digit_bits;
+    static inline constexpr uint32_t digit_values_number = 1 << digit_bits;
+    // Lists with less draws are sorted by one thread
+    static inline constexpr uint32_t parallel_size = 1 << 14;
+
+    // Culled command of draws group
+    struct Draw {
+      uint32_t group;
+      uint32_t command;
+    };
+
+  private:
+    std::vector<uint64_t> _keys;
+    std::vector<Draw> _draws;
+    // Scatter targets, swapped with sorted arrays after each pass
+    std::vector<uint64_t> _keys_tmp;
+    std::vector<Draw> _draws_tmp;
+
+  public:
+    DrawList() = default;
+
+    DrawList(DrawList &&) noexcept = default;
+    DrawList & operator=(DrawList &&) noexcept = default;
+
+    // Depth is distance along view direction, bucket is high bits of its float representation,
+    // which is ordered as depth for non-negative values
+    static uint64_t key(uint32_t group, uint32_t material, float depth) noexcept
+    {
+      ASSERT(group < (1u << group_bits), "Too many draws groups", group);
+      ASSERT(material < (1u << material_bits), "Material id doesn't fit to sort key", material);
+      uint32_t depth_bucket = std::bit_cast<uint32_t>(std::max(depth, 0.f)) >> (31 - depth_bits);
+      return (uint64_t(group) << (64 - group_bits)) | (uint64_t(material) << depth_bits) | depth_bucket;
+    }
+
+    static uint32_t group(uint64_t key) noexcept { return static_cast<uint32_t>(key >> (64 - group_bits)); }
+
+    void clear() noexcept
+    {
+      _keys.clear();
+      _draws.clear();
+    }
+
+    void add(uint64_t key, Draw draw) noexcept
+    {
+      ASSERT(group(key) == draw.group);
+      _keys.push_back(key);
+      _draws.push_back(draw);
+    }
+
+    void sort() noexcept;
+
+    uint32_t size() const noexcept { return static_cast<uint32_t>(_draws.size()); }
+    std::span<const uint64_t> keys() const noexcept { return _keys; }
+    // Sorted by keys after 'sort'
+    std::span<const Draw> draws() const noexcept { return _draws; }
+  };
+}
+} // namespace mr
+
+#endif // __MR_DRAW_LIST_HPP_
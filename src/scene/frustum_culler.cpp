@@ -0,0 +1,303 @@
+#include "scene/frustum_culler.hpp"
+
+// Matrices are read as raw floats in the same way as shaders do
+static std::array<float, 16> to_floats(const mr::Matr4f &matrix) noexcept
+{
+  static_assert(sizeof(mr::Matr4f) == 16 * sizeof(float));
+  std::array<float, 16> data;
+  std::memcpy(data.data(), &matrix, sizeof(data));
+  return data;
+}
+
+mr::FrustumCuller::BoundBox mr::FrustumCuller::BoundBox::from_positions(std::span<const std::byte> positions,
+                                                                        size_t stride) noexcept
+{
+  ASSERT(stride >= 3 * sizeof(float));
+  if (positions.size() < stride) {
+    return {};
+  }
+
+  BoundBox bounds {
+    .min = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()},
+    .max = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()},
+  };
+  for (size_t offset = 0; offset + stride <= positions.size(); offset += stride) {
+    std::array<float, 3> position;
+    std::memcpy(position.data(), positions.data() + offset, sizeof(position));
+    for (int i = 0; i < 3; i++) {
+      bounds.min[i] = std::min(bounds.min[i], position[i]);
+      bounds.max[i] = std::max(bounds.max[i], position[i]);
+    }
+  }
+  return bounds;
+}
+
+void mr::FrustumCuller::set_instance(uint32_t instance, const BoundBox &bounds, const Matr4f &transform) noexcept
+{
+  std::array<float, 3> center, extent;
+  for (int i = 0; i < 3; i++) {
+    center[i] = (bounds.min[i] + bounds.max[i]) * 0.5f;
+    extent[i] = (bounds.max[i] - bounds.min[i]) * 0.5f;
+  }
+
+  // Shaders apply transform as 'transpose(matrix) * position', so row i of raw data gives coordinate i
+  auto t = to_floats(transform);
+  std::array<float, 3> world_center, world_extent;
+  for (int i = 0; i < 3; i++) {
+    world_center[i] = t[4 * i + 0] * center[0] + t[4 * i + 1] * center[1] + t[4 * i + 2] * center[2] + t[4 * i + 3];
+    world_extent[i] = std::abs(t[4 * i + 0]) * extent[0] + std::abs(t[4 * i + 1]) * extent[1] +
+                      std::abs(t[4 * i + 2]) * extent[2];
+  }
+
+  _center_x[instance] = world_center[0];
+  _center_y[instance] = world_center[1];
+  _center_z[instance] = world_center[2];
+  _extent_x[instance] = world_extent[0];
+  _extent_y[instance] = world_extent[1];
+  _extent_z[instance] = world_extent[2];
+  _radius[instance] = std::hypot(world_extent[0], world_extent[1], world_extent[2]);
+}
+
+uint32_t mr::FrustumCuller::add_mesh(const BoundBox &bounds, uint32_t instance_offset,
+                                     std::span<const Matr4f> transforms) noexcept
+{
+  ASSERT(instance_offset == _instances_number, "Instances must be added in order of their transforms");
+
+  _meshes.emplace_back(MeshInstances {instance_offset, static_cast<uint32_t>(transforms.size()), bounds});
+  _visible_counts.emplace_back(static_cast<uint32_t>(transforms.size()));
+  _instances_number += transforms.size();
+
+  // Arrays are padded to whole SIMD blocks, padding instances are never read back
+  size_t padded_size = (_instances_number + simd_width - 1) / simd_width * simd_width;
+  for (auto *array : {&_center_x, &_center_y, &_center_z, &_extent_x, &_extent_y, &_extent_z, &_radius}) {
+    array->resize(padded_size);
+  }
+  _visibility.resize(padded_size / simd_width);
+  _visible_instances.resize(_instances_number);
+
+  for (uint32_t i = 0; i < transforms.size(); i++) {
+    set_instance(instance_offset + i, bounds, transforms[i]);
+  }
+  _bvh_outdated = true;
+
+  return _meshes.size() - 1;
+}
+
+void mr::FrustumCuller::remove_meshes(uint32_t first_mesh, uint32_t meshes_number) noexcept
+{
+  ASSERT(first_mesh + meshes_number <= _meshes.size());
+  if (meshes_number == 0) {
+    return;
+  }
+
+  uint32_t first_instance = _meshes[first_mesh].offset;
+  const auto &last = _meshes[first_mesh + meshes_number - 1];
+  uint32_t instances_number = last.offset + last.count - first_instance;
+
+  _meshes.erase(_meshes.begin() + first_mesh, _meshes.begin() + first_mesh + meshes_number);
+  _visible_counts.erase(_visible_counts.begin() + first_mesh, _visible_counts.begin() + first_mesh + meshes_number);
+  for (auto &mesh : std::span(_meshes).subspan(first_mesh)) {
+    mesh.offset -= instances_number;
+  }
+
+  _instances_number -= instances_number;
+  size_t padded_size = (_instances_number + simd_width - 1) / simd_width * simd_width;
+  for (auto *array : {&_center_x, &_center_y, &_center_z, &_extent_x, &_extent_y, &_extent_z, &_radius}) {
+    array->erase(array->begin() + first_instance, array->begin() + first_instance + instances_number);
+    array->resize(padded_size);
+  }
+  _visibility.resize(padded_size / simd_width);
+  _visible_instances.resize(_instances_number);
+  // Visible instances are valid only after next 'cull'
+  std::ranges::fill(_visible_counts, 0);
+  _bvh_outdated = true;
+
+  update_stats();
+}
+
+void mr::FrustumCuller::update_instance(uint32_t instance, const Matr4f &transform) noexcept
+{
+  ASSERT(instance < _instances_number);
+
+  // Meshes are sorted by instance offset
+  auto mesh = std::ranges::upper_bound(_meshes, instance, {}, &MeshInstances::offset) - 1;
+  set_instance(instance, mesh->bounds, transform);
+  if (not _bvh_outdated) {
+    _bvh.update(instance, instance_box(instance));
+  }
+}
+
+void mr::FrustumCuller::update_bvh() noexcept
+{
+  if (_bvh_outdated) {
+    std::vector<Bvh::Box> boxes(_instances_number);
+    for (uint32_t instance = 0; instance < _instances_number; instance++) {
+      boxes[instance] = instance_box(instance);
+    }
+    _bvh.build(boxes);
+    _bvh_outdated = false;
+    MR_INFO("Instances BVH: {} instances, {} nodes, built in {:.2f} ms",
+      _bvh.stats().items_number, _bvh.stats().nodes_number, _bvh.stats().build_ms);
+  } else {
+    _bvh.refit();
+  }
+}
+
+void mr::FrustumCuller::test_blocks(uint32_t first_block, uint32_t last_block,
+                                    const std::array<std::array<float, 4>, 6> &planes,
+                                    const std::array<float, 4> &depth) noexcept
+{
+  if (has_avx2()) {
+    test_blocks_avx2(first_block, last_block, planes, depth);
+    return;
+  }
+
+  for (uint32_t block = first_block; block < last_block; block++) {
+    uint8_t mask = 0;
+    for (uint32_t lane = 0; lane < simd_width; lane++) {
+      uint32_t i = block * simd_width + lane;
+      bool visible = true;
+      for (const auto &plane : planes) {
+        float distance = plane[0] * _center_x[i] + plane[1] * _center_y[i] + plane[2] * _center_z[i] + plane[3];
+        float projected_extent = std::abs(plane[0]) * _extent_x[i] + std::abs(plane[1]) * _extent_y[i] +
+                                 std::abs(plane[2]) * _extent_z[i];
+        visible = visible && distance + projected_extent >= 0;
+      }
+      if (_min_contribution > 0) {
+        float w = depth[0] * _center_x[i] + depth[1] * _center_y[i] + depth[2] * _center_z[i] + depth[3];
+        visible = visible && _radius[i] >= _min_contribution * w;
+      }
+      mask |= static_cast<uint8_t>(visible) << lane;
+    }
+    _visibility[block] = mask;
+  }
+}
+
+MR_AVX2 void mr::FrustumCuller::test_blocks_avx2(uint32_t first_block, uint32_t last_block,
+                                                 const std::array<std::array<float, 4>, 6> &planes,
+                                                 const std::array<float, 4> &depth) noexcept
+{
+#ifdef MR_ENABLE_AVX2
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  const __m256 min_contribution = _mm256_set1_ps(_min_contribution);
+
+  for (uint32_t block = first_block; block < last_block; block++) {
+    uint32_t i = block * simd_width;
+    __m256 cx = _mm256_loadu_ps(&_center_x[i]);
+    __m256 cy = _mm256_loadu_ps(&_center_y[i]);
+    __m256 cz = _mm256_loadu_ps(&_center_z[i]);
+    __m256 ex = _mm256_loadu_ps(&_extent_x[i]);
+    __m256 ey = _mm256_loadu_ps(&_extent_y[i]);
+    __m256 ez = _mm256_loadu_ps(&_extent_z[i]);
+
+    __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (const auto &plane : planes) {
+      __m256 nx = _mm256_set1_ps(plane[0]);
+      __m256 ny = _mm256_set1_ps(plane[1]);
+      __m256 nz = _mm256_set1_ps(plane[2]);
+
+      // Signed distance of the box corner which is the most far along plane normal
+      __m256 distance = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+        _mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(plane[3])));
+      __m256 projected_extent = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_and_ps(nx, abs_mask), ex), _mm256_mul_ps(_mm256_and_ps(ny, abs_mask), ey)),
+        _mm256_mul_ps(_mm256_and_ps(nz, abs_mask), ez));
+      visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distance, projected_extent), zero, _CMP_GE_OQ));
+    }
+
+    if (_min_contribution > 0) {
+      __m256 w = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(depth[0]), cx), _mm256_mul_ps(_mm256_set1_ps(depth[1]), cy)),
+        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(depth[2]), cz), _mm256_set1_ps(depth[3])));
+      __m256 radius = _mm256_loadu_ps(&_radius[i]);
+      visible = _mm256_and_ps(visible, _mm256_cmp_ps(radius, _mm256_mul_ps(min_contribution, w), _CMP_GE_OQ));
+    }
+
+    _visibility[block] = static_cast<uint8_t>(_mm256_movemask_ps(visible));
+  }
+#endif
+}
+
+bool mr::FrustumCuller::is_contributing(uint32_t instance, const std::array<float, 4> &depth) const noexcept
+{
+  float w = depth[0] * _center_x[instance] + depth[1] * _center_y[instance] + depth[2] * _center_z[instance] + depth[3];
+  return _radius[instance] >= _min_contribution * w;
+}
+
+void mr::FrustumCuller::test_bvh(const std::array<std::array<float, 4>, 6> &planes,
+                                 const std::array<float, 4> &depth) noexcept
+{
+  std::ranges::fill(_visibility, 0);
+  auto items = _bvh.items();
+  _bvh.traverse(
+    [&planes](const Bvh::Box &box) { return Bvh::test_frustum(box, planes); },
+    [&](uint32_t first, uint32_t count, Bvh::Overlap overlap) {
+      for (auto instance : items.subspan(first, count)) {
+        bool visible = overlap == Bvh::Overlap::inside ||
+                       Bvh::test_frustum(instance_box(instance), planes) != Bvh::Overlap::outside;
+        if (visible && (_min_contribution <= 0 || is_contributing(instance, depth))) {
+          _visibility[instance / simd_width] |= 1 << (instance % simd_width);
+        }
+      }
+    });
+}
+
+void mr::FrustumCuller::cull(const Matr4f &viewproj) noexcept
+{
+  // Clip coordinate k is dot product of (position, 1) with row k of this matrix
+  auto vp = to_floats(viewproj);
+  auto row = [&vp](int k) { return std::array {vp[k], vp[4 + k], vp[8 + k], vp[12 + k]}; };
+  auto add = [](const std::array<float, 4> &a, const std::array<float, 4> &b, float sign) {
+    return std::array {a[0] + sign * b[0], a[1] + sign * b[1], a[2] + sign * b[2], a[3] + sign * b[3]};
+  };
+
+  // Near plane is -w <= z, it is conservative for both [0, w] and [-w, w] depth ranges
+  auto x = row(0), y = row(1), z = row(2), w = row(3);
+  std::array planes {
+    add(w, x, 1), add(w, x, -1),
+    add(w, y, 1), add(w, y, -1),
+    add(w, z, 1), add(w, z, -1),
+  };
+
+  if (_bvh_culling) {
+    update_bvh();
+    test_bvh(planes, w);
+  } else {
+    constexpr uint32_t blocks_per_task = 256;
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, static_cast<uint32_t>(_visibility.size()), blocks_per_task),
+      [&](const tbb::blocked_range<uint32_t> &range) {
+        test_blocks(range.begin(), range.end(), planes, w);
+      });
+  }
+
+  // Compaction of visible instances of each mesh
+  tbb::parallel_for(tbb::blocked_range<uint32_t>(0, static_cast<uint32_t>(_meshes.size())),
+    [&](const tbb::blocked_range<uint32_t> &range) {
+      for (uint32_t mesh = range.begin(); mesh < range.end(); mesh++) {
+        uint32_t offset = _meshes[mesh].offset;
+        uint32_t count = _meshes[mesh].count;
+        uint32_t visible_count = 0;
+        for (uint32_t instance = offset; instance < offset + count; instance++) {
+          if ((_visibility[instance / simd_width] >> (instance % simd_width)) & 1) {
+            _visible_instances[offset + visible_count++] = instance;
+          }
+        }
+        _visible_counts[mesh] = visible_count;
+      }
+    });
+
+  update_stats();
+}
+
+void mr::FrustumCuller::update_stats() noexcept
+{
+  _stats.instances_number = _instances_number;
+  _stats.visible_instances_number = 0;
+  _stats.visible_meshes_number = 0;
+  for (auto count : _visible_counts) {
+    _stats.visible_instances_number += count;
+    _stats.visible_meshes_number += count > 0;
+  }
+}
@@ -0,0 +1,161 @@
+#ifndef __MR_FRUSTUM_CULLER_HPP_
+#define __MR_FRUSTUM_CULLER_HPP_
+
+#include "pch.hpp"
+
+#include <tbb/parallel_for.h>
+
+#include "scene/bvh.hpp"
+#include "scene/simd.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // CPU culling of mesh instances by camera frustum.
+  // World space bounds of instances are stored as SoA, so 8 boxes are tested per AVX2 iteration,
+  // blocks of instances are distributed between TBB workers.
+  // Instance index is index of its transform in scene, visible instances of mesh are compacted
+  // to the beginning of mesh instances range in 'visible_instances'.
+  // With BVH culling the tree over instance bounds is walked instead: subtrees outside of frustum are skipped
+  // and subtrees inside of it are accepted without testing their instances.
+  class FrustumCuller {
+  public:
+    static inline constexpr uint32_t simd_width = 8;
+
+    struct BoundBox {
+      std::array<float, 3> min {};
+      std::array<float, 3> max {};
+
+      // Positions are read as 3 floats at the beginning of each 'stride' bytes
+      static BoundBox from_positions(std::span<const std::byte> positions, size_t stride) noexcept;
+    };
+
+    struct Stats {
+      uint32_t instances_number = 0;
+      uint32_t visible_instances_number = 0;
+      uint32_t visible_meshes_number = 0;
+    };
+
+  private:
+    struct MeshInstances {
+      uint32_t offset;
+      uint32_t count;
+      BoundBox bounds; // mesh space
+    };
+
+    // World space bounds of instances: center, half size and bounding sphere radius
+    std::vector<float> _center_x, _center_y, _center_z;
+    std::vector<float> _extent_x, _extent_y, _extent_z;
+    std::vector<float> _radius;
+    uint32_t _instances_number = 0;
+
+    std::vector<MeshInstances> _meshes;
+    std::vector<uint32_t> _visible_counts;
+    // Bit per instance, one byte per SIMD block
+    std::vector<uint8_t> _visibility;
+    std::vector<uint32_t> _visible_instances;
+
+    Bvh _bvh;
+    bool _bvh_culling = true;
+    bool _bvh_outdated = true; // instances were added after last build
+
+    // Instances which bounding sphere radius is less than this part of distance to camera are culled.
+    // 0 disables contribution culling
+    float _min_contribution = 0;
+
+    Stats _stats;
+
+  public:
+    FrustumCuller() = default;
+
+    FrustumCuller(FrustumCuller &&) noexcept = default;
+    FrustumCuller & operator=(FrustumCuller &&) noexcept = default;
+
+    // Returns index of mesh. Instances must be added in order of their transforms in scene
+    uint32_t add_mesh(const BoundBox &bounds, uint32_t instance_offset, std::span<const Matr4f> transforms) noexcept;
+
+    // Removes meshes and their instances, instances of next meshes are shifted to keep arrays dense.
+    // Indices of next meshes decrease by 'meshes_number', BVH is rebuilt by next 'cull'
+    void remove_meshes(uint32_t first_mesh, uint32_t meshes_number) noexcept;
+
+    // Changes transform of instance, BVH is refitted by next 'cull'
+    void update_instance(uint32_t instance, const Matr4f &transform) noexcept;
+
+    void cull(const Matr4f &viewproj) noexcept;
+
+    // Removes visible instances for which 'predicate(instance)' is true, keeps them compacted
+    template <std::predicate<uint32_t> Predicate>
+    void remove_instances_if(const Predicate &predicate) noexcept
+    {
+      tbb::parallel_for(tbb::blocked_range<uint32_t>(0, static_cast<uint32_t>(_meshes.size())),
+        [&](const tbb::blocked_range<uint32_t> &range) {
+          for (uint32_t mesh = range.begin(); mesh < range.end(); mesh++) {
+            uint32_t offset = _meshes[mesh].offset;
+            uint32_t visible_count = 0;
+            for (uint32_t i = offset; i < offset + _visible_counts[mesh]; i++) {
+              uint32_t instance = _visible_instances[i];
+              if (not predicate(instance)) {
+                _visible_instances[offset + visible_count++] = instance;
+              }
+            }
+            _visible_counts[mesh] = visible_count;
+          }
+        });
+      update_stats();
+    }
+
+    // World space bound box center and half size of instance
+    std::array<float, 3> instance_center(uint32_t instance) const noexcept
+    {
+      return {_center_x[instance], _center_y[instance], _center_z[instance]};
+    }
+    std::array<float, 3> instance_extent(uint32_t instance) const noexcept
+    {
+      return {_extent_x[instance], _extent_y[instance], _extent_z[instance]};
+    }
+    float instance_radius(uint32_t instance) const noexcept { return _radius[instance]; }
+    Bvh::Box instance_box(uint32_t instance) const noexcept
+    {
+      return {
+        .min = {_center_x[instance] - _extent_x[instance], _center_y[instance] - _extent_y[instance],
+                _center_z[instance] - _extent_z[instance]},
+        .max = {_center_x[instance] + _extent_x[instance], _center_y[instance] + _extent_y[instance],
+                _center_z[instance] + _extent_z[instance]},
+      };
+    }
+
+    // Spatial index over instance bounds for picking and neighbour queries, item is instance index.
+    // Rebuilt or refitted on demand by culling or 'update_bvh'
+    const Bvh & bvh() const noexcept { return _bvh; }
+    void update_bvh() noexcept;
+    void bvh_culling(bool enable) noexcept { _bvh_culling = enable; }
+    bool bvh_culling() const noexcept { return _bvh_culling; }
+
+    uint32_t visible_instances_number(uint32_t mesh) const noexcept { return _visible_counts[mesh]; }
+    std::span<const uint32_t> visible_instances() const noexcept { return _visible_instances; }
+    // Visible instances of mesh, they can be reordered
+    std::span<uint32_t> visible_instances(uint32_t mesh) noexcept
+    {
+      return std::span(_visible_instances).subspan(_meshes[mesh].offset, _visible_counts[mesh]);
+    }
+
+    void min_contribution(float contribution) noexcept { _min_contribution = contribution; }
+    float min_contribution() const noexcept { return _min_contribution; }
+
+    const Stats & stats() const noexcept { return _stats; }
+
+  private:
+    void update_stats() noexcept;
+    void set_instance(uint32_t instance, const BoundBox &bounds, const Matr4f &transform) noexcept;
+    bool is_contributing(uint32_t instance, const std::array<float, 4> &depth) const noexcept;
+    void test_bvh(const std::array<std::array<float, 4>, 6> &planes, const std::array<float, 4> &depth) noexcept;
+    void test_blocks(uint32_t first_block, uint32_t last_block,
+                     const std::array<std::array<float, 4>, 6> &planes,
+                     const std::array<float, 4> &depth) noexcept;
+    MR_AVX2 void test_blocks_avx2(uint32_t first_block, uint32_t last_block,
+                                  const std::array<std::array<float, 4>, 6> &planes,
+                                  const std::array<float, 4> &depth) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_FRUSTUM_CULLER_HPP_
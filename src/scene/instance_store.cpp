@@ -0,0 +1,51 @@
+#include "scene/instance_store.hpp"
+
+uint32_t mr::InstanceStore::allocate_slot(uint32_t index) noexcept
+{
+  if (not _free_slots.empty()) {
+    uint32_t slot = _free_slots.back();
+    _free_slots.pop_back();
+    _indices[slot] = index;
+    return slot;
+  }
+  _indices.push_back(index);
+  _generations.push_back(0);
+  return static_cast<uint32_t>(_indices.size() - 1);
+}
+
+uint32_t mr::InstanceStore::append(uint32_t mesh, std::span<const Matr4f> transforms) noexcept
+{
+  uint32_t first = size();
+  _transforms.insert(_transforms.end(), transforms.begin(), transforms.end());
+  _meshes.resize(_transforms.size(), MeshRef {mesh, first});
+  _slots.reserve(_transforms.size());
+  for (uint32_t index = first; index < _transforms.size(); index++) {
+    _slots.push_back(allocate_slot(index));
+  }
+  return first;
+}
+
+void mr::InstanceStore::erase(uint32_t first, uint32_t count, uint32_t meshes_number) noexcept
+{
+  ASSERT(first + count <= size());
+  if (count == 0) {
+    return;
+  }
+
+  // Generation of slot is changed, so handles of removed instances don't match new ones
+  for (auto slot : std::span(_slots).subspan(first, count)) {
+    _indices[slot] = no_index;
+    _generations[slot]++;
+    _free_slots.push_back(slot);
+  }
+
+  _transforms.erase(_transforms.begin() + first, _transforms.begin() + first + count);
+  _meshes.erase(_meshes.begin() + first, _meshes.begin() + first + count);
+  _slots.erase(_slots.begin() + first, _slots.begin() + first + count);
+
+  for (uint32_t index = first; index < size(); index++) {
+    _indices[_slots[index]] = index;
+    _meshes[index].mesh -= meshes_number;
+    _meshes[index].first_instance -= count;
+  }
+}
@@ -0,0 +1,89 @@
+#ifndef __MR_INSTANCE_STORE_HPP_
+#define __MR_INSTANCE_STORE_HPP_
+
+#include "pch.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Instances of scene meshes as structure of arrays: one dense column for each component,
+  // elements with the same index in all columns belong to the same instance.
+  // Instances of each mesh are contiguous range of columns, so passes over them read contiguous memory
+  // and columns are uploaded to GPU as they are. Other per instance columns (world bounds of FrustumCuller,
+  // LODs of LodSelector, GPU visibility) use the same dense index.
+  // Dense index of instance changes when instances before it are removed, handle stays valid:
+  // it is slot in table of dense indices, generation of slot tells removed instance from new one
+  class InstanceStore {
+  public:
+    struct Handle {
+      uint32_t slot = std::numeric_limits<uint32_t>::max();
+      uint32_t generation = 0;
+
+      bool operator==(const Handle &other) const noexcept = default;
+    };
+
+    // Mesh of instance and first instance of this mesh, layout is the same as in culling shaders
+    struct MeshRef {
+      uint32_t mesh;
+      uint32_t first_instance;
+    };
+
+  private:
+    static inline constexpr uint32_t no_index = std::numeric_limits<uint32_t>::max();
+
+    // Columns
+    std::vector<Matr4f> _transforms;
+    std::vector<MeshRef> _meshes;
+    std::vector<uint32_t> _slots; // handle slot of each instance
+
+    // Dense index for each slot, 'no_index' for free slots
+    std::vector<uint32_t> _indices;
+    std::vector<uint32_t> _generations;
+    std::vector<uint32_t> _free_slots;
+
+  public:
+    InstanceStore() = default;
+
+    InstanceStore(InstanceStore &&) noexcept = default;
+    InstanceStore & operator=(InstanceStore &&) noexcept = default;
+
+    // Appends instances of new mesh, returns index of the first of them
+    uint32_t append(uint32_t mesh, std::span<const Matr4f> transforms) noexcept;
+
+    // Removes instances of meshes range, next instances are shifted to keep columns dense.
+    // Indices of next meshes decrease by 'meshes_number'
+    void erase(uint32_t first, uint32_t count, uint32_t meshes_number) noexcept;
+
+    Handle handle(uint32_t instance) const noexcept
+    {
+      ASSERT(instance < size());
+      uint32_t slot = _slots[instance];
+      return {slot, _generations[slot]};
+    }
+
+    bool contains(Handle handle) const noexcept
+    {
+      return handle.slot < _indices.size() && _indices[handle.slot] != no_index &&
+             _generations[handle.slot] == handle.generation;
+    }
+
+    // Current index of instance in columns
+    uint32_t index(Handle handle) const noexcept
+    {
+      ASSERT(contains(handle), "Instance was removed", handle.slot);
+      return _indices[handle.slot];
+    }
+
+    uint32_t size() const noexcept { return static_cast<uint32_t>(_transforms.size()); }
+    bool empty() const noexcept { return _transforms.empty(); }
+
+    std::span<const Matr4f> transforms() const noexcept { return _transforms; }
+    std::span<Matr4f> transforms() noexcept { return _transforms; }
+    std::span<const MeshRef> meshes() const noexcept { return _meshes; }
+
+  private:
+    uint32_t allocate_slot(uint32_t index) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_INSTANCE_STORE_HPP_
@@ -0,0 +1,174 @@
+#include "scene/lod_selector.hpp"
+
+#include <numeric>
+
+// Matrices are read as raw floats in the same way as shaders do
+static std::array<float, 16> to_floats(const mr::Matr4f &matrix) noexcept
+{
+  static_assert(sizeof(mr::Matr4f) == 16 * sizeof(float));
+  std::array<float, 16> data;
+  std::memcpy(data.data(), &matrix, sizeof(data));
+  return data;
+}
+
+static float mean_edge_length(std::span<const std::byte> positions, size_t stride,
+                              std::span<const uint32_t> indices) noexcept
+{
+  ASSERT(indices.size() % 3 == 0);
+  if (indices.empty()) {
+    return 0;
+  }
+
+  auto position = [&](uint32_t index) {
+    ASSERT((index + 1) * stride <= positions.size(), "Index is out of positions", index);
+    std::array<float, 3> p;
+    std::memcpy(p.data(), positions.data() + index * stride, sizeof(p));
+    return p;
+  };
+
+  double length = 0;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    for (int k = 0; k < 3; k++) {
+      auto a = position(indices[i + k]);
+      auto b = position(indices[i + (k + 1) % 3]);
+      length += std::hypot(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+    }
+  }
+  return static_cast<float>(length / indices.size());
+}
+
+float mr::LodSelector::estimate_error(std::span<const std::byte> positions, size_t stride,
+                                      std::span<const uint32_t> finest_indices,
+                                      std::span<const uint32_t> lod_indices) noexcept
+{
+  float finest_edge = mean_edge_length(positions, stride, finest_indices);
+  float lod_edge = mean_edge_length(positions, stride, lod_indices);
+  return std::max(0.f, lod_edge - finest_edge) * 0.5f;
+}
+
+uint32_t mr::LodSelector::add_mesh(const FrustumCuller::BoundBox &bounds, std::span<const float> lod_errors,
+                                   uint32_t instances_number, bool impostor) noexcept
+{
+  ASSERT(not lod_errors.empty());
+  // Impostor takes last LOD slot
+  uint32_t max_mesh_lods = impostor ? max_lods - 1 : max_lods;
+  if (lod_errors.size() > max_mesh_lods) {
+    MR_WARNING("Mesh has {} LODs, only first {} are used", lod_errors.size(), max_mesh_lods);
+  }
+
+  MeshLods mesh {
+    .lods_number = static_cast<uint32_t>(std::min<size_t>(lod_errors.size(), max_mesh_lods)),
+    .radius = 0.5f * std::hypot(bounds.max[0] - bounds.min[0], bounds.max[1] - bounds.min[1],
+                                bounds.max[2] - bounds.min[2]),
+    .impostor = impostor,
+  };
+  // Coarser LOD can't have smaller error, otherwise selection by threshold breaks
+  for (uint32_t i = 0; i < mesh.lods_number; i++) {
+    mesh.errors[i] = i == 0 ? lod_errors[0] : std::max(lod_errors[i], mesh.errors[i - 1]);
+  }
+
+  _meshes.emplace_back(mesh);
+  _lod_counts.emplace_back();
+  _instance_lods.resize(_instance_lods.size() + instances_number, 0);
+  return _meshes.size() - 1;
+}
+
+void mr::LodSelector::remove_meshes(uint32_t first_mesh, uint32_t meshes_number,
+                                    uint32_t first_instance, uint32_t instances_number) noexcept
+{
+  ASSERT(first_mesh + meshes_number <= _meshes.size());
+  ASSERT(first_instance + instances_number <= _instance_lods.size());
+
+  _meshes.erase(_meshes.begin() + first_mesh, _meshes.begin() + first_mesh + meshes_number);
+  _lod_counts.erase(_lod_counts.begin() + first_mesh, _lod_counts.begin() + first_mesh + meshes_number);
+  _instance_lods.erase(_instance_lods.begin() + first_instance,
+                       _instance_lods.begin() + first_instance + instances_number);
+}
+
+mr::LodSelector::Projection mr::LodSelector::projection(const Matr4f &viewproj, float viewport_height) noexcept
+{
+  // Clip coordinate k is dot product of (position, 1) with row k of this matrix.
+  // Length of row 1 direction part is vertical projection scale, because view matrix is orthonormal
+  auto vp = to_floats(viewproj);
+  return Projection {
+    .w_row = {vp[3], vp[7], vp[11], vp[15]},
+    .pixels_per_unit = viewport_height * 0.5f * std::hypot(vp[1], vp[5], vp[9]),
+  };
+}
+
+void mr::LodSelector::select(const Matr4f &viewproj, float viewport_height, FrustumCuller &culler) noexcept
+{
+  auto [w_row, pixels_per_unit_at_1] = projection(viewproj, viewport_height);
+
+  tbb::parallel_for(tbb::blocked_range<uint32_t>(0, static_cast<uint32_t>(_meshes.size())),
+    [&](const tbb::blocked_range<uint32_t> &range) {
+      thread_local std::vector<uint32_t> sorted_instances;
+
+      for (uint32_t mesh = range.begin(); mesh < range.end(); mesh++) {
+        const auto &lods = _meshes[mesh];
+        auto &counts = _lod_counts[mesh];
+        auto instances = culler.visible_instances(mesh);
+
+        counts = {};
+        if (lods.lods_number == 1 && not lods.impostor) {
+          counts[0] = static_cast<uint32_t>(instances.size());
+          continue;
+        }
+
+        // The coarsest LOD which error is below threshold
+        auto coarsest_lod = [&lods](float pixels_per_unit, float threshold) {
+          uint32_t lod = 0;
+          while (lod + 1 < lods.lods_number && lods.errors[lod + 1] * pixels_per_unit <= threshold) {
+            lod++;
+          }
+          return lod;
+        };
+
+        for (auto instance : instances) {
+          auto center = culler.instance_center(instance);
+          float radius = culler.instance_radius(instance);
+          float scale = lods.radius > 0 ? radius / lods.radius : 1;
+          float distance = w_row[0] * center[0] + w_row[1] * center[1] + w_row[2] * center[2] + w_row[3] - radius;
+          float pixels_per_unit = scale * pixels_per_unit_at_1 / std::max(distance, 1e-3f);
+
+          // Impostor switches back to geometry nearer than its distance reduced by hysteresis
+          bool was_impostor = lods.impostor && _instance_lods[instance] == lods.lods_number;
+          float center_distance = distance + radius;
+          if (lods.impostor && center_distance > _impostor_distance / (was_impostor ? 1 + _hysteresis : 1)) {
+            _instance_lods[instance] = static_cast<uint8_t>(lods.lods_number);
+            counts[lods.lods_number]++;
+            continue;
+          }
+
+          uint32_t current = std::min<uint32_t>(_instance_lods[instance], lods.lods_number - 1);
+          uint32_t lod;
+          if (lods.errors[current] * pixels_per_unit > _threshold) {
+            lod = coarsest_lod(pixels_per_unit, _threshold);
+          } else {
+            lod = std::max(current, coarsest_lod(pixels_per_unit, _threshold / (1 + _hysteresis)));
+          }
+          _instance_lods[instance] = static_cast<uint8_t>(lod);
+          counts[lod]++;
+        }
+
+        // Counting sort of instances by LOD
+        LodCounts starts;
+        std::exclusive_scan(counts.begin(), counts.end(), starts.begin(), 0u);
+        sorted_instances.resize(instances.size());
+        for (auto instance : instances) {
+          sorted_instances[starts[_instance_lods[instance]]++] = instance;
+        }
+        std::ranges::copy(sorted_instances, instances.begin());
+      }
+    });
+
+  _stats.instances_numbers = {};
+  _stats.impostors_number = 0;
+  for (uint32_t mesh = 0; mesh < _meshes.size(); mesh++) {
+    const auto &counts = _lod_counts[mesh];
+    for (uint32_t lod = 0; lod < _meshes[mesh].lods_number; lod++) {
+      _stats.instances_numbers[lod] += counts[lod];
+    }
+    _stats.impostors_number += impostors_number(mesh);
+  }
+}
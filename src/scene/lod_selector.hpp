@@ -0,0 +1,104 @@
+#ifndef __MR_LOD_SELECTOR_HPP_
+#define __MR_LOD_SELECTOR_HPP_
+
+#include "pch.hpp"
+
+#include "scene/frustum_culler.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Per instance LOD selection by screen space error.
+  // Each LOD has geometric error in mesh space, it is projected to screen by distance to instance bounding
+  // sphere and the coarsest LOD with error below threshold is selected. Switching to coarser LOD requires
+  // error smaller by hysteresis factor, so instances near threshold distance don't pop each frame.
+  // Visible instances of each mesh are sorted by LOD, so each LOD is one indirect command.
+  // Mesh with impostor has one more LOD after its geometry LODs: instances farther than impostor distance
+  // are drawn by impostor.
+  class LodSelector {
+  public:
+    static inline constexpr uint32_t max_lods = 8;
+    using LodCounts = std::array<uint32_t, max_lods>;
+
+    // Data for projection of mesh space error to pixels
+    struct Projection {
+      std::array<float, 4> w_row;  // clip w row of viewproj, gives distance along view direction
+      float pixels_per_unit;       // at distance 1
+    };
+
+    struct Stats {
+      LodCounts instances_numbers {}; // visible instances number for each LOD
+      uint32_t impostors_number = 0;  // visible instances drawn by impostors
+    };
+
+  private:
+    struct MeshLods {
+      std::array<float, max_lods> errors {};
+      uint32_t lods_number; // without impostor
+      float radius; // bounding sphere radius in mesh space
+      bool impostor;
+    };
+
+    std::vector<MeshLods> _meshes;
+    std::vector<LodCounts> _lod_counts;
+    std::vector<uint8_t> _instance_lods; // LOD selected in previous frame for each instance
+
+    float _threshold = 1;    // in pixels
+    float _hysteresis = 0.25f;
+    float _impostor_distance = 50; // in world units
+
+    Stats _stats;
+
+  public:
+    LodSelector() = default;
+
+    LodSelector(LodSelector &&) noexcept = default;
+    LodSelector & operator=(LodSelector &&) noexcept = default;
+
+    // Error estimation of LOD which shares vertices with the finest one: half of its mean edge length growth.
+    // Positions are read as 3 floats at the beginning of each 'stride' bytes
+    static float estimate_error(std::span<const std::byte> positions, size_t stride,
+                                std::span<const uint32_t> finest_indices,
+                                std::span<const uint32_t> lod_indices) noexcept;
+
+    static Projection projection(const Matr4f &viewproj, float viewport_height) noexcept;
+
+    // Returns index of mesh, meshes must be added in the same order as to FrustumCuller
+    uint32_t add_mesh(const FrustumCuller::BoundBox &bounds, std::span<const float> lod_errors,
+                      uint32_t instances_number, bool impostor = false) noexcept;
+
+    // Removes meshes which instances are the range of all instances, LODs of next instances are kept
+    void remove_meshes(uint32_t first_mesh, uint32_t meshes_number,
+                       uint32_t first_instance, uint32_t instances_number) noexcept;
+
+    // Selects LOD for visible instances of culler and reorders them by LOD
+    void select(const Matr4f &viewproj, float viewport_height, FrustumCuller &culler) noexcept;
+
+    // Visible instances number for each LOD of mesh, valid after 'select'
+    const LodCounts & lod_counts(uint32_t mesh) const noexcept { return _lod_counts[mesh]; }
+    // Geometry LODs number of mesh, impostor instances are counted in LOD with this index
+    uint32_t lods_number(uint32_t mesh) const noexcept { return _meshes[mesh].lods_number; }
+    // Errors of geometry LODs of mesh, they don't decrease from the finest LOD to the coarsest one
+    std::span<const float> errors(uint32_t mesh) const noexcept
+    {
+      return std::span(_meshes[mesh].errors).first(_meshes[mesh].lods_number);
+    }
+    // Bounding sphere radius in mesh space
+    float radius(uint32_t mesh) const noexcept { return _meshes[mesh].radius; }
+    uint32_t impostors_number(uint32_t mesh) const noexcept
+    {
+      return _meshes[mesh].impostor ? _lod_counts[mesh][_meshes[mesh].lods_number] : 0;
+    }
+
+    void threshold(float pixels) noexcept { _threshold = pixels; }
+    float threshold() const noexcept { return _threshold; }
+    void hysteresis(float factor) noexcept { _hysteresis = factor; }
+    float hysteresis() const noexcept { return _hysteresis; }
+    void impostor_distance(float distance) noexcept { _impostor_distance = distance; }
+    float impostor_distance() const noexcept { return _impostor_distance; }
+
+    const Stats & stats() const noexcept { return _stats; }
+  };
+}
+} // namespace mr
+
+#endif // __MR_LOD_SELECTOR_HPP_
@@ -0,0 +1,458 @@
+#include "scene/occlusion_culler.hpp"
+
+// Points with smaller clip w are treated as crossing near plane
+static constexpr float min_w = 1e-4f;
+static constexpr uint32_t tiles_width = mr::OcclusionCuller::width / mr::OcclusionCuller::tile_size;
+static constexpr uint32_t tiles_height = mr::OcclusionCuller::height / mr::OcclusionCuller::tile_size;
+
+static_assert(mr::OcclusionCuller::width % mr::OcclusionCuller::tile_size == 0);
+static_assert(mr::OcclusionCuller::height % mr::OcclusionCuller::tile_size == 0);
+static_assert(mr::OcclusionCuller::tile_size == 8, "Rasterization processes rows by 8 pixels");
+
+// Matrices are read as raw floats in the same way as shaders do
+static std::array<float, 16> to_floats(const mr::Matr4f &matrix) noexcept
+{
+  static_assert(sizeof(mr::Matr4f) == 16 * sizeof(float));
+  std::array<float, 16> data;
+  std::memcpy(data.data(), &matrix, sizeof(data));
+  return data;
+}
+
+// Shaders apply transform as 'transpose(matrix) * position', so row i of raw data gives coordinate i
+static std::array<float, 3> transform_point(const std::array<float, 16> &t, const std::array<float, 3> &p) noexcept
+{
+  return {
+    t[0] * p[0] + t[1] * p[1] + t[2] * p[2] + t[3],
+    t[4] * p[0] + t[5] * p[1] + t[6] * p[2] + t[7],
+    t[8] * p[0] + t[9] * p[1] + t[10] * p[2] + t[11],
+  };
+}
+
+// Clip coordinate k is dot product of (position, 1) with row k of viewproj matrix
+static std::array<float, 4> to_clip(const std::array<float, 16> &vp, const std::array<float, 3> &p) noexcept
+{
+  std::array<float, 4> clip;
+  for (int k = 0; k < 4; k++) {
+    clip[k] = vp[k] * p[0] + vp[4 + k] * p[1] + vp[8 + k] * p[2] + vp[12 + k];
+  }
+  return clip;
+}
+
+mr::OcclusionCuller::OcclusionCuller()
+  : _depth(width * height, 1.f)
+  , _tiles_max_depth(tiles_width * tiles_height, 1.f)
+{
+}
+
+mr::OcclusionCuller::OccluderInstance mr::OcclusionCuller::make_instance(uint32_t mesh,
+                                                                        const Matr4f &transform) const noexcept
+{
+  auto t = to_floats(transform);
+  float scale = 0;
+  for (int j = 0; j < 3; j++) {
+    scale = std::max(scale, std::hypot(t[j], t[4 + j], t[8 + j]));
+  }
+  return OccluderInstance {
+    .mesh = mesh,
+    .transform = t,
+    .center = transform_point(t, _meshes[mesh].center),
+    .radius = _meshes[mesh].radius * scale,
+  };
+}
+
+std::optional<mr::OcclusionCuller::Occluder> mr::OcclusionCuller::extract(std::span<const std::byte> positions,
+                                                                          size_t stride,
+                                                                          std::span<const uint32_t> indices) noexcept
+{
+  ASSERT(stride >= 3 * sizeof(float));
+  ASSERT(indices.size() % 3 == 0);
+  if (indices.empty() || indices.size() / 3 > max_occluder_triangles) {
+    return std::nullopt;
+  }
+
+  Occluder occluder;
+  occluder.indices.reserve(indices.size());
+  std::vector<uint32_t> remap(positions.size() / stride, std::numeric_limits<uint32_t>::max());
+  for (auto index : indices) {
+    ASSERT(index < remap.size(), "Index is out of positions", index);
+    if (remap[index] == std::numeric_limits<uint32_t>::max()) {
+      remap[index] = static_cast<uint32_t>(occluder.vertices.size());
+      auto &vertex = occluder.vertices.emplace_back();
+      std::memcpy(vertex.data(), positions.data() + index * stride, sizeof(vertex));
+    }
+    occluder.indices.push_back(remap[index]);
+  }
+
+  auto bounds = FrustumCuller::BoundBox::from_positions(std::as_bytes(std::span(occluder.vertices)),
+                                                        sizeof(occluder.vertices[0]));
+  std::array<float, 3> extent;
+  for (int i = 0; i < 3; i++) {
+    occluder.center[i] = (bounds.min[i] + bounds.max[i]) * 0.5f;
+    extent[i] = (bounds.max[i] - bounds.min[i]) * 0.5f;
+  }
+  occluder.radius = std::hypot(extent[0], extent[1], extent[2]);
+  return occluder;
+}
+
+void mr::OcclusionCuller::add_occluder(uint32_t scene_mesh, uint32_t first_scene_instance, Occluder occluder,
+                                       std::span<const Matr4f> transforms) noexcept
+{
+  if (transforms.empty()) {
+    return;
+  }
+
+  ASSERT(_meshes.empty() || _meshes.back().first_scene_instance < first_scene_instance,
+         "Occluders must be added in scene order");
+  uint32_t mesh_index = static_cast<uint32_t>(_meshes.size());
+  _meshes.emplace_back(OccluderMesh {
+    .scene_mesh = scene_mesh,
+    .first_scene_instance = first_scene_instance,
+    .first_instance = static_cast<uint32_t>(_instances.size()),
+    .instances_number = static_cast<uint32_t>(transforms.size()),
+    .vertices = std::move(occluder.vertices),
+    .indices = std::move(occluder.indices),
+    .center = occluder.center,
+    .radius = occluder.radius,
+  });
+
+  for (const auto &transform : transforms) {
+    _instances.emplace_back(make_instance(mesh_index, transform));
+  }
+}
+
+void mr::OcclusionCuller::remove_meshes(uint32_t first_mesh, uint32_t meshes_number,
+                                        uint32_t first_instance, uint32_t instances_number) noexcept
+{
+  // New index of each occluder, removed ones are skipped
+  std::vector<uint32_t> remap(_meshes.size(), std::numeric_limits<uint32_t>::max());
+  uint32_t occluders_number = 0;
+  for (uint32_t i = 0; i < _meshes.size(); i++) {
+    auto &mesh = _meshes[i];
+    if (mesh.scene_mesh >= first_mesh && mesh.scene_mesh < first_mesh + meshes_number) {
+      continue;
+    }
+    if (mesh.scene_mesh >= first_mesh + meshes_number) {
+      mesh.scene_mesh -= meshes_number;
+      ASSERT(mesh.first_scene_instance >= first_instance + instances_number);
+      mesh.first_scene_instance -= instances_number;
+    }
+    remap[i] = occluders_number;
+    _meshes[occluders_number++] = std::move(mesh);
+  }
+  _meshes.resize(occluders_number);
+
+  std::erase_if(_instances, [&remap](const OccluderInstance &instance) {
+    return remap[instance.mesh] == std::numeric_limits<uint32_t>::max();
+  });
+  for (auto &instance : _instances) {
+    instance.mesh = remap[instance.mesh];
+  }
+
+  // Instances of the rest of meshes stay in the same order
+  uint32_t occluder_instance = 0;
+  for (auto &mesh : _meshes) {
+    mesh.first_instance = occluder_instance;
+    occluder_instance += mesh.instances_number;
+  }
+  ASSERT(occluder_instance == _instances.size());
+}
+
+void mr::OcclusionCuller::update_instance(uint32_t scene_instance, const Matr4f &transform) noexcept
+{
+  // The last mesh which starts at or before instance
+  auto mesh = std::ranges::upper_bound(_meshes, scene_instance, {}, &OccluderMesh::first_scene_instance);
+  if (mesh == _meshes.begin()) {
+    return;
+  }
+  --mesh;
+  if (scene_instance >= mesh->first_scene_instance + mesh->instances_number) {
+    return;
+  }
+
+  uint32_t mesh_index = static_cast<uint32_t>(mesh - _meshes.begin());
+  _instances[mesh->first_instance + scene_instance - mesh->first_scene_instance] =
+    make_instance(mesh_index, transform);
+}
+
+void mr::OcclusionCuller::rasterize(const Matr4f &viewproj) noexcept
+{
+  auto start = std::chrono::steady_clock::now();
+
+  _viewproj = to_floats(viewproj);
+  std::array w_row {_viewproj[3], _viewproj[7], _viewproj[11], _viewproj[15]};
+
+  // Occluders which cover the biggest part of screen are the nearest relative to their size
+  std::vector<std::pair<float, uint32_t>> candidates;
+  candidates.reserve(_instances.size());
+  for (uint32_t i = 0; i < _instances.size(); i++) {
+    const auto &instance = _instances[i];
+    float w = w_row[0] * instance.center[0] + w_row[1] * instance.center[1] + w_row[2] * instance.center[2] + w_row[3];
+    if (w + instance.radius <= min_w) {
+      continue;
+    }
+    candidates.emplace_back(instance.radius / std::max(w, min_w), i);
+  }
+  size_t selected_number = std::min<size_t>(candidates.size(), max_occluders_per_frame);
+  std::ranges::nth_element(candidates, candidates.begin() + selected_number, std::greater {});
+
+  _selected_instances.clear();
+  std::vector<uint32_t> first_triangles;
+  uint32_t triangles_number = 0;
+  for (size_t i = 0; i < selected_number; i++) {
+    auto instance = candidates[i].second;
+    _selected_instances.push_back(instance);
+    first_triangles.push_back(triangles_number);
+    triangles_number += _meshes[_instances[instance].mesh].indices.size() / 3;
+  }
+  _triangles.resize(triangles_number);
+
+  tbb::parallel_for(tbb::blocked_range<uint32_t>(0, static_cast<uint32_t>(_selected_instances.size())),
+    [&](const tbb::blocked_range<uint32_t> &range) {
+      for (uint32_t i = range.begin(); i < range.end(); i++) {
+        setup_triangles(i, first_triangles[i]);
+      }
+    });
+
+  // Each band is one row of tiles
+  tbb::parallel_for(tbb::blocked_range<uint32_t>(0, tiles_height),
+    [&](const tbb::blocked_range<uint32_t> &range) {
+      for (uint32_t band = range.begin(); band < range.end(); band++) {
+        rasterize_band(band * tile_size, (band + 1) * tile_size);
+      }
+    });
+
+  _stats.occluders_number = static_cast<uint32_t>(_selected_instances.size());
+  _stats.triangles_number = triangles_number;
+  _stats.rasterization_ms =
+    std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void mr::OcclusionCuller::setup_triangles(uint32_t selected_instance, uint32_t first_triangle) noexcept
+{
+  const auto &instance = _instances[_selected_instances[selected_instance]];
+  const auto &mesh = _meshes[instance.mesh];
+
+  for (uint32_t triangle = 0; triangle < mesh.indices.size() / 3; triangle++) {
+    auto &screen_triangle = _triangles[first_triangle + triangle];
+    screen_triangle.valid = false;
+    screen_triangle.depth = 0;
+
+    bool crosses_near = false;
+    for (int k = 0; k < 3; k++) {
+      const auto &vertex = mesh.vertices[mesh.indices[3 * triangle + k]];
+      auto clip = to_clip(_viewproj, transform_point(instance.transform, vertex));
+      // Clipping is not worth it for occluders, such triangles are skipped
+      if (clip[3] <= min_w) {
+        crosses_near = true;
+        break;
+      }
+      screen_triangle.x[k] = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+      screen_triangle.y[k] = (clip[1] / clip[3] * 0.5f + 0.5f) * height;
+      screen_triangle.depth = std::max(screen_triangle.depth, clip[2] / clip[3]);
+    }
+    if (crosses_near) {
+      continue;
+    }
+
+    auto &[x, y, depth, valid] = screen_triangle;
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0) {
+      continue;
+    }
+    // Occluders are double sided, vertices are reordered to make edge functions positive inside
+    if (area < 0) {
+      std::swap(x[1], x[2]);
+      std::swap(y[1], y[2]);
+    }
+
+    valid = std::ranges::max(x) >= 0 && std::ranges::min(x) < width &&
+            std::ranges::max(y) >= 0 && std::ranges::min(y) < height &&
+            depth <= 1;
+  }
+}
+
+// Depth of triangle is written to row pixels of [min_column, max_column] which are inside of triangle,
+// 'min_column' is aligned to 8
+static void fill_row_span(float *depth_row, int min_column, int max_column,
+                          const std::array<float, 3> &a_coef, const std::array<float, 3> &row_edge,
+                          float depth) noexcept
+{
+  for (int column = min_column; column <= max_column; column++) {
+    float px = column + 0.5f;
+    bool inside = true;
+    for (int i = 0; i < 3; i++) {
+      inside = inside && a_coef[i] * px + row_edge[i] >= 0;
+    }
+    if (inside) {
+      depth_row[column] = std::min(depth_row[column], depth);
+    }
+  }
+}
+
+static MR_AVX2 void fill_row_span_avx2(float *depth_row, int min_column, int max_column,
+                                       const std::array<float, 3> &a_coef, const std::array<float, 3> &row_edge,
+                                       float depth) noexcept
+{
+#ifdef MR_ENABLE_AVX2
+  const __m256 lanes = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 triangle_depth = _mm256_set1_ps(depth);
+  for (int column = min_column; column <= max_column; column += 8) {
+    __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(column)), lanes);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int i = 0; i < 3; i++) {
+      __m256 edge = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a_coef[i]), px), _mm256_set1_ps(row_edge[i]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, zero, _CMP_GE_OQ));
+    }
+    if (_mm256_movemask_ps(inside) == 0) {
+      continue;
+    }
+    __m256 old_depth = _mm256_loadu_ps(depth_row + column);
+    __m256 new_depth = _mm256_blendv_ps(old_depth, _mm256_min_ps(old_depth, triangle_depth), inside);
+    _mm256_storeu_ps(depth_row + column, new_depth);
+  }
+#else
+  fill_row_span(depth_row, min_column, max_column, a_coef, row_edge, depth);
+#endif
+}
+
+static float get_tile_max_depth(const float *tile) noexcept
+{
+  constexpr uint32_t tile_size = mr::OcclusionCuller::tile_size;
+  float max_depth = 0;
+  for (uint32_t row = 0; row < tile_size; row++) {
+    for (uint32_t column = 0; column < tile_size; column++) {
+      max_depth = std::max(max_depth, tile[row * mr::OcclusionCuller::width + column]);
+    }
+  }
+  return max_depth;
+}
+
+static MR_AVX2 float get_tile_max_depth_avx2(const float *tile) noexcept
+{
+#ifdef MR_ENABLE_AVX2
+  __m256 max_depth = _mm256_loadu_ps(tile);
+  for (uint32_t row = 1; row < mr::OcclusionCuller::tile_size; row++) {
+    max_depth = _mm256_max_ps(max_depth, _mm256_loadu_ps(tile + row * mr::OcclusionCuller::width));
+  }
+  alignas(32) std::array<float, 8> lanes;
+  _mm256_store_ps(lanes.data(), max_depth);
+  return std::ranges::max(lanes);
+#else
+  return get_tile_max_depth(tile);
+#endif
+}
+
+void mr::OcclusionCuller::rasterize_band(uint32_t first_row, uint32_t last_row) noexcept
+{
+  const bool avx2 = has_avx2();
+  std::fill(_depth.begin() + first_row * width, _depth.begin() + last_row * width, 1.f);
+
+  for (const auto &[x, y, depth, valid] : _triangles) {
+    if (not valid) {
+      continue;
+    }
+
+    int min_row = std::max(static_cast<int>(first_row), static_cast<int>(std::floor(std::ranges::min(y))));
+    int max_row = std::min(static_cast<int>(last_row) - 1, static_cast<int>(std::ranges::max(y)));
+    if (min_row > max_row) {
+      continue;
+    }
+    // Pixels out of bound box are out of triangle, so columns are aligned to SIMD width without masking
+    int min_column = std::max(0, static_cast<int>(std::floor(std::ranges::min(x)))) / 8 * 8;
+    int max_column = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ranges::max(x)));
+
+    // Edge function of edge (a, b) is e(p) = a_coef * p.x + b_coef * p.y + c_coef, it is positive inside
+    std::array<float, 3> a_coef, b_coef, c_coef;
+    for (int i = 0; i < 3; i++) {
+      int j = (i + 1) % 3;
+      a_coef[i] = y[i] - y[j];
+      b_coef[i] = x[j] - x[i];
+      c_coef[i] = -(a_coef[i] * x[i] + b_coef[i] * y[i]);
+    }
+
+    for (int row = min_row; row <= max_row; row++) {
+      float py = row + 0.5f;
+      std::array<float, 3> row_edge;
+      for (int i = 0; i < 3; i++) {
+        row_edge[i] = b_coef[i] * py + c_coef[i];
+      }
+      float *depth_row = _depth.data() + row * width;
+
+      if (avx2) {
+        fill_row_span_avx2(depth_row, min_column, max_column, a_coef, row_edge, depth);
+      } else {
+        fill_row_span(depth_row, min_column, max_column, a_coef, row_edge, depth);
+      }
+    }
+  }
+
+  // Max depth of tiles in band
+  uint32_t tile_row = first_row / tile_size;
+  for (uint32_t tile_column = 0; tile_column < tiles_width; tile_column++) {
+    const float *tile = _depth.data() + first_row * width + tile_column * tile_size;
+    _tiles_max_depth[tile_row * tiles_width + tile_column] =
+      avx2 ? get_tile_max_depth_avx2(tile) : get_tile_max_depth(tile);
+  }
+}
+
+bool mr::OcclusionCuller::is_occluded(const std::array<float, 3> &center,
+                                      const std::array<float, 3> &extent) const noexcept
+{
+  float min_x = std::numeric_limits<float>::max(), max_x = std::numeric_limits<float>::lowest();
+  float min_y = std::numeric_limits<float>::max(), max_y = std::numeric_limits<float>::lowest();
+  float min_depth = 1;
+  for (int i = 0; i < 8; i++) {
+    std::array corner {
+      center[0] + ((i & 1) ? extent[0] : -extent[0]),
+      center[1] + ((i & 2) ? extent[1] : -extent[1]),
+      center[2] + ((i & 4) ? extent[2] : -extent[2]),
+    };
+    auto clip = to_clip(_viewproj, corner);
+    if (clip[3] <= min_w) {
+      return false;
+    }
+    float x = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+    float y = (clip[1] / clip[3] * 0.5f + 0.5f) * height;
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+    min_depth = std::min(min_depth, clip[2] / clip[3]);
+  }
+
+  // Boxes out of screen are left to frustum culling
+  if (max_x < 0 || min_x >= width || max_y < 0 || min_y >= height) {
+    return false;
+  }
+
+  uint32_t first_tile_x = static_cast<uint32_t>(std::max(min_x, 0.f)) / tile_size;
+  uint32_t last_tile_x = std::min(static_cast<uint32_t>(max_x), width - 1) / tile_size;
+  uint32_t first_tile_y = static_cast<uint32_t>(std::max(min_y, 0.f)) / tile_size;
+  uint32_t last_tile_y = std::min(static_cast<uint32_t>(max_y), height - 1) / tile_size;
+
+  // Depth test is 'less', so box is hidden if its nearest point is behind all occluders in covered tiles
+  for (uint32_t tile_y = first_tile_y; tile_y <= last_tile_y; tile_y++) {
+    for (uint32_t tile_x = first_tile_x; tile_x <= last_tile_x; tile_x++) {
+      if (_tiles_max_depth[tile_y * tiles_width + tile_x] >= min_depth) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void mr::OcclusionCuller::cull(FrustumCuller &frustum_culler) noexcept
+{
+  auto start = std::chrono::steady_clock::now();
+
+  _stats.tested_instances_number = frustum_culler.stats().visible_instances_number;
+  if (_stats.occluders_number > 0) {
+    frustum_culler.remove_instances_if([this, &frustum_culler](uint32_t instance) {
+      return is_occluded(frustum_culler.instance_center(instance), frustum_culler.instance_extent(instance));
+    });
+  }
+  _stats.occluded_instances_number = _stats.tested_instances_number - frustum_culler.stats().visible_instances_number;
+
+  _stats.test_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
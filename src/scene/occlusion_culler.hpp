@@ -0,0 +1,122 @@
+#ifndef __MR_OCCLUSION_CULLER_HPP_
+#define __MR_OCCLUSION_CULLER_HPP_
+
+#include "pch.hpp"
+
+#include "scene/frustum_culler.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // CPU occlusion culling for devices where GPU culling passes are too expensive (software Vulkan, weak iGPUs).
+  // The nearest occluders are rasterized to low resolution depth buffer: coverage of 8 pixels is computed
+  // per AVX2 iteration and is used as mask for depth update, horizontal bands of buffer are rasterized
+  // by different TBB workers. Instances which passed frustum culling are tested against max depth of 8x8 tiles.
+  class OcclusionCuller {
+  public:
+    static inline constexpr uint32_t width = 256;
+    static inline constexpr uint32_t height = 128;
+    static inline constexpr uint32_t tile_size = 8;
+
+    // Meshes with more triangles in the coarsest LOD are not used as occluders
+    static inline constexpr uint32_t max_occluder_triangles = 1024;
+    // Occluders nearest to camera relative to their size are rasterized
+    static inline constexpr uint32_t max_occluders_per_frame = 64;
+
+    struct Stats {
+      uint32_t occluders_number = 0;
+      uint32_t triangles_number = 0;
+      uint32_t tested_instances_number = 0;
+      uint32_t occluded_instances_number = 0;
+      float rasterization_ms = 0;
+      float test_ms = 0;
+    };
+
+    // Occluder geometry of mesh, it is extracted without culler
+    struct Occluder {
+      std::vector<std::array<float, 3>> vertices; // only vertices referenced by indices
+      std::vector<uint32_t> indices;
+      // Mesh space bounding sphere
+      std::array<float, 3> center;
+      float radius;
+    };
+
+  private:
+    struct OccluderMesh {
+      uint32_t scene_mesh; // index of mesh in scene
+      // Instances of mesh are contiguous both in scene and in occluder instances
+      uint32_t first_scene_instance;
+      uint32_t first_instance;
+      uint32_t instances_number;
+      std::vector<std::array<float, 3>> vertices; // only vertices referenced by indices
+      std::vector<uint32_t> indices;
+      // Mesh space bounding sphere
+      std::array<float, 3> center;
+      float radius;
+    };
+
+    struct OccluderInstance {
+      uint32_t mesh;
+      std::array<float, 16> transform;
+      // World space bounding sphere
+      std::array<float, 3> center;
+      float radius;
+    };
+
+    // Triangle in buffer pixels, depth is max depth of its vertices so occluder is never nearer than it is
+    struct ScreenTriangle {
+      std::array<float, 3> x;
+      std::array<float, 3> y;
+      float depth;
+      bool valid;
+    };
+
+    std::vector<OccluderMesh> _meshes;
+    std::vector<OccluderInstance> _instances;
+
+    std::vector<uint32_t> _selected_instances;
+    std::vector<ScreenTriangle> _triangles;
+
+    std::vector<float> _depth;
+    std::vector<float> _tiles_max_depth;
+    std::array<float, 16> _viewproj {};
+
+    Stats _stats;
+
+  public:
+    OcclusionCuller();
+
+    OcclusionCuller(OcclusionCuller &&) noexcept = default;
+    OcclusionCuller & operator=(OcclusionCuller &&) noexcept = default;
+
+    // Returns null if mesh is too complex to be occluder, can be called by any thread.
+    // Positions are read as 3 floats at the beginning of each 'stride' bytes
+    static std::optional<Occluder> extract(std::span<const std::byte> positions, size_t stride,
+                                           std::span<const uint32_t> indices) noexcept;
+    // Instances of mesh are scene instances from 'first_scene_instance', meshes are added in scene order
+    void add_occluder(uint32_t scene_mesh, uint32_t first_scene_instance, Occluder occluder,
+                      std::span<const Matr4f> transforms) noexcept;
+    // Removes occluders of scene meshes range which instances are the range of scene instances,
+    // indices of next scene meshes and instances decrease by their numbers
+    void remove_meshes(uint32_t first_mesh, uint32_t meshes_number,
+                       uint32_t first_instance, uint32_t instances_number) noexcept;
+    // Moves occluder of scene instance, instances of meshes which are not occluders are skipped
+    void update_instance(uint32_t scene_instance, const Matr4f &transform) noexcept;
+
+    // Can run in parallel with frustum culling
+    void rasterize(const Matr4f &viewproj) noexcept;
+    // Removes occluded instances from visible instances of frustum culler
+    void cull(FrustumCuller &frustum_culler) noexcept;
+
+    bool is_occluded(const std::array<float, 3> &center, const std::array<float, 3> &extent) const noexcept;
+
+    const Stats & stats() const noexcept { return _stats; }
+
+  private:
+    OccluderInstance make_instance(uint32_t mesh, const Matr4f &transform) const noexcept;
+    void setup_triangles(uint32_t selected_instance, uint32_t first_triangle) noexcept;
+    void rasterize_band(uint32_t first_row, uint32_t last_row) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_OCCLUSION_CULLER_HPP_
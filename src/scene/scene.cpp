@@ -2,12 +2,35 @@
 #include "renderer/window/render_context.hpp"
 #include "manager/manager.hpp"
 
+#include <tbb/parallel_invoke.h>
+
 mr::Scene::Scene(RenderContext &render_context)
   : _parent(&render_context)
+  , _transforms(_parent->vulkan_state(), &_parent->bindless_set())
+  , _transforms_upload(_parent->vulkan_state())
+  , _bounds(_parent->vulkan_state(), &_parent->bindless_set())
+  , _instance_meshes(_parent->vulkan_state(), &_parent->bindless_set())
+  , _meshlets(_parent->vulkan_state(), &_parent->bindless_set())
+  , _mesh_meshlets(_parent->vulkan_state(), &_parent->bindless_set())
+  , _meshlet_tasks(_parent->vulkan_state(), &_parent->bindless_set(),
+                   vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer)
+  , _mesh_lods(_parent->vulkan_state(), &_parent->bindless_set())
+  , _visibility(_parent->vulkan_state(), nullptr, {})
+  , _impostor_commands(_parent->vulkan_state(), &_parent->bindless_set(),
+                       vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer)
+  , _impostor_draws(_parent->vulkan_state(), &_parent->bindless_set())
+  , _visible_instances(_parent->vulkan_state(), &_parent->bindless_set())
+  , _mesh_visible_counts(_parent->vulkan_state(), &_parent->bindless_set())
+  , _draw_counts(_parent->vulkan_state(), &_parent->bindless_set(),
+                 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer)
+  , _meshlet_draw_counts(_parent->vulkan_state(), &_parent->bindless_set())
+  , _mesh_depths(_parent->vulkan_state(), &_parent->bindless_set())
+  , _depth_bucket_counts(_parent->vulkan_state(), &_parent->bindless_set())
+  , _instance_visibility(_parent->vulkan_state(), &_parent->bindless_set())
+  , _instance_lods(_parent->vulkan_state(), &_parent->bindless_set())
+  , _culling_stats(_parent->vulkan_state(), sizeof(OcclusionStats))
+  , _culling_stats_readback(_parent->vulkan_state(), sizeof(OcclusionStats), vk::BufferUsageFlagBits::eTransferDst)
   , _camera_uniform_buffer(_parent->vulkan_state(), sizeof(ShaderCameraData))
-  , _transforms(_parent->vulkan_state(), max_scene_instances * sizeof(mr::Matr4f))
-  , _bounds(_parent->vulkan_state(),     max_scene_instances * sizeof(mr::AABBf))
-  , _visibility(_parent->vulkan_state(), max_scene_instances * sizeof(uint32_t))
 {
   ASSERT(_parent != nullptr);
 
@@ -15,7 +38,11 @@ mr::Scene::Scene(RenderContext &render_context)
   _camera.cam().projection() = mr::math::Camera<float>::Projection(45_deg);
 
   _camera_buffer_id = render_context.bindless_set().register_resource(&_camera_uniform_buffer);
-  _transforms_buffer_id = render_context.bindless_set().register_resource(&_transforms);
+  _culling_stats_buffer_id = render_context.bindless_set().register_resource(&_culling_stats);
+  reserve_culling_arrays();
+
+  OcclusionStats empty_stats;
+  _culling_stats_readback.write(std::span(&empty_stats, 1));
 }
 
 mr::Scene::~Scene()
@@ -27,8 +54,51 @@ mr::Scene::~Scene()
   //            For fix it RenderContext must store all Scene instances and in destructor delete it from Manager,
   //            but now Manager doesn't support it. Maybe we can add as tmp solution Scene
   //            method 'notify_render_context_deleted` and use it as destuctor and move Scene in "disabeld" state
+  // Device arrays unregister themselves
   _parent->bindless_set().unregister_resource(&_camera_uniform_buffer);
-  _parent->bindless_set().unregister_resource(&_transforms);
+  _parent->bindless_set().unregister_resource(&_culling_stats);
+}
+
+void mr::Scene::reserve_culling_arrays() noexcept
+{
+  uint32_t instances_number = _instances.size();
+  uint32_t meshes_number = static_cast<uint32_t>(_bounds_data.size());
+
+  // Each LOD has its own copy of instances ranges for visible instances
+  _visible_lods_number = 1;
+  for (const auto &lods : _mesh_lods_data) {
+    _visible_lods_number = std::max(_visible_lods_number, lods.lods_number);
+  }
+
+  _visible_instances.reserve(size_t(instances_number) * _visible_lods_number);
+  _instance_visibility.reserve(instances_number);
+  _instance_lods.reserve(instances_number);
+  _meshlet_tasks.reserve(meshlet_tasks_header_size + instances_number);
+  _mesh_visible_counts.reserve(size_t(meshes_number) * mesh_visible_counts_stride);
+  _draw_counts.reserve(_draws.size());
+  _meshlet_draw_counts.reserve(_draws.size());
+  _mesh_depths.reserve(meshes_number);
+  _depth_bucket_counts.reserve(_draws.size() * 2 * depth_buckets_number);
+
+  // Culled commands of group: command of each LOD of each mesh and visible meshlets of its instances
+  for (auto &[pipeline, draw] : _draws) {
+    size_t lod_draws = 0;
+    size_t meshlet_draws = 0;
+    for (const auto *mesh : draw.meshes) {
+      lod_draws += _mesh_lods_data[mesh->_mesh_offset].lods_number;
+      meshlet_draws += size_t(mesh->_meshlets_number) * mesh->num_of_instances();
+    }
+    meshlet_draws = std::min<size_t>(meshlet_draws, max_group_meshlet_draws);
+    size_t capacity = lod_draws + meshlet_draws;
+    draw.culled_commands_buffer.reserve(capacity);
+    draw.culled_render_info.reserve(capacity);
+
+    for (const auto *mesh : draw.meshes) {
+      auto &mesh_meshlets = _mesh_meshlets_data[mesh->_mesh_offset];
+      mesh_meshlets.culled_commands_capacity = static_cast<uint32_t>(draw.culled_commands_buffer.capacity());
+      mesh_meshlets.meshlet_draws_capacity = static_cast<uint32_t>(meshlet_draws);
+    }
+  }
 }
 
 mr::DirectionalLightHandle mr::Scene::create_directional_light(const Norm3f &direction, const Vec3f &color) noexcept
@@ -41,27 +111,42 @@ mr::DirectionalLightHandle mr::Scene::create_directional_light(const Norm3f &dir
 }
 
 mr::ModelHandle mr::Scene::create_model(std::string_view filename) noexcept
+{
+  auto model_handle = add_model(filename);
+  upload_scene_arrays();
+  return model_handle;
+}
+
+mr::ModelHandle mr::Scene::add_model(std::string_view filename, std::shared_ptr<Model::Imported> imported) noexcept
 {
   ASSERT(_parent != nullptr);
 
-  auto model_handle = ResourceManager<Model>::get().create(mr::unnamed, *this, filename);
+  auto model_handle = imported != nullptr
+    ? ResourceManager<Model>::get().create(mr::unnamed, *this, filename, std::move(imported))
+    : ResourceManager<Model>::get().create(mr::unnamed, *this, filename);
 
   _models.push_back(model_handle);
+  for (auto &mesh : model_handle->_meshes) {
+    ASSERT(mesh._mesh_offset == _meshes.size());
+    _meshes.push_back(&mesh);
+  }
   for (const auto &[material, mesh] : model_handle->draws()) {
     auto pipeline = material->pipeline();
     if (not _draws.contains(pipeline)) {
+      uint32_t index = static_cast<uint32_t>(_draws.size());
       auto &draw = _draws[pipeline];
-      // TODO(dk6): I think max_scene_instances is too big number here
-      draw.commands_buffer =
-        StorageBuffer(_parent->vulkan_state(),
-        sizeof(vk::DrawIndexedIndirectCommand) * max_scene_instances,
-        vk::BufferUsageFlagBits::eStorageBuffer |
-          vk::BufferUsageFlagBits::eIndirectBuffer |
-          vk::BufferUsageFlagBits::eTransferDst);
-      draw.meshes_render_info = StorageBuffer(_parent->vulkan_state(), sizeof(Mesh::RenderInfo) * max_scene_instances);
-      draw.meshes_render_info_id = _parent->bindless_set().register_resource(&draw.meshes_render_info);
+      draw.index = index;
+
+      auto commands_usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+      draw.commands_buffer = DeviceArray<vk::DrawIndexedIndirectCommand>(_parent->vulkan_state(),
+        &_parent->bindless_set(), commands_usage);
+      draw.meshes_render_info = DeviceArray<Mesh::RenderInfo>(_parent->vulkan_state(), &_parent->bindless_set());
+      draw.culled_commands_buffer = DeviceArray<vk::DrawIndexedIndirectCommand>(_parent->vulkan_state(),
+        &_parent->bindless_set(), commands_usage);
+      draw.culled_render_info = DeviceArray<Mesh::RenderInfo>(_parent->vulkan_state(), &_parent->bindless_set());
     }
     auto &draw = _draws[pipeline];
+    draw.changed = true;
 
     // TODO(dk6): rework for only debug
     std::array attributes_byte_size {position_bytes_size, attributes_bytes_size};
@@ -72,6 +157,36 @@ mr::ModelHandle mr::Scene::create_model(std::string_view filename) noexcept
       ASSERT(vbuf.offset / size == vertex_offset);
     }
 
+    // Meshlets culling appends commands of visible meshlets to the same draws group
+    if (_mesh_meshlets_data.size() <= mesh._mesh_offset) {
+      _mesh_meshlets_data.resize(mesh._mesh_offset + 1);
+    }
+    _mesh_meshlets_data[mesh._mesh_offset] = MeshMeshlets {
+      .first_meshlet = mesh._first_meshlet,
+      .meshlets_number = mesh._meshlets_number,
+      .draw_group = draw.index,
+      .commands_buffer_id = draw.commands_buffer.id(),
+      .render_info_buffer_id = draw.meshes_render_info.id(),
+      .culled_commands_buffer_id = draw.culled_commands_buffer.id(),
+      .culled_render_info_buffer_id = draw.culled_render_info.id(),
+      .draw_index = static_cast<uint32_t>(draw.meshes.size()),
+      .instances_number = mesh.num_of_instances(),
+    };
+
+    // LODs which LOD selector uses, the rest of mesh LODs are not drawn
+    if (_mesh_lods_data.size() <= mesh._mesh_offset) {
+      _mesh_lods_data.resize(mesh._mesh_offset + 1);
+    }
+    auto &lods = _mesh_lods_data[mesh._mesh_offset];
+    auto lod_errors = _lod_selector.errors(mesh._mesh_offset);
+    lods.lods_number = static_cast<uint32_t>(lod_errors.size());
+    lods.radius = _lod_selector.radius(mesh._mesh_offset);
+    for (uint32_t lod = 0; lod < lods.lods_number; lod++) {
+      lods.errors[lod] = lod_errors[lod];
+      lods.first_indices[lod] = static_cast<uint32_t>(mesh._ibufs[lod].offset / sizeof(uint32_t));
+      lods.index_counts[lod] = mesh._ibufs[lod].elements_count;
+    }
+
     draw.meshes.emplace_back(&mesh);
     draw.commands_buffer_data.emplace_back(vk::DrawIndexedIndirectCommand {
       .indexCount = mesh.element_count(),
@@ -85,20 +200,284 @@ mr::ModelHandle mr::Scene::create_model(std::string_view filename) noexcept
       .instance_offset = mesh._instance_offset,
       .material_ubo_id = material->material_ubo_id(),
       .camera_buffer_id = _camera_buffer_id,
-      .transforms_buffer_id = _transforms_buffer_id,
+      .transforms_buffer_id = _transforms.id(),
+      .visible_instances_buffer_id = _visible_instances.id(),
     });
   }
 
   return model_handle;
 }
 
+void mr::Scene::upload_scene_arrays() noexcept
+{
+  // Buffers and sizes of arrays are recorded into rendering commands
+  structure_changed();
+
+  // Culling sources are changed only by models creation and removal
+  reserve_culling_arrays();
+
+  _draw_order.clear();
+  for (auto &[pipeline, draw] : _draws) {
+    _draw_order.emplace_back(pipeline, &draw);
+  }
+  std::ranges::sort(_draw_order, {}, [](const auto &pair) { return pair.second->index; });
+  for (auto &[pipeline, draw] : _draws) {
+    if (draw.changed) {
+      draw.commands_buffer.assign(std::span(draw.commands_buffer_data));
+      draw.meshes_render_info.assign(std::span(draw.meshes_render_info_data));
+      draw.changed = false;
+    }
+  }
+  _instance_meshes.assign(_instances.meshes());
+  _mesh_meshlets.assign(std::span(_mesh_meshlets_data));
+  _mesh_lods.assign(std::span(_mesh_lods_data));
+  _meshlets.assign(std::span(_meshlets_data));
+  _transforms.assign(_instances.transforms());
+  _moved_instances.clear();
+  _transforms_upload.discard();
+  _bounds.assign(std::span(_bounds_data));
+
+  // Write all descriptors of new models at once
+  _parent->bindless_set().flush();
+}
+
+void mr::Scene::remove(ModelHandle model) noexcept
+{
+  ASSERT(_parent != nullptr);
+
+  // Frames in flight can still read model data and descriptors
+  _parent->vulkan_state().queue().waitIdle();
+
+  remove_model(model);
+  upload_scene_arrays();
+}
+
+void mr::Scene::remove_model(ModelHandle model) noexcept
+{
+  auto model_it = std::ranges::find(_models, model);
+  ASSERT(model_it != _models.end(), "Model is not in scene");
+  _models.erase(model_it);
+
+  // Meshes of model are added together, so their meshes, instances and meshlets are contiguous ranges.
+  // Ranges are erased with shift of next ones: instances of each mesh must stay contiguous and ordered by mesh
+  uint32_t first_mesh = 0;
+  uint32_t meshes_number = static_cast<uint32_t>(model->_meshes.size());
+  uint32_t first_instance = 0;
+  uint32_t instances_number = 0;
+  uint32_t first_meshlet = std::numeric_limits<uint32_t>::max();
+  uint32_t meshlets_number = 0;
+  if (meshes_number > 0) {
+    const auto &last = model->_meshes.back();
+    first_mesh = model->_meshes.front()._mesh_offset;
+    first_instance = model->_meshes.front()._instance_offset;
+    instances_number = last._instance_offset + last.num_of_instances() - first_instance;
+  }
+  for (const auto &mesh : model->_meshes) {
+    ASSERT(_meshes[mesh._mesh_offset] == &mesh);
+    if (mesh._meshlets_number > 0) {
+      first_meshlet = std::min(first_meshlet, mesh._first_meshlet);
+      meshlets_number += mesh._meshlets_number;
+    }
+  }
+
+  // Order of commands in draws group doesn't matter, so the last one takes place of removed one
+  for (const auto &[material, mesh] : model->draws()) {
+    auto &draw = _draws[material->pipeline()];
+    uint32_t index = _mesh_meshlets_data[mesh._mesh_offset].draw_index;
+    ASSERT(draw.meshes[index] == &mesh);
+    draw.meshes[index] = draw.meshes.back();
+    draw.commands_buffer_data[index] = draw.commands_buffer_data.back();
+    draw.meshes_render_info_data[index] = draw.meshes_render_info_data.back();
+    draw.meshes.pop_back();
+    draw.commands_buffer_data.pop_back();
+    draw.meshes_render_info_data.pop_back();
+    if (index < draw.meshes.size()) {
+      _mesh_meshlets_data[draw.meshes[index]->_mesh_offset].draw_index = index;
+    }
+  }
+
+  auto &index_buffer = _parent->index_buffer();
+  for (auto &mesh : model->_meshes) {
+    _parent->delete_vertex_buffers(mesh._vbufs);
+    for (const auto &ibuf : mesh._ibufs) {
+      index_buffer.free(ibuf.offset);
+    }
+    if (not mesh._cluster_dag.empty()) {
+      index_buffer.free(mesh._cluster_ibuf.offset);
+    }
+    if (mesh._meshlets_number > 0) {
+      index_buffer.free(mesh._meshlets_ibuf.offset);
+    }
+    mesh._impostor.reset();
+  }
+
+  auto erase_range = [](auto &vector, uint32_t first, uint32_t count) {
+    vector.erase(vector.begin() + first, vector.begin() + first + count);
+  };
+  erase_range(_meshes, first_mesh, meshes_number);
+  erase_range(_bounds_data, first_mesh, meshes_number);
+  erase_range(_mesh_meshlets_data, first_mesh, meshes_number);
+  erase_range(_mesh_lods_data, first_mesh, meshes_number);
+  erase_range(_visibility_data, first_mesh, meshes_number);
+  _instances.erase(first_instance, instances_number, meshes_number);
+  if (meshlets_number > 0) {
+    erase_range(_meshlets_data, first_meshlet, meshlets_number);
+  }
+  _culler.remove_meshes(first_mesh, meshes_number);
+  _lod_selector.remove_meshes(first_mesh, meshes_number, first_instance, instances_number);
+  _occlusion_culler.remove_meshes(first_mesh, meshes_number, first_instance, instances_number);
+
+  for (auto *mesh : std::span(_meshes).subspan(first_mesh)) {
+    mesh->_mesh_offset -= meshes_number;
+    mesh->_instance_offset -= instances_number;
+    if (mesh->_meshlets_number > 0 && mesh->_first_meshlet > first_meshlet) {
+      mesh->_first_meshlet -= meshlets_number;
+    }
+  }
+
+  // Empty groups are removed, so their pipelines are released, indices of the rest stay in the same order
+  std::vector<MeshesWithSamePipeline *> draws;
+  for (auto it = _draws.begin(); it != _draws.end();) {
+    if (it->second.meshes.empty()) {
+      it = _draws.erase(it);
+    } else {
+      draws.push_back(&it->second);
+      ++it;
+    }
+  }
+  std::ranges::sort(draws, {}, &MeshesWithSamePipeline::index);
+
+  // Only groups which lost meshes or which meshes moved are uploaded again
+  for (uint32_t index = 0; index < draws.size(); index++) {
+    auto &draw = *draws[index];
+    bool changed = draw.index != index || draw.meshes.size() != draw.commands_buffer.size();
+    draw.index = index;
+    for (uint32_t i = 0; i < draw.meshes.size(); i++) {
+      const auto *mesh = draw.meshes[i];
+      auto &render_info = draw.meshes_render_info_data[i];
+      changed = changed || render_info.mesh_offset != mesh->_mesh_offset ||
+                render_info.instance_offset != mesh->_instance_offset;
+      render_info.mesh_offset = mesh->_mesh_offset;
+      render_info.instance_offset = mesh->_instance_offset;
+
+      auto &mesh_meshlets = _mesh_meshlets_data[mesh->_mesh_offset];
+      mesh_meshlets.first_meshlet = mesh->_first_meshlet;
+      mesh_meshlets.draw_group = index;
+      mesh_meshlets.draw_index = i;
+    }
+    if (changed) {
+      draw.changed = true;
+    }
+  }
+
+  // Arrays shrink with scene by next upload,
+  // previous frame visibility of shifted instances is retested by second culling phase
+
+  MR_INFO("Model removed: {} meshes, {} instances, {} meshlets", meshes_number, instances_number, meshlets_number);
+
+  // Materials and their textures release bindless slots when the last handle is released
+  model->_meshes.clear();
+  model->_materials.clear();
+  model->_builders.clear();
+  model->_gpu_bytes = 0;
+  model->_scene = nullptr;
+}
+
+std::future<mr::ModelHandle> mr::Scene::enqueue_create_model(std::string filename) noexcept
+{
+  CreateModelCommand command {.filename = std::move(filename)};
+  auto future = command.model.get_future();
+  enqueue(std::move(command));
+  return future;
+}
+
+std::future<mr::DirectionalLightHandle> mr::Scene::enqueue_create_directional_light(const Norm3f &direction,
+                                                                                  const Vec3f &color) noexcept
+{
+  CreateDirectionalLightCommand command {.direction = direction, .color = color};
+  auto future = command.light.get_future();
+  enqueue(std::move(command));
+  return future;
+}
+
+void mr::Scene::apply_commands() noexcept
+{
+  _command_stats = {};
+  if (_commands.empty()) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Frames in flight are waited once for all removals, scene arrays are uploaded once after all changes.
+  // Created models are returned after upload, so they are complete when their futures are ready
+  bool queue_idle = false;
+  auto wait_queue = [&] {
+    if (not queue_idle) {
+      _parent->vulkan_state().queue().waitIdle();
+      queue_idle = true;
+    }
+  };
+  bool structure_changed = false;
+  std::vector<std::pair<std::promise<ModelHandle>, ModelHandle>> created_models;
+
+  auto create_model = [&](CreateModelCommand &command) {
+    created_models.emplace_back(std::move(command.model), add_model(command.filename, std::move(command.imported)));
+    structure_changed = true;
+    _command_stats.created_models_number++;
+  };
+  auto remove_model = [&](RemoveModelCommand &command) {
+    wait_queue();
+    this->remove_model(command.model);
+    structure_changed = true;
+    _command_stats.removed_models_number++;
+  };
+  // Instances and nodes can be removed after command was pushed
+  auto set_transform = [&](SetTransformCommand &command) {
+    if (_instances.contains(command.instance)) {
+      this->set_transform(command.instance, command.transform);
+    }
+  };
+  auto set_local_transform = [&](SetLocalTransformCommand &command) {
+    if (_hierarchy.contains(command.node)) {
+      _hierarchy.set_local(command.node, command.local);
+    }
+  };
+  auto create_light = [&](CreateDirectionalLightCommand &command) {
+    command.light.set_value(create_directional_light(command.direction, command.color));
+  };
+  auto set_light = [&](SetDirectionalLightCommand &command) {
+    command.light->direction(command.direction);
+    command.light->color(command.color);
+  };
+  auto remove_light = [&](RemoveDirectionalLightCommand &command) {
+    wait_queue();
+    remove(command.light);
+  };
+
+  _command_stats.commands_number = _commands.consume([&](Command &&command) {
+    std::visit(Overloads {create_model, remove_model, set_transform, set_local_transform,
+                          create_light, set_light, remove_light}, command);
+  });
+
+  if (structure_changed) {
+    upload_scene_arrays();
+  }
+  for (auto &[promise, model] : created_models) {
+    promise.set_value(std::move(model));
+  }
+
+  _command_stats.apply_ms =
+    std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 void mr::Scene::update(OptionalInputStateReference input_state_ref) noexcept
 {
   ASSERT(_parent != nullptr);
 
-  _transforms.write(std::span(_transforms_data));
-  _bounds.write(std::span(_bounds_data));
-  _visibility.write(std::span(_visibility_data));
+  // Frame boundary: the render thread owns scene data here
+  apply_commands();
+  update_transforms();
 
   if (input_state_ref) {
     const auto &input_state = input_state_ref->get();
@@ -110,43 +489,307 @@ void mr::Scene::update(OptionalInputStateReference input_state_ref) noexcept
     };
 
     _camera.turn(angular_delta);
+    bool camera_changed = input_state.mouse_pos_delta().x() != 0 || input_state.mouse_pos_delta().y() != 0;
 
     // camera controls
     if (input_state.key_pressed(vkfw::Key::eW)) {
       _camera.move(_camera.cam().direction());
+      camera_changed = true;
     }
     if (input_state.key_pressed(vkfw::Key::eA)) {
       _camera.move(-_camera.cam().right());
+      camera_changed = true;
     }
     if (input_state.key_pressed(vkfw::Key::eS)) {
       _camera.move(-_camera.cam().direction());
+      camera_changed = true;
     }
     if (input_state.key_pressed(vkfw::Key::eD)) {
       _camera.move(_camera.cam().right());
+      camera_changed = true;
     }
     if (input_state.key_pressed(vkfw::Key::eSpace)) {
       _camera.move(_camera.cam().up());
+      camera_changed = true;
     }
     if (input_state.key_pressed(vkfw::Key::eLeftShift)) {
       _camera.move(_camera.cam().up());
+      camera_changed = true;
     }
     if (input_state.key_tapped(vkfw::Key::e1)) {
       _camera.cam() = mr::math::Camera<float>({1}, {-1}, {0, 1, 0});
       _camera.cam().projection() = mr::math::Camera<float>::Projection(45_deg);
+      camera_changed = true;
     }
     if (input_state.key_tapped(vkfw::Key::e2)) {
       _camera.cam() = mr::math::Camera<float>({10}, {-1}, {0, 1, 0});
       _camera.cam().projection() = mr::math::Camera<float>::Projection(45_deg);
+      camera_changed = true;
     }
     if (input_state.key_tapped(vkfw::Key::e3)) {
       _camera.cam() = mr::math::Camera<float>({100}, {-1}, {0, 1, 0});
       _camera.cam().projection() = mr::math::Camera<float>::Projection(45_deg);
+      camera_changed = true;
     }
+
+    // Camera keeps moving while keys are pressed, so on demand rendering continues
+    if (camera_changed) {
+      request_frame();
+    }
+  }
+
+  if (_streamer != nullptr) {
+    _streamer->update(_camera.cam().position());
   }
 
   update_camera_buffer();
 }
 
+void mr::Scene::set_transform(InstanceStore::Handle instance, const Matr4f &transform) noexcept
+{
+  move_instance(_instances.index(instance), transform);
+  request_frame();
+}
+
+void mr::Scene::set_transforms(std::span<const InstanceStore::Handle> instances,
+                               std::span<const Matr4f> transforms) noexcept
+{
+  ASSERT(instances.size() == transforms.size());
+  for (auto [instance, transform] : std::views::zip(instances, transforms)) {
+    move_instance(_instances.index(instance), transform);
+  }
+  request_frame();
+}
+
+void mr::Scene::set_transforms(uint32_t first_instance, std::span<const Matr4f> transforms) noexcept
+{
+  ASSERT(first_instance + transforms.size() <= _instances.size());
+  for (uint32_t i = 0; i < transforms.size(); i++) {
+    move_instance(first_instance + i, transforms[i]);
+  }
+  request_frame();
+}
+
+void mr::Scene::move_instance(uint32_t instance, const Matr4f &transform) noexcept
+{
+  _instances.transforms()[instance] = transform;
+  _culler.update_instance(instance, transform);
+  _occlusion_culler.update_instance(instance, transform);
+  _moved_instances.push_back(instance);
+  _moved_instances_staged = false;
+}
+
+void mr::Scene::update_transforms() noexcept
+{
+  _hierarchy.propagate();
+  for (const auto &update : _hierarchy.instance_updates()) {
+    // Node can outlive instance of removed model
+    if (not _instances.contains(update.instance)) {
+      continue;
+    }
+    Matr4f transform;
+    std::memcpy(&transform, update.transform->data(), sizeof(transform));
+    move_instance(_instances.index(update.instance), transform);
+  }
+
+  // Staging buffer of this frame isn't read by frame in flight, so it is filled before waiting for it
+  stage_transforms();
+}
+
+void mr::Scene::stage_transforms() noexcept
+{
+  std::ranges::sort(_moved_instances);
+  auto [first, last] = std::ranges::unique(_moved_instances);
+  _moved_instances.erase(first, last);
+
+  _transforms_upload.stage(_instances.transforms(), _moved_instances);
+  _moved_instances_staged = true;
+}
+
+bool mr::Scene::record_uploads(vk::CommandBuffer command_buffer) noexcept
+{
+  // Instances moved after update are staged here
+  if (not _moved_instances_staged) {
+    stage_transforms();
+  }
+  _moved_instances.clear();
+  return _transforms_upload.record(command_buffer, _transforms.buffer(),
+                                   vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexShader);
+}
+
+void mr::Scene::cull() noexcept
+{
+  // Instances are culled by compute shaders during models rendering
+  if (_gpu_culling) {
+    // Previous frame is finished, so its statistics are ready
+    std::memcpy(&_occlusion_stats, _culling_stats_readback.read().data(), sizeof(_occlusion_stats));
+
+    // LOD selection parameters are pushed to culling shader by recorded commands
+    std::array lod_parameters {_lod_selector.threshold(), _lod_selector.hysteresis()};
+    if (lod_parameters != _recorded_lod_parameters) {
+      _recorded_lod_parameters = lod_parameters;
+      structure_changed();
+    }
+    return;
+  }
+
+  _impostor_commands_data.clear();
+  _impostor_draws_data.clear();
+
+  auto viewproj = _camera.viewproj();
+  if (_software_occlusion_culling) {
+    // Occluders are rasterized while frustum culling runs, then visible instances are tested
+    tbb::parallel_invoke(
+      [this, &viewproj] { _culler.cull(viewproj); },
+      [this, &viewproj] { _occlusion_culler.rasterize(viewproj); });
+    _occlusion_culler.cull(_culler);
+  } else {
+    _culler.cull(viewproj);
+  }
+  if (_culler.stats().instances_number == 0) {
+    return;
+  }
+  if (_lod_selection) {
+    _lod_selector.select(viewproj, static_cast<float>(_parent->extent().height), _culler);
+  }
+  _visible_instances.assign(_culler.visible_instances());
+
+  auto projection = LodSelector::projection(viewproj, static_cast<float>(_parent->extent().height));
+  std::vector<uint32_t> selected_clusters;
+
+  // Depth of the nearest point of instances bounding spheres
+  auto instances_depth = [&](std::span<const uint32_t> instances) {
+    float depth = std::numeric_limits<float>::max();
+    for (auto instance : instances) {
+      auto center = _culler.instance_center(instance);
+      float w = projection.w_row[0] * center[0] + projection.w_row[1] * center[1] +
+                projection.w_row[2] * center[2] + projection.w_row[3];
+      depth = std::min(depth, w - _culler.instance_radius(instance));
+    }
+    return depth;
+  };
+
+  _draw_list.clear();
+  for (const auto &[pipeline, draw_ptr] : _draw_order) {
+    auto &draw = *draw_ptr;
+    draw.culled_commands_data.clear();
+    draw.culled_render_info_data.clear();
+
+    auto add_command = [&](const vk::DrawIndexedIndirectCommand &command, const Mesh::RenderInfo &render_info,
+                           std::span<const uint32_t> instances) {
+      uint32_t index = static_cast<uint32_t>(draw.culled_commands_data.size());
+      draw.culled_commands_data.emplace_back(command);
+      draw.culled_render_info_data.emplace_back(render_info);
+      _draw_list.add(DrawList::key(draw.index, render_info.material_ubo_id, instances_depth(instances)),
+                     {draw.index, index});
+    };
+
+    for (auto [mesh, command, render_info] :
+           std::views::zip(draw.meshes, draw.commands_buffer_data, draw.meshes_render_info_data)) {
+      uint32_t visible_count = _culler.visible_instances_number(mesh->_mesh_offset);
+      _visibility_data[mesh->_mesh_offset] = visible_count > 0;
+      if (visible_count == 0) {
+        continue;
+      }
+
+      // Impostor instances are sorted to the end of visible instances of mesh
+      uint32_t impostors_number = 0;
+      if (_lod_selection && mesh->_impostor) {
+        impostors_number = _lod_selector.impostors_number(mesh->_mesh_offset);
+      }
+      if (impostors_number > 0) {
+        _impostor_commands_data.emplace_back(vk::DrawIndexedIndirectCommand {
+          .indexCount = 6,
+          .instanceCount = impostors_number,
+          .firstIndex = 0,
+          .vertexOffset = 0,
+          .firstInstance = mesh->_instance_offset + visible_count - impostors_number,
+        });
+        _impostor_draws_data.emplace_back(
+          mesh->_impostor->draw_info(_camera_buffer_id, _transforms.id(), _visible_instances.id()));
+      }
+
+      // Each visible instance of mesh with cluster DAG draws its own cut of clusters
+      if (_lod_selection && not mesh->_cluster_dag.empty()) {
+        auto instances = _culler.visible_instances(mesh->_mesh_offset).first(visible_count - impostors_number);
+        const auto &dag = mesh->_cluster_dag;
+        for (uint32_t i = 0; i < instances.size(); i++) {
+          std::array<float, 16> transform;
+          std::memcpy(transform.data(), &_instances.transforms()[instances[i]], sizeof(transform));
+
+          selected_clusters.clear();
+          dag.select(transform, projection.w_row, projection.pixels_per_unit, _lod_selector.threshold(),
+                     selected_clusters);
+          for (auto cluster_index : selected_clusters) {
+            const auto &cluster = dag.clusters()[cluster_index];
+            auto culled_command = command;
+            culled_command.indexCount = cluster.index_count;
+            culled_command.firstIndex =
+              static_cast<uint32_t>(mesh->_cluster_ibuf.offset / sizeof(uint32_t)) + cluster.first_index;
+            culled_command.instanceCount = 1;
+            culled_command.firstInstance = mesh->_instance_offset + i;
+            add_command(culled_command, render_info, instances.subspan(i, 1));
+          }
+        }
+        continue;
+      }
+
+      LodSelector::LodCounts lod_counts {visible_count};
+      uint32_t lods_number = 1;
+      if (_lod_selection) {
+        lod_counts = _lod_selector.lod_counts(mesh->_mesh_offset);
+        lods_number = _lod_selector.lods_number(mesh->_mesh_offset);
+      }
+
+      // Visible instances of mesh are sorted by LOD, each LOD is separate command.
+      // Instance index starts from first instance, shader reads transform index of it from visible instances
+      auto visible_instances = _culler.visible_instances(mesh->_mesh_offset);
+      uint32_t first_instance = mesh->_instance_offset;
+      for (uint32_t lod = 0; lod < lods_number; lod++) {
+        if (lod_counts[lod] == 0) {
+          continue;
+        }
+        auto culled_command = command;
+        culled_command.indexCount = mesh->_ibufs[lod].elements_count;
+        culled_command.firstIndex = static_cast<uint32_t>(mesh->_ibufs[lod].offset / sizeof(uint32_t));
+        culled_command.instanceCount = lod_counts[lod];
+        culled_command.firstInstance = first_instance;
+        add_command(culled_command, render_info,
+                    visible_instances.subspan(first_instance - mesh->_instance_offset, lod_counts[lod]));
+        first_instance += lod_counts[lod];
+      }
+    }
+  }
+
+  // Commands of each group are reordered by sorted keys, groups are contiguous ranges of sorted draws
+  _draw_list.sort();
+  auto sorted_draws = _draw_list.draws();
+  for (uint32_t first = 0; first < sorted_draws.size();) {
+    auto &draw = *_draw_order[sorted_draws[first].group].second;
+    _sorted_commands_data.clear();
+    _sorted_render_info_data.clear();
+    uint32_t last = first;
+    for (; last < sorted_draws.size() && sorted_draws[last].group == draw.index; last++) {
+      _sorted_commands_data.emplace_back(draw.culled_commands_data[sorted_draws[last].command]);
+      _sorted_render_info_data.emplace_back(draw.culled_render_info_data[sorted_draws[last].command]);
+    }
+    std::swap(draw.culled_commands_data, _sorted_commands_data);
+    std::swap(draw.culled_render_info_data, _sorted_render_info_data);
+    first = last;
+  }
+
+  for (const auto &[pipeline, draw] : _draw_order) {
+    // Cluster draws can exceed reserved capacity, then arrays grow
+    draw->culled_commands_buffer.assign(std::span(draw->culled_commands_data));
+    draw->culled_render_info.assign(std::span(draw->culled_render_info_data));
+  }
+
+  _impostor_commands.assign(std::span(_impostor_commands_data));
+  _impostor_draws.assign(std::span(_impostor_draws_data));
+
+  _visibility.assign(std::span(_visibility_data));
+}
+
 void mr::Scene::update_camera_buffer() noexcept
 {
   mr::ShaderCameraData cam_data {
@@ -5,7 +5,17 @@
 #include "model/model.hpp"
 #include "manager/resource.hpp"
 #include "camera/camera.hpp"
+#include "scene/frustum_culler.hpp"
+#include "scene/occlusion_culler.hpp"
+#include "scene/lod_selector.hpp"
+#include "scene/instance_store.hpp"
+#include "scene/transform_hierarchy.hpp"
+#include "scene/command_queue.hpp"
+#include "scene/draw_list.hpp"
+#include "scene/world_streamer.hpp"
 #include "renderer/window/input_state.hpp"
+#include "resources/buffer/device_array.hpp"
+#include "resources/buffer/delta_upload.hpp"
 
 namespace mr {
 inline namespace graphics {
@@ -17,44 +27,243 @@ inline namespace graphics {
     friend class RenderContext;
     friend class Model;
 
+  public:
+    // Results of GPU occlusion culling of previous frame
+    struct OcclusionStats {
+      uint32_t tested_instances_number = 0;   // instances inside frustum
+      uint32_t occluded_instances_number = 0; // instances inside frustum rejected by depth pyramid
+
+      float rejection_rate() const noexcept
+      {
+        return tested_instances_number == 0 ? 0.f : float(occluded_instances_number) / tested_instances_number;
+      }
+    };
+
+    // Scene changes which can be requested by any thread, they are applied by render thread at frame boundary
+    struct CreateModelCommand {
+      std::string filename;
+      std::promise<ModelHandle> model;
+      // Data imported by producer thread, file is imported by render thread if it is null
+      std::shared_ptr<Model::Imported> imported;
+    };
+    struct RemoveModelCommand {
+      ModelHandle model;
+    };
+    struct SetTransformCommand {
+      InstanceStore::Handle instance;
+      Matr4f transform;
+    };
+    struct SetLocalTransformCommand {
+      TransformHierarchy::Node node;
+      Matr4f local;
+    };
+    struct CreateDirectionalLightCommand {
+      Norm3f direction = Norm3f(0, 1, 0);
+      Vec3f color = Vec3f(1.0);
+      std::promise<DirectionalLightHandle> light;
+    };
+    struct SetDirectionalLightCommand {
+      DirectionalLightHandle light;
+      Norm3f direction;
+      Vec3f color;
+    };
+    struct RemoveDirectionalLightCommand {
+      DirectionalLightHandle light;
+    };
+    using Command = std::variant<
+      CreateModelCommand,
+      RemoveModelCommand,
+      SetTransformCommand,
+      SetLocalTransformCommand,
+      CreateDirectionalLightCommand,
+      SetDirectionalLightCommand,
+      RemoveDirectionalLightCommand
+    >;
+
+    // Commands applied by last Scene::update
+    struct CommandStats {
+      uint32_t commands_number = 0;
+      uint32_t created_models_number = 0;
+      uint32_t removed_models_number = 0;
+      float apply_ms = 0;
+    };
+
   private:
     struct MeshesWithSamePipeline {
       std::vector<const Mesh *> meshes;
+      uint32_t index = 0; // index of draws group, position of its draws number in draw counts buffer
+      bool changed = false; // commands and render info are uploaded by next 'upload_scene_arrays'
 
-      // TODO(dk6): Make them dynamic sizable VectorBuffer
-      StorageBuffer commands_buffer;
+      DeviceArray<vk::DrawIndexedIndirectCommand> commands_buffer;
       std::vector<vk::DrawIndexedIndirectCommand> commands_buffer_data;
 
-      StorageBuffer meshes_render_info; // render data for each mesh
+      DeviceArray<Mesh::RenderInfo> meshes_render_info; // render data for each mesh
       std::vector<Mesh::RenderInfo> meshes_render_info_data;
-      uint32_t meshes_render_info_id = -1;
+
+      // Commands and render data of meshes which have visible instances.
+      // Written by culling compute shader or uploaded from CPU culling results each frame.
+      // Capacity is reserved for GPU culling: command for each LOD of each mesh and commands of visible meshlets
+      DeviceArray<vk::DrawIndexedIndirectCommand> culled_commands_buffer;
+      DeviceArray<Mesh::RenderInfo> culled_render_info;
+
+      // CPU culling results
+      std::vector<vk::DrawIndexedIndirectCommand> culled_commands_data;
+      std::vector<Mesh::RenderInfo> culled_render_info_data;
+    };
+
+    // Meshlets of mesh and draws group their commands are appended to, layout is the same as in culling shaders
+    struct MeshMeshlets {
+      uint32_t first_meshlet = 0;
+      uint32_t meshlets_number = 0; // 0 if mesh is culled only as whole
+      uint32_t draw_group = 0;
+      uint32_t commands_buffer_id = 0;
+      uint32_t render_info_buffer_id = 0;
+      uint32_t culled_commands_buffer_id = 0;
+      uint32_t culled_render_info_buffer_id = 0;
+      uint32_t draw_index = 0; // index of mesh command in draws group
+      uint32_t culled_commands_capacity = 0; // of draws group culled commands
+      uint32_t instances_number = 0;
+      uint32_t meshlet_draws_capacity = 0; // of draws group, part of culled commands capacity
+    };
+
+    // LODs of mesh for LOD selection by instances culling shader, layout is the same as in culling shaders.
+    // Errors are the same as in LodSelector, so both culling paths switch LODs at the same distances
+    struct MeshLods {
+      uint32_t lods_number = 1;
+      float radius = 0; // bounding sphere radius in mesh space
+      std::array<float, LodSelector::max_lods> errors {};
+      std::array<uint32_t, LodSelector::max_lods> first_indices {};
+      std::array<uint32_t, LodSelector::max_lods> index_counts {};
+    };
+
+    // Visible instance of mesh with meshlets which crosses frustum planes, one workgroup of meshlets culling for each
+    struct MeshletTask {
+      uint32_t visible_instance; // index in visible instances buffer
+      uint32_t mesh;
     };
 
+    // vk::DispatchIndirectCommand for meshlets culling, tasks are after it
+    struct MeshletTasksHeader {
+      uint32_t x, y, z;
+      uint32_t _padding;
+    };
+    // Header takes first elements of tasks array
+    static inline constexpr uint32_t meshlet_tasks_header_size = sizeof(MeshletTasksHeader) / sizeof(MeshletTask);
+    static_assert(sizeof(MeshletTasksHeader) % sizeof(MeshletTask) == 0);
+
   private:
-    static inline constexpr int max_scene_instances = 64000;
+    // Bound of meshlet commands of draws group written by GPU culling. Instances crossing frustum planes
+    // reserve draws of all their meshlets, instances which don't fit in it are drawn by whole mesh command
+    static inline constexpr uint32_t max_group_meshlet_draws = 1 << 16;
+    // Visible instances counts of mesh written by GPU culling: one for each LOD and one for meshlet tasks
+    static inline constexpr uint32_t mesh_visible_counts_stride = LodSelector::max_lods + 1;
+    // Front-to-back depth buckets of commands of draws group sorted by GPU culling, each is half octave of depth
+    static inline constexpr uint32_t depth_buckets_number = 64;
 
   private:
     RenderContext *_parent = nullptr;
 
     // One array for each light type
-    // TODO(mt6): Maybe use https://github.com/rollbear/columnist or https://github.com/skypjack/entt here
     std::tuple<
       SmallVector<DirectionalLightHandle>
     > _lights;
 
+    CommandQueue<Command> _commands;
+    CommandStats _command_stats;
+
+    // Loads and unloads cells of world around camera by commands, so it is destroyed before commands queue
+    std::unique_ptr<WorldStreamer> _streamer;
+
+    // Changed by changes of scene which outdate recorded rendering commands
+    uint64_t _structure_version = 0;
+
+    // Counter of frame requests, render loop in on demand mode waits for its change.
+    // Not movable atomic is stored in heap to keep scene movable
+    std::unique_ptr<std::atomic_uint64_t> _frame_requests = std::make_unique<std::atomic_uint64_t>(1);
+
     SmallVector<ModelHandle> _models;
+    std::vector<Mesh *> _meshes; // for each mesh, their offsets are fixed up when models are removed
     boost::unordered_map<GraphicsPipelineHandle, MeshesWithSamePipeline> _draws;
+    // Draws groups in order of their indices, it is order of pipelines in draw list keys
+    std::vector<std::pair<GraphicsPipelineHandle, MeshesWithSamePipeline *>> _draw_order;
+    // Culled commands of CPU culling sorted by pipeline, material and depth
+    DrawList _draw_list;
+    std::vector<vk::DrawIndexedIndirectCommand> _sorted_commands_data;
+    std::vector<Mesh::RenderInfo> _sorted_render_info_data;
+
+    // Columns of instances data, GPU arrays of instances are uploaded from them
+    InstanceStore _instances;
+    // Nodes bound to instances set their transforms
+    TransformHierarchy _hierarchy;
 
-    StorageBuffer _transforms; // transform matrix    for each instance
-    std::vector<mr::Matr4f> _transforms_data;
-    uint32_t _transforms_buffer_id;  // id in bindless descriptor set
+    DeviceArray<mr::Matr4f> _transforms; // transform matrix    for each instance
+    // Instances moved since last upload, only their transforms are copied by the next frame
+    std::vector<uint32_t> _moved_instances;
+    bool _moved_instances_staged = true;
+    DeltaUpload<mr::Matr4f> _transforms_upload;
 
-    StorageBuffer _bounds;     // AABB                for each instance
-    std::vector<mr::AABBf> _bounds_data;
+    DeviceArray<FrustumCuller::BoundBox> _bounds; // local space AABB    for each mesh
+    std::vector<FrustumCuller::BoundBox> _bounds_data;
 
-    ConditionalBuffer _visibility; // u32 visibility mask for each draw call
+    DeviceArray<InstanceStore::MeshRef> _instance_meshes; // mesh and its first instance for each instance
+
+    DeviceArray<Meshlets::Meshlet> _meshlets; // meshlets of all meshes
+    std::vector<Meshlets::Meshlet> _meshlets_data;
+
+    DeviceArray<MeshMeshlets> _mesh_meshlets; // for each mesh
+    std::vector<MeshMeshlets> _mesh_meshlets_data;
+
+    // MeshletTasksHeader and MeshletTask list, appended by instances culling
+    DeviceArray<MeshletTask> _meshlet_tasks;
+
+    DeviceArray<MeshLods> _mesh_lods; // for each mesh
+    std::vector<MeshLods> _mesh_lods_data;
+
+    ConditionalArray<uint32_t> _visibility; // u32 visibility mask for each draw call
     std::vector<uint32_t> _visibility_data;
 
+    FrustumCuller _culler;
+    OcclusionCuller _occlusion_culler;
+    // CPU occlusion culling, works only with CPU culling
+    bool _software_occlusion_culling = false;
+    LodSelector _lod_selector;
+    // LOD selection by screen space error, cluster DAG cuts are selected only by CPU culling
+    bool _lod_selection = true;
+    // Threshold and hysteresis of LOD selector recorded into GPU culling commands
+    std::array<float, 2> _recorded_lod_parameters {};
+    // Far instances of meshes with impostors, selected with LODs and drawn after meshes
+    bool _impostors = true;
+    DeviceArray<vk::DrawIndexedIndirectCommand> _impostor_commands; // one command for impostor instances of each mesh
+    std::vector<vk::DrawIndexedIndirectCommand> _impostor_commands_data;
+    DeviceArray<Impostor::DrawInfo> _impostor_draws; // for each command
+    std::vector<Impostor::DrawInfo> _impostor_draws_data;
+    // Transform index for each visible instance, compacted per mesh.
+    // GPU culling compacts instances of each LOD to its own copy of instances ranges,
+    // copies follow each other with stride of instances number
+    DeviceArray<uint32_t> _visible_instances;
+    uint32_t _visible_lods_number = 1; // max LODs number of scene meshes
+
+    // GPU culling counters, cleared each frame
+    DeviceArray<uint32_t> _mesh_visible_counts; // visible instances number for each LOD of each mesh
+    DeviceArray<uint32_t> _draw_counts;         // draws number for each pipeline, used by drawIndexedIndirectCount
+    DeviceArray<uint32_t> _meshlet_draw_counts; // meshlet draws reserved by meshlet tasks for each pipeline
+    DeviceArray<uint32_t> _mesh_depths;         // float bits of the nearest visible instance depth of each mesh
+    // Commands number and write cursor of each depth bucket of each pipeline
+    DeviceArray<uint32_t> _depth_bucket_counts;
+
+    // Occlusion culling data
+    DeviceArray<uint32_t> _instance_visibility; // u32 visibility in previous frame for each instance
+    DeviceArray<uint32_t> _instance_lods;       // LOD selected in previous frame for each instance, for hysteresis
+    StorageBuffer _culling_stats;       // OcclusionStats accumulated by culling shader
+    uint32_t _culling_stats_buffer_id;  // id in bindless descriptor set
+    HostBuffer _culling_stats_readback;
+    OcclusionStats _occlusion_stats;
+
+    // Culling by compute shaders instead of FrustumCuller
+    bool _gpu_culling = true;
+    // Two-phase culling by depth pyramid, works only with GPU culling
+    bool _occlusion_culling = true;
+
     mutable UniformBuffer _camera_uniform_buffer;
     mr::FPSCamera _camera;
     uint32_t _camera_buffer_id;  // id in bindless descriptor set
@@ -75,17 +284,50 @@ inline namespace graphics {
       lights<L>().erase(std::ranges::find(lights<L>(), light));
     }
 
-    void remove(ModelHandle model)
+    // Frees GPU memory and bindless slots of model and compacts scene data,
+    // offsets of next models' meshes are shifted. Model handle is left empty
+    void remove(ModelHandle model) noexcept;
+
+    // Thread safe, commands are applied in order of pushes by next Scene::update.
+    // Creation and removal commands of one frame share one upload of scene arrays
+    void enqueue(Command command) noexcept
+    {
+      _commands.push(std::move(command));
+      request_frame();
+    }
+    std::future<ModelHandle> enqueue_create_model(std::string filename) noexcept;
+    std::future<DirectionalLightHandle> enqueue_create_directional_light(const Norm3f &direction = Norm3f(0, 1, 0),
+                                                                         const Vec3f &color = Vec3f(1.0)) noexcept;
+    const CommandStats & command_stats() const noexcept { return _command_stats; }
+
+    // Models of world are streamed by cells around camera position updated by Scene::update.
+    // Models are added to streamer instead of creation by 'create_model'
+    WorldStreamer & stream_world(const WorldStreamer::Options &options = {}) noexcept
+    {
+      _streamer = std::make_unique<WorldStreamer>(*this, options);
+      return *_streamer;
+    }
+    WorldStreamer * streamer() noexcept { return _streamer.get(); }
+    const WorldStreamer * streamer() const noexcept { return _streamer.get(); }
+
+    // Thread safe, wakes render loop waiting for frame request. Called by scene changes and camera movement,
+    // changes of hierarchy or lights made directly outside of render loop must be followed by it
+    void request_frame() noexcept
+    {
+      _frame_requests->fetch_add(1, std::memory_order_release);
+      _frame_requests->notify_all();
+    }
+    uint64_t frame_requests() const noexcept { return _frame_requests->load(std::memory_order_acquire); }
+    // Blocks until frame requests number differs from 'handled'
+    void wait_frame_request(uint64_t handled) const noexcept
     {
-      // TODO(dk6): Also we must delete from _draws array...
-      _models.erase(std::ranges::find(_models, model));
-      MR_WARNING(
-        "mr::Scene::remove(ModelHandle) wastes 84 bytes on CPU."
-        "To fix this you would need to recompute offset values for all other models in the scene."
-        "Currently we don't have that functionality :("
-      );
+      _frame_requests->wait(handled, std::memory_order_acquire);
     }
 
+    // Recorded rendering commands of scene are recorded again by next frame,
+    // e.g. after changes of materials pipelines. Models creation and removal call it
+    void structure_changed() noexcept { _structure_version++; }
+
     Scene(Scene &&) = default;
     Scene & operator=(Scene &&) = default;
 
@@ -99,11 +341,69 @@ inline namespace graphics {
     using OptionalInputStateReference = std::optional<std::reference_wrapper<const InputState>>;
     void update(OptionalInputStateReference input_state = std::nullopt) noexcept;
 
-    uint32_t transforms_buffer_id() const noexcept { return _transforms_buffer_id; }
+    uint32_t transforms_buffer_id() const noexcept { return _transforms.id(); }
     uint32_t camera_buffer_id() const noexcept { return _camera_buffer_id; }
 
+    FrustumCuller & culler() noexcept { return _culler; }
+    const FrustumCuller & culler() const noexcept { return _culler; }
+
+    // CPU culling is used if GPU culling is disabled, contribution culling is supported only by it.
+    // Cluster DAGs are built only for models created while GPU culling is disabled
+    void gpu_culling(bool enable) noexcept { _gpu_culling = enable; _structure_version++; }
+    bool gpu_culling() const noexcept { return _gpu_culling; }
+    OcclusionCuller & occlusion_culler() noexcept { return _occlusion_culler; }
+    const OcclusionCuller & occlusion_culler() const noexcept { return _occlusion_culler; }
+    void software_occlusion_culling(bool enable) noexcept { _software_occlusion_culling = enable; }
+    bool software_occlusion_culling() const noexcept { return _software_occlusion_culling; }
+
+    LodSelector & lod_selector() noexcept { return _lod_selector; }
+    const LodSelector & lod_selector() const noexcept { return _lod_selector; }
+    void lod_selection(bool enable) noexcept { _lod_selection = enable; _structure_version++; }
+    bool lod_selection() const noexcept { return _lod_selection; }
+
+    // Impostors are baked for models created while enabled and GPU culling is disabled,
+    // they work only with CPU culling and LOD selection
+    void impostors(bool enable) noexcept { _impostors = enable; }
+    bool impostors() const noexcept { return _impostors; }
+
+    void occlusion_culling(bool enable) noexcept { _occlusion_culling = enable; _structure_version++; }
+    bool occlusion_culling() const noexcept { return _occlusion_culling; }
+    const OcclusionStats & occlusion_stats() const noexcept { return _occlusion_stats; }
+    uint32_t instances_number() const noexcept { return _instances.size(); }
+    const InstanceStore & instances() const noexcept { return _instances; }
+
+    // Transform is uploaded by next rendered frame, nodes of hierarchy bound to instance override it
+    void set_transform(InstanceStore::Handle instance, const Matr4f &transform) noexcept;
+    void set_transforms(std::span<const InstanceStore::Handle> instances, std::span<const Matr4f> transforms) noexcept;
+    // Transforms of instances range in store
+    void set_transforms(uint32_t first_instance, std::span<const Matr4f> transforms) noexcept;
+    const DeltaUpload<mr::Matr4f>::Stats & transforms_upload_stats() const noexcept
+    {
+      return _transforms_upload.stats();
+    }
+
+    TransformHierarchy & hierarchy() noexcept { return _hierarchy; }
+    const TransformHierarchy & hierarchy() const noexcept { return _hierarchy; }
+
   private:
+    // Model is added to scene data, GPU arrays are written by 'upload_scene_arrays'
+    ModelHandle add_model(std::string_view filename, std::shared_ptr<Model::Imported> imported = nullptr) noexcept;
+    // Frames in flight must be finished
+    void remove_model(ModelHandle model) noexcept;
+    void upload_scene_arrays() noexcept;
+    void apply_commands() noexcept;
     void update_camera_buffer() noexcept;
+    // Propagates transform hierarchy and stages transforms of moved instances
+    void update_transforms() noexcept;
+    void move_instance(uint32_t instance, const Matr4f &transform) noexcept;
+    void stage_transforms() noexcept;
+    // Records copies of staged transforms, called by RenderContext before culling and drawing.
+    // Returns false if nothing is recorded
+    bool record_uploads(vk::CommandBuffer command_buffer) noexcept;
+    // Capacities of arrays which are written by GPU culling follow scene size
+    void reserve_culling_arrays() noexcept;
+    // Cull instances by camera and rebuild draw commands, called by RenderContext before rendering
+    void cull() noexcept;
   };
 
   MR_DECLARE_HANDLE(Scene);
@@ -0,0 +1,47 @@
+#ifndef __MR_SIMD_HPP_
+#define __MR_SIMD_HPP_
+
+#include "pch.hpp"
+
+#ifdef MR_ENABLE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// AVX2 code paths of CPU culling are compiled without AVX2 flags for whole target and are selected
+// at runtime, so binaries still run on CPUs without AVX2. Functions with AVX2 intrinsics are marked
+// by MR_AVX2 and are called only if 'has_avx2()' is true
+#if defined(MR_ENABLE_AVX2) && not defined(_MSC_VER)
+#define MR_AVX2 __attribute__((target("avx2")))
+#else
+#define MR_AVX2
+#endif
+
+namespace mr {
+inline namespace graphics {
+  inline bool has_avx2() noexcept
+  {
+#ifdef MR_ENABLE_AVX2
+    static const bool supported = [] {
+#ifdef _MSC_VER
+      // YMM registers must also be saved by OS
+      std::array<int, 4> registers;
+      __cpuid(registers.data(), 1);
+      bool ymm_saved = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+      __cpuidex(registers.data(), 7, 0);
+      return ymm_saved && (registers[1] & (1 << 5)) != 0;
+#else
+      return __builtin_cpu_supports("avx2");
+#endif
+    }();
+    return supported;
+#else
+    return false;
+#endif
+  }
+}
+} // namespace mr
+
+#endif // __MR_SIMD_HPP_
@@ -0,0 +1,258 @@
+#include "scene/transform_hierarchy.hpp"
+
+#include <tbb/parallel_for.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+static std::array<float, 16> to_floats(const mr::Matr4f &matrix) noexcept
+{
+  static_assert(sizeof(mr::Matr4f) == 16 * sizeof(float));
+  std::array<float, 16> data;
+  std::memcpy(data.data(), &matrix, sizeof(data));
+  return data;
+}
+
+static mr::Matr4f from_floats(const std::array<float, 16> &data) noexcept
+{
+  mr::Matr4f matrix;
+  std::memcpy(&matrix, data.data(), sizeof(data));
+  return matrix;
+}
+
+// Row i of result is sum of rows of 'local' weighted by row i of 'parent', so local transform is applied first
+static void multiply(const std::array<float, 16> &parent, const std::array<float, 16> &local,
+                     std::array<float, 16> &result) noexcept
+{
+#ifdef __SSE__
+  __m128 rows[4] {
+    _mm_loadu_ps(&local[0]), _mm_loadu_ps(&local[4]), _mm_loadu_ps(&local[8]), _mm_loadu_ps(&local[12]),
+  };
+  for (int i = 0; i < 4; i++) {
+    __m128 row = _mm_mul_ps(_mm_set1_ps(parent[4 * i + 0]), rows[0]);
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(parent[4 * i + 1]), rows[1]));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(parent[4 * i + 2]), rows[2]));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(parent[4 * i + 3]), rows[3]));
+    _mm_storeu_ps(&result[4 * i], row);
+  }
+#else
+  for (int i = 0; i < 4; i++) {
+    for (int k = 0; k < 4; k++) {
+      result[4 * i + k] = parent[4 * i + 0] * local[k] + parent[4 * i + 1] * local[4 + k] +
+                          parent[4 * i + 2] * local[8 + k] + parent[4 * i + 3] * local[12 + k];
+    }
+  }
+#endif
+}
+
+mr::TransformHierarchy::Node mr::TransformHierarchy::add(Node parent, const Matr4f &local,
+                                                         InstanceStore::Handle instance) noexcept
+{
+  uint32_t level = 0;
+  uint32_t parent_index = 0;
+  if (parent != no_node) {
+    ASSERT(contains(parent), "Parent node was removed", parent);
+    level = _locations[parent].level + 1;
+    parent_index = _locations[parent].index;
+  }
+  if (_levels.size() <= level) {
+    _levels.resize(level + 1);
+  }
+
+  Node node;
+  if (not _free_nodes.empty()) {
+    node = _free_nodes.back();
+    _free_nodes.pop_back();
+  } else {
+    node = static_cast<Node>(_locations.size());
+    _locations.emplace_back();
+  }
+
+  auto &nodes = _levels[level];
+  _locations[node] = {level, static_cast<uint32_t>(nodes.nodes.size())};
+  nodes.locals.emplace_back(to_floats(local));
+  nodes.worlds.emplace_back();
+  nodes.parents.emplace_back(parent_index);
+  nodes.dirty.emplace_back(1);
+  nodes.updated.emplace_back(0);
+  nodes.instances.emplace_back(instance);
+  nodes.nodes.emplace_back(node);
+  _dirty_number++;
+
+  return node;
+}
+
+void mr::TransformHierarchy::remove(Node node) noexcept
+{
+  ASSERT(contains(node), "Node was already removed", node);
+
+  // Subtree is removed by compaction, children of removed nodes are skipped there
+  auto [level, index] = _locations[node];
+  _levels[level].nodes[index] = no_node;
+  _levels[level].instances[index] = {};
+  _locations[node].level = no_node;
+  _free_nodes.push_back(node);
+  _has_removed = true;
+}
+
+void mr::TransformHierarchy::set_local(Node node, const Matr4f &local) noexcept
+{
+  ASSERT(contains(node), "Node was removed", node);
+
+  auto [level, index] = _locations[node];
+  _levels[level].locals[index] = to_floats(local);
+  if (not _levels[level].dirty[index]) {
+    _levels[level].dirty[index] = 1;
+    _dirty_number++;
+  }
+}
+
+void mr::TransformHierarchy::bind(Node node, InstanceStore::Handle instance) noexcept
+{
+  ASSERT(contains(node), "Node was removed", node);
+
+  // Instance gets transform of node by next propagation
+  auto [level, index] = _locations[node];
+  _levels[level].instances[index] = instance;
+  if (not _levels[level].dirty[index]) {
+    _levels[level].dirty[index] = 1;
+    _dirty_number++;
+  }
+}
+
+mr::Matr4f mr::TransformHierarchy::local(Node node) const noexcept
+{
+  ASSERT(contains(node), "Node was removed", node);
+  auto [level, index] = _locations[node];
+  return from_floats(_levels[level].locals[index]);
+}
+
+mr::Matr4f mr::TransformHierarchy::world(Node node) const noexcept
+{
+  ASSERT(contains(node), "Node was removed", node);
+  auto [level, index] = _locations[node];
+  return from_floats(_levels[level].worlds[index]);
+}
+
+void mr::TransformHierarchy::compact() noexcept
+{
+  // Node is kept if it and its parent are kept, so removed subtrees are dropped level by level
+  std::vector<uint32_t> remap;
+  std::vector<uint32_t> parent_remap;
+  for (uint32_t level = 0; level < _levels.size(); level++) {
+    auto &nodes = _levels[level];
+    remap.assign(nodes.nodes.size(), no_node);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < nodes.nodes.size(); i++) {
+      Node node = nodes.nodes[i];
+      bool parent_kept = level == 0 || parent_remap[nodes.parents[i]] != no_node;
+      if (node == no_node) {
+        continue;
+      }
+      if (not parent_kept) {
+        _locations[node].level = no_node;
+        _free_nodes.push_back(node);
+        continue;
+      }
+
+      remap[i] = kept;
+      _locations[node].index = kept;
+      nodes.locals[kept] = nodes.locals[i];
+      nodes.worlds[kept] = nodes.worlds[i];
+      nodes.parents[kept] = level == 0 ? 0 : parent_remap[nodes.parents[i]];
+      nodes.dirty[kept] = nodes.dirty[i];
+      nodes.updated[kept] = nodes.updated[i];
+      nodes.instances[kept] = nodes.instances[i];
+      nodes.nodes[kept] = node;
+      kept++;
+    }
+
+    nodes.locals.resize(kept);
+    nodes.worlds.resize(kept);
+    nodes.parents.resize(kept);
+    nodes.dirty.resize(kept);
+    nodes.updated.resize(kept);
+    nodes.instances.resize(kept);
+    nodes.nodes.resize(kept);
+    std::swap(remap, parent_remap);
+  }
+
+  while (not _levels.empty() && _levels.back().nodes.empty()) {
+    _levels.pop_back();
+  }
+  _dirty_number = 0;
+  for (const auto &nodes : _levels) {
+    _dirty_number += std::reduce(nodes.dirty.begin(), nodes.dirty.end(), 0u);
+  }
+  _has_removed = false;
+}
+
+void mr::TransformHierarchy::propagate_level(uint32_t level, uint32_t first, uint32_t last,
+                                             std::vector<InstanceUpdate> &updates) noexcept
+{
+  auto &nodes = _levels[level];
+  const Level *parents = level > 0 ? &_levels[level - 1] : nullptr;
+
+  for (uint32_t i = first; i < last; i++) {
+    bool updated = nodes.dirty[i] || (parents != nullptr && parents->updated[nodes.parents[i]]);
+    nodes.updated[i] = updated;
+    if (not updated) {
+      continue;
+    }
+    nodes.dirty[i] = 0;
+
+    if (parents != nullptr) {
+      multiply(parents->worlds[nodes.parents[i]], nodes.locals[i], nodes.worlds[i]);
+    } else {
+      nodes.worlds[i] = nodes.locals[i];
+    }
+    if (nodes.instances[i] != InstanceStore::Handle {}) {
+      updates.emplace_back(InstanceUpdate {nodes.instances[i], &nodes.worlds[i]});
+    }
+  }
+}
+
+void mr::TransformHierarchy::propagate() noexcept
+{
+  auto start = std::chrono::steady_clock::now();
+
+  if (_has_removed) {
+    compact();
+  }
+
+  _instance_updates.clear();
+  _stats.updated_nodes_number = 0;
+  _stats.nodes_number = static_cast<uint32_t>(_locations.size() - _free_nodes.size());
+  _stats.levels_number = static_cast<uint32_t>(_levels.size());
+  if (_dirty_number == 0) {
+    _stats.propagation_ms = 0;
+    return;
+  }
+
+  for (auto &updates : _thread_updates) {
+    updates.clear();
+  }
+  for (uint32_t level = 0; level < _levels.size(); level++) {
+    uint32_t nodes_number = static_cast<uint32_t>(_levels[level].nodes.size());
+    if (nodes_number < parallel_level_size) {
+      propagate_level(level, 0, nodes_number, _thread_updates.local());
+    } else {
+      tbb::parallel_for(tbb::blocked_range<uint32_t>(0, nodes_number, parallel_level_size / 4),
+        [&](const tbb::blocked_range<uint32_t> &range) {
+          propagate_level(level, range.begin(), range.end(), _thread_updates.local());
+        });
+    }
+  }
+  _dirty_number = 0;
+
+  for (const auto &updates : _thread_updates) {
+    _instance_updates.insert(_instance_updates.end(), updates.begin(), updates.end());
+  }
+  for (const auto &nodes : _levels) {
+    _stats.updated_nodes_number += std::reduce(nodes.updated.begin(), nodes.updated.end(), 0u);
+  }
+
+  _stats.propagation_ms =
+    std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,101 @@
+#ifndef __MR_TRANSFORM_HIERARCHY_HPP_
+#define __MR_TRANSFORM_HIERARCHY_HPP_
+
+#include "pch.hpp"
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include "scene/instance_store.hpp"
+
+namespace mr {
+inline namespace graphics {
+  // Tree of transforms: world transform of node is world transform of its parent multiplied by its local one.
+  // Nodes are stored as columns of depth levels, parent of node is index in previous level, so levels are
+  // propagated in order and nodes of each level are processed by TBB workers in parallel.
+  // Only nodes which local transform or world transform of parent changed are recomputed.
+  // Node can be bound to scene instance, then its world transform is reported as instance transform.
+  // Matrices are multiplied as raw floats in the same layout as shaders read them
+  class TransformHierarchy {
+  public:
+    using Node = uint32_t;
+    static inline constexpr Node no_node = std::numeric_limits<uint32_t>::max();
+
+    // Levels with less nodes are propagated by one thread
+    static inline constexpr uint32_t parallel_level_size = 4096;
+
+    // World transform is raw floats of matrix, it is valid until hierarchy is changed
+    struct InstanceUpdate {
+      InstanceStore::Handle instance;
+      const std::array<float, 16> *transform;
+    };
+
+    struct Stats {
+      uint32_t nodes_number = 0;
+      uint32_t levels_number = 0;
+      uint32_t updated_nodes_number = 0; // by last propagation
+      float propagation_ms = 0;
+    };
+
+  private:
+    struct Level {
+      std::vector<std::array<float, 16>> locals;
+      std::vector<std::array<float, 16>> worlds;
+      std::vector<uint32_t> parents;  // index in previous level
+      std::vector<uint8_t> dirty;     // local transform was changed
+      std::vector<uint8_t> updated;   // world transform was changed by last propagation
+      std::vector<InstanceStore::Handle> instances;
+      std::vector<Node> nodes;
+    };
+
+    struct Location {
+      uint32_t level;
+      uint32_t index;
+    };
+
+    std::vector<Level> _levels;
+    std::vector<Location> _locations; // for each node, 'no_node' level for free ones
+    std::vector<Node> _free_nodes;
+    uint32_t _dirty_number = 0;
+    bool _has_removed = false;        // levels are compacted by next propagation
+
+    std::vector<InstanceUpdate> _instance_updates;
+    // Updates found by each worker, kept between propagations to reuse memory
+    tbb::enumerable_thread_specific<std::vector<InstanceUpdate>> _thread_updates;
+
+    Stats _stats;
+
+  public:
+    TransformHierarchy() = default;
+
+    TransformHierarchy(TransformHierarchy &&) noexcept = default;
+    TransformHierarchy & operator=(TransformHierarchy &&) noexcept = default;
+
+    // Root node if 'parent' is 'no_node'
+    Node add(Node parent, const Matr4f &local, InstanceStore::Handle instance = {}) noexcept;
+    // Removes node with its subtree
+    void remove(Node node) noexcept;
+
+    void set_local(Node node, const Matr4f &local) noexcept;
+    void bind(Node node, InstanceStore::Handle instance) noexcept;
+
+    bool contains(Node node) const noexcept { return node < _locations.size() && _locations[node].level != no_node; }
+    Matr4f local(Node node) const noexcept;
+    // Valid after propagation
+    Matr4f world(Node node) const noexcept;
+
+    // Recomputes world transforms of changed subtrees
+    void propagate() noexcept;
+    // Instances of nodes which world transform was changed by last propagation, in no particular order
+    std::span<const InstanceUpdate> instance_updates() const noexcept { return _instance_updates; }
+
+    const Stats & stats() const noexcept { return _stats; }
+
+  private:
+    void compact() noexcept;
+    void propagate_level(uint32_t level, uint32_t first, uint32_t last,
+                         std::vector<InstanceUpdate> &updates) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_TRANSFORM_HIERARCHY_HPP_
@@ -0,0 +1,245 @@
+#include "scene/world_streamer.hpp"
+#include "scene/scene.hpp"
+#include "renderer/window/render_context.hpp"
+
+// Grid coordinates are packed by 21 bits
+static uint64_t cell_key(const std::array<float, 3> &point, float cell_size) noexcept
+{
+  constexpr int64_t coordinate_offset = 1 << 20;
+  constexpr uint64_t coordinate_mask = (1 << 21) - 1;
+
+  uint64_t key = 0;
+  for (float coordinate : point) {
+    auto cell = static_cast<int64_t>(std::floor(coordinate / cell_size)) + coordinate_offset;
+    key = (key << 21) | (static_cast<uint64_t>(std::clamp<int64_t>(cell, 0, coordinate_mask)));
+  }
+  return key;
+}
+
+static float distance(const mr::FrustumCuller::BoundBox &bounds, const std::array<float, 3> &point) noexcept
+{
+  float distance2 = 0;
+  for (int i = 0; i < 3; i++) {
+    float outside = std::max({bounds.min[i] - point[i], point[i] - bounds.max[i], 0.f});
+    distance2 += outside * outside;
+  }
+  return std::sqrt(distance2);
+}
+
+mr::WorldStreamer::WorldStreamer(Scene &scene, const Options &options) noexcept
+  : _scene(&scene)
+  , _options(options)
+{
+  ASSERT(_options.cell_size > 0);
+  ASSERT(_options.load_radius <= _options.unload_radius, "Cells would be unloaded right after loading",
+         _options.load_radius, _options.unload_radius);
+}
+
+mr::WorldStreamer::~WorldStreamer()
+{
+  // Commands of finished imports stay in scene queue, models of loaded cells are released with scene
+  _stopping = true;
+  for (auto &import : _imports) {
+    import.wait();
+  }
+}
+
+void mr::WorldStreamer::add_model(std::string filename, const FrustumCuller::BoundBox &bounds) noexcept
+{
+  std::array<float, 3> center {
+    (bounds.min[0] + bounds.max[0]) * 0.5f,
+    (bounds.min[1] + bounds.max[1]) * 0.5f,
+    (bounds.min[2] + bounds.max[2]) * 0.5f,
+  };
+  uint64_t key = cell_key(center, _options.cell_size);
+
+  auto [iterator, inserted] = _cells_map.try_emplace(key, static_cast<uint32_t>(_cells.size()));
+  if (inserted) {
+    _cells.emplace_back(Cell {.bounds = bounds});
+  }
+  auto &cell = _cells[iterator->second];
+  for (int i = 0; i < 3; i++) {
+    cell.bounds.min[i] = std::min(cell.bounds.min[i], bounds.min[i]);
+    cell.bounds.max[i] = std::max(cell.bounds.max[i], bounds.max[i]);
+  }
+
+  // Size of file is estimation of its GPU memory until the cell is loaded
+  if (not cell.bytes_measured) {
+    std::error_code error;
+    auto file_size = std::fs::file_size(path::models_dir / filename, error);
+    if (not error) {
+      cell.bytes += file_size;
+    }
+  }
+  cell.filenames.emplace_back(std::move(filename));
+}
+
+bool mr::WorldStreamer::add_models(const std::fs::path &index_filename) noexcept
+{
+  std::ifstream file(index_filename);
+  if (not file) {
+    MR_ERROR("Can't open world index {}", index_filename.string());
+    return false;
+  }
+
+  uint32_t models_number = 0;
+  std::string filename;
+  FrustumCuller::BoundBox bounds;
+  while (file >> filename >> bounds.min[0] >> bounds.min[1] >> bounds.min[2]
+                           >> bounds.max[0] >> bounds.max[1] >> bounds.max[2]) {
+    add_model(std::move(filename), bounds);
+    models_number++;
+  }
+  if (not file.eof()) {
+    MR_WARNING("World index {} is read up to invalid line after {} models", index_filename.string(), models_number);
+  }
+
+  MR_INFO("World index {}: {} models in {} cells", index_filename.string(), models_number, _cells.size());
+  return true;
+}
+
+void mr::WorldStreamer::update(const Vec3f &camera_position) noexcept
+{
+  auto start = std::chrono::steady_clock::now();
+
+  std::array<float, 3> position {camera_position.x(), camera_position.y(), camera_position.z()};
+  if (_has_position) {
+    float seconds = std::chrono::duration<float>(start - _position_time).count();
+    if (seconds > 0) {
+      for (int i = 0; i < 3; i++) {
+        float velocity = (position[i] - _position[i]) / seconds;
+        _velocity[i] += (velocity - _velocity[i]) * _options.velocity_smoothing;
+      }
+    }
+  }
+  _has_position = true;
+  _position = position;
+  _position_time = start;
+
+  std::array<float, 3> predicted_position;
+  for (int i = 0; i < 3; i++) {
+    predicted_position[i] = position[i] + _velocity[i] * _options.prediction_seconds;
+  }
+
+  // Loaded cells stay in range up to unload radius
+  _cells_order.clear();
+  for (auto [index, cell] : std::views::enumerate(_cells)) {
+    if (cell.state == CellState::Loading) {
+      finish_loading(cell);
+    }
+    cell.distance = std::min(distance(cell.bounds, position), distance(cell.bounds, predicted_position));
+    cell.wanted = false;
+    float radius = cell.state == CellState::Unloaded ? _options.load_radius : _options.unload_radius;
+    if (cell.distance <= radius) {
+      _cells_order.push_back(static_cast<uint32_t>(index));
+    }
+  }
+  std::ranges::sort(_cells_order, std::less {}, [this](uint32_t index) { return _cells[index].distance; });
+
+  // Nearest cells take budget first, farther ones are not loaded even if they are small,
+  // so they don't take memory of cells the camera reaches before them
+  size_t budget_bytes = 0;
+  for (uint32_t index : _cells_order) {
+    auto &cell = _cells[index];
+    if (budget_bytes + cell.bytes > _options.memory_budget) {
+      break;
+    }
+    budget_bytes += cell.bytes;
+    cell.wanted = true;
+  }
+
+  _stats = {};
+  // Unloads are pushed before loads, so their memory is freed first
+  for (auto &cell : _cells) {
+    if (cell.state == CellState::Loaded && not cell.wanted) {
+      unload(cell);
+      _stats.unloads_number++;
+    }
+    _stats.loading_cells_number += cell.state == CellState::Loading;
+  }
+  for (uint32_t index : _cells_order) {
+    auto &cell = _cells[index];
+    if (not cell.wanted || _stats.loading_cells_number >= _options.max_loading_cells) {
+      break;
+    }
+    if (cell.state == CellState::Unloaded) {
+      load(cell);
+      _stats.loads_number++;
+      _stats.loading_cells_number++;
+    }
+  }
+
+  _stats.cells_number = static_cast<uint32_t>(_cells.size());
+  for (const auto &cell : _cells) {
+    if (cell.state != CellState::Unloaded) {
+      _stats.resident_bytes += cell.bytes;
+    }
+    _stats.loaded_cells_number += cell.state == CellState::Loaded;
+  }
+  _stats.update_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void mr::WorldStreamer::load(Cell &cell) noexcept
+{
+  ASSERT(cell.state == CellState::Unloaded);
+  cell.state = CellState::Loading;
+
+  // Promises are moved to import thread, futures stay in cell
+  std::vector<Scene::CreateModelCommand> commands;
+  for (const auto &filename : cell.filenames) {
+    auto &command = commands.emplace_back(Scene::CreateModelCommand {.filename = filename});
+    cell.loading_models.emplace_back(command.model.get_future());
+  }
+
+  std::erase_if(_imports, [](const std::future<void> &import) {
+    return import.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  });
+  _imports.emplace_back(std::async(std::launch::async, [this, commands = std::move(commands)] mutable {
+    const auto &state = _scene->render_context().vulkan_state();
+    for (auto &command : commands) {
+      if (_stopping) {
+        return;
+      }
+      command.imported = Model::import(state, command.filename, not _scene->gpu_culling());
+      // Failed model is not imported again by render thread
+      if (command.imported == nullptr) {
+        command.model.set_value(nullptr);
+        continue;
+      }
+      _scene->enqueue(std::move(command));
+    }
+  }));
+}
+
+void mr::WorldStreamer::finish_loading(Cell &cell) noexcept
+{
+  for (const auto &model : cell.loading_models) {
+    if (model.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return;
+    }
+  }
+
+  cell.bytes = 0;
+  for (auto &model : cell.loading_models) {
+    auto handle = model.get();
+    if (handle != nullptr) {
+      cell.bytes += handle->gpu_bytes();
+      cell.models.emplace_back(std::move(handle));
+    }
+  }
+  cell.loading_models.clear();
+  cell.bytes_measured = true;
+  cell.state = CellState::Loaded;
+}
+
+void mr::WorldStreamer::unload(Cell &cell) noexcept
+{
+  ASSERT(cell.state == CellState::Loaded);
+
+  // Models are removed by render thread at frame boundary after frames in flight are finished
+  for (auto &model : cell.models) {
+    _scene->enqueue(Scene::RemoveModelCommand {std::move(model)});
+  }
+  cell.models.clear();
+  cell.state = CellState::Unloaded;
+}
@@ -0,0 +1,112 @@
+#ifndef __MR_WORLD_STREAMER_HPP_
+#define __MR_WORLD_STREAMER_HPP_
+
+#include "pch.hpp"
+
+#include "model/model.hpp"
+#include "scene/frustum_culler.hpp"
+
+namespace mr {
+inline namespace graphics {
+  class Scene;
+
+  // Streaming of world partitioned by uniform grid of cells, each cell references baked model files.
+  // Cells near camera or its position predicted by velocity are loaded while their memory fits budget:
+  // files are imported by background threads and uploaded by scene commands at frame boundary,
+  // far cells are unloaded by removal commands which free heaps and bindless slots of their models.
+  // Cells are loaded inside load radius and unloaded outside of bigger unload radius, so cells on
+  // the border are not reloaded when camera moves back and forth
+  class WorldStreamer {
+  public:
+    struct Options {
+      float cell_size = 64;       // in world units
+      float load_radius = 192;    // distance from camera to cell bounds
+      float unload_radius = 256;
+      float prediction_seconds = 2; // cells around position predicted by camera velocity are loaded ahead
+      float velocity_smoothing = 0.25f; // weight of last frame velocity
+      size_t memory_budget = size_t(4) << 30; // bytes of vertices, indices and textures of loaded cells
+      uint32_t max_loading_cells = 4;
+    };
+
+    struct Stats {
+      uint32_t cells_number = 0;
+      uint32_t loaded_cells_number = 0;
+      uint32_t loading_cells_number = 0;
+      size_t resident_bytes = 0; // of loaded and loading cells
+      uint32_t loads_number = 0;   // started by last update
+      uint32_t unloads_number = 0; // by last update
+      float update_ms = 0;
+    };
+
+  private:
+    enum class CellState : uint8_t {
+      Unloaded,
+      Loading,
+      Loaded,
+    };
+
+    struct Cell {
+      FrustumCuller::BoundBox bounds; // of cell models, may be bigger than cell
+      std::vector<std::string> filenames;
+      // Measured by last load, files size on disk before it
+      size_t bytes = 0;
+      bool bytes_measured = false;
+      CellState state = CellState::Unloaded;
+      std::vector<std::future<ModelHandle>> loading_models;
+      std::vector<ModelHandle> models;
+      float distance = 0; // to camera or predicted position, updated each update
+      bool wanted = false; // in range and fits memory budget
+    };
+
+    Scene *_scene = nullptr;
+    Options _options;
+
+    std::vector<Cell> _cells;
+    boost::unordered_map<uint64_t, uint32_t> _cells_map; // packed grid coordinates to cell index
+    std::vector<uint32_t> _cells_order; // cells in streaming range sorted by distance
+
+    bool _has_position = false;
+    std::array<float, 3> _position {};
+    std::array<float, 3> _velocity {};
+    std::chrono::steady_clock::time_point _position_time;
+
+    // Imports of loading cells run by own threads, so blocking file reading doesn't take TBB workers
+    // of culling and they progress even if render thread never waits for them.
+    // Remaining files are skipped after destruction start
+    std::vector<std::future<void>> _imports;
+    std::atomic_bool _stopping = false;
+
+    Stats _stats;
+
+  public:
+    WorldStreamer(Scene &scene, const Options &options) noexcept;
+    ~WorldStreamer();
+
+    // Tasks of imports reference streamer
+    WorldStreamer(WorldStreamer &&) = delete;
+    WorldStreamer & operator=(WorldStreamer &&) = delete;
+
+    // Model is streamed with cell containing center of its world space bounds.
+    // Models added to loaded cell are loaded with its next load
+    void add_model(std::string filename, const FrustumCuller::BoundBox &bounds) noexcept;
+    // Adds models of baked world index file, each line is model file name and its bounds:
+    // 'filename min_x min_y min_z max_x max_y max_z', names are relative to models directory.
+    // Returns false if file can't be read
+    bool add_models(const std::fs::path &index_filename) noexcept;
+
+    // Called by Scene::update on render thread
+    void update(const Vec3f &camera_position) noexcept;
+
+    const Options & options() const noexcept { return _options; }
+    const Stats & stats() const noexcept { return _stats; }
+
+  private:
+    void load(Cell &cell) noexcept;
+    void unload(Cell &cell) noexcept;
+    // Moves models of loading cell to loaded ones if all of them are uploaded
+    void finish_loading(Cell &cell) noexcept;
+  };
+}
+} // namespace mr
+
+#endif // __MR_WORLD_STREAMER_HPP_